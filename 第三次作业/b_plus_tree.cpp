@@ -3,6 +3,7 @@
  */
 #include <iostream>
 #include <string>
+#include <utility>
 
 #include "common/exception.h"
 #include "common/logger.h"
@@ -20,7 +21,17 @@ BPLUSTREE_TYPE::BPlusTree(const std::string &name,
                                 const KeyComparator &comparator,
                                 page_id_t root_page_id)
     : index_name_(name), root_page_id_(root_page_id),
-      buffer_pool_manager_(buffer_pool_manager), comparator_(comparator) {}
+      buffer_pool_manager_(buffer_pool_manager),
+      page_reader_(buffer_pool_manager), comparator_(comparator) {}
+
+INDEX_TEMPLATE_ARGUMENTS
+BPLUSTREE_TYPE::BPlusTree(const std::string &name,
+                                PageReader *page_reader,
+                                const KeyComparator &comparator,
+                                page_id_t root_page_id)
+    : index_name_(name), root_page_id_(root_page_id),
+      buffer_pool_manager_(nullptr), page_reader_(page_reader),
+      comparator_(comparator) {}
 
 /*
  * Helper function to decide whether current b+tree is empty
@@ -43,34 +54,20 @@ bool BPLUSTREE_TYPE::GetValue(const KeyType &key,
                               std::vector<ValueType> &result,
                               Transaction *transaction) 
 {
-  // 找到对应的叶子leaf
+  // 找到对应的叶子leaf，guard离开作用域时释放读锁并unpin一次
   //返回相联的唯一值
-  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = FindLeafPage(key,false,OpType::READ,transaction);
-  bool ret = false;
-  if (leaf == nullptr)
+  ReadPageGuard guard = FindLeafPageRead(key, false);
+  if (!guard.IsValid())
     return false;
- 
-  if (leaf != nullptr)
-  {
-        ValueType value;
-        if (leaf->Lookup(key, value, comparator_))
-        {
-            result.push_back(value);
-            ret = true;
-        }
-
-        UnlockUnpinPages(Operation::READONLY, transaction);
-
-        if (transaction == nullptr)
-        {
-            auto page_id = leaf->GetPageId();
-            buffer_pool_manager_->FetchPage(page_id)->RUnlatch();
-            buffer_pool_manager_->UnpinPage(page_id, false);
 
-            buffer_pool_manager_->UnpinPage(page_id, false);
-        }
+  auto *leaf = guard.As<B_PLUS_TREE_LEAF_PAGE_TYPE>();
+  ValueType value;
+  if (leaf->Lookup(key, value, comparator_))
+  {
+      result.push_back(value);
+      return true;
   }
-  return ret;
+  return false;
 }
 
 /*****************************************************************************
@@ -85,16 +82,19 @@ bool BPLUSTREE_TYPE::GetValue(const KeyType &key,
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value,
-                            Transaction *transaction) 
+                            Transaction *transaction,
+                            AccessStrategy *strategy) 
 {
-  std::lock_guard<std::mutex> lock(mutex_);
-    if (IsEmpty())
-    {
-      //插入时，若最近的树为空，创建一个新树
-      StartNewTree(key, value);
-      return true;
-    }
-  return InsertIntoLeaf(key, value, transaction);
+  WritePageSet page_set;
+  auto* leaf = FindLeafPageWrite(key, Operation::INSERT, page_set, strategy);
+  if (leaf == nullptr)
+  {
+    //插入时，若最近的树为空，创建一个新树，这时根锁还在手里
+    StartNewTree(key, value, page_set, strategy);
+    UnlockUnpinPages(page_set);
+    return true;
+  }
+  return InsertIntoLeaf(key, value, leaf, page_set, strategy);
 }
 
 /*
@@ -104,80 +104,52 @@ bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value,
  * tree's root page id and insert entry directly into leaf page.
  */
 INDEX_TEMPLATE_ARGUMENTS
-void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value) 
+void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value,
+                                  WritePageSet &page_set,
+                                  AccessStrategy *strategy) 
 {
   //请求新页面
   page_id_t newPageId;
-  Page *rootPage = buffer_pool_manager_->NewPage(newPageId);
-  //若返回nullptr则显示内存不足
-  assert(rootPage != nullptr);
+  auto *root = NewNode<B_PLUS_TREE_LEAF_PAGE_TYPE>(newPageId, INVALID_PAGE_ID, page_set, strategy);
 
-  B_PLUS_TREE_LEAF_PAGE_TYPE *root = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(rootPage->GetData());
-  //更新b+树的根id
   root->Init(newPageId,INVALID_PAGE_ID);
+  root->Insert(key,value,comparator_);
+  //更新b+树的根id
   root_page_id_ = newPageId;
   UpdateRootPageId(true);
-  
-
-  root->Insert(key,value,comparator_);
-
-  buffer_pool_manager_->UnpinPage(rootPage->GetPageId(),true);
 }
 
 /*
  * Insert constant key & value pair into leaf page
- * User needs to first find the right leaf page as insertion target, then look
- * through leaf page to see whether insert key exist or not. If exist, return
- * immdiately, otherwise insert entry. Remember to deal with split if necessary.
+ * The leaf is the one FindLeafPageWrite found for key, look through it to see
+ * whether insert key exist or not. If exist, return immdiately, otherwise
+ * insert entry. Remember to deal with split if necessary.
  * @return: since we only support unique key, if user try to insert duplicate
  * keys return false, otherwise return true.
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
-                                    Transaction *transaction) 
+                                    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf,
+                                    WritePageSet &page_set,
+                                    AccessStrategy *strategy) 
 {
-    auto* leaf = FindLeafPage(key, false, Operation::INSERT, transaction);
-    if (leaf == nullptr)
-    {
-        return false;
-    }
     ValueType v;
     //判断要插入的键是否存在
     //不存在就插入
     if (leaf->Lookup(key, v, comparator_))
     {
-        UnlockUnpinPages(Operation::INSERT, transaction);
+        UnlockUnpinPages(page_set);
         return false;
     }
-    if (leaf->GetSize() < leaf->GetMaxSize())
-    {
-        leaf->Insert(key, value, comparator_);
-    }
-    else
+    // 叶子多留了一个位置，先插入再分裂
+    leaf->Insert(key, value, comparator_);
+    if (leaf->GetSize() > leaf->GetMaxSize())
     {
-        auto* leaf2 = Split<BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>>(leaf);
-        if (comparator_(key, leaf2->KeyAt(0)) < 0)
-        {
-            leaf->Insert(key, value, comparator_);
-        }
-        else
-        {
-            leaf2->Insert(key, value, comparator_);
-        }
-        if (comparator_(leaf->KeyAt(0), leaf2->KeyAt(0)) < 0)
-        {
-            leaf2->SetNextPageId(leaf->GetNextPageId());
-            leaf->SetNextPageId(leaf2->GetPageId());
-        }
-        else
-        {
-            leaf2->SetNextPageId(leaf->GetPageId());
-        }
-
-        InsertIntoParent(leaf, leaf2->KeyAt(0), leaf2, transaction);
+        auto* leaf2 = Split(leaf, page_set, strategy);
+        InsertIntoParent(leaf, leaf2->KeyAt(0), leaf2, page_set, strategy);
     }
 
-    UnlockUnpinPages(Operation::INSERT, transaction);
+    UnlockUnpinPages(page_set);
     return true;
 }
 
@@ -189,24 +161,40 @@ bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
  * of key & value pairs from input page to newly created page
  */
 INDEX_TEMPLATE_ARGUMENTS
-template <typename N> N *BPLUSTREE_TYPE::Split(N *node) 
+template <typename N>
+N *BPLUSTREE_TYPE::Split(N *node, WritePageSet &page_set, AccessStrategy *strategy) 
 { 
-  // 拿到新page
+  // 拿到新page，尽量靠近被分裂的页，范围扫描时兄弟页在文件中相邻
   page_id_t newPageId;
-  Page* const newPage = buffer_pool_manager_->NewPage(newPageId);
-  assert(newPage != nullptr);
-  newPage->WLatch();
-  transaction->AddIntoPageSet(newPage);
-  
+  N *newNode = NewNode<N>(newPageId, node->GetPageId(), page_set, strategy);
 
-  N *newNode = reinterpret_cast<N *>(newPage->GetData());
   newNode->Init(newPageId, node->GetParentPageId());
   node->MoveHalfTo(newNode, buffer_pool_manager_);
-
- 
   return newNode; 
 }
 
+/*
+ * Ask the buffer pool manager for a new page close to hint_page_id, write
+ * latch it and keep its guard in page_set. Throw an "out of memory" exception
+ * if the buffer pool manager returns nullptr
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename N>
+N *BPLUSTREE_TYPE::NewNode(page_id_t &page_id, page_id_t hint_page_id,
+                           WritePageSet &page_set, AccessStrategy *strategy)
+{
+  Page *page = buffer_pool_manager_->NewPage(page_id, hint_page_id, strategy);
+  if (page == nullptr)
+    throw Exception(EXCEPTION_TYPE_INDEX, "out of memory");
+
+  // 新页挂到树上、内容写好之前一直持有写锁
+  page->WLatch();
+  WritePageGuard guard(buffer_pool_manager_, page);
+  N *node = guard.AsMut<N>();
+  page_set.pages_.push_back(std::move(guard));
+  return node;
+}
+
 /*
  * Insert key & value pair into internal page after split
  * @param   old_node      input page from split() method
@@ -220,23 +208,30 @@ INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node,
                                       const KeyType &key,
                                       BPlusTreePage *new_node,
-                                      Transaction *transaction) 
+                                      WritePageSet &page_set,
+                                      AccessStrategy *strategy) 
 {
     if (old_node->IsRootPage()) 
     {
-    Page* const newPage = buffer_pool_manager_->NewPage(root_page_id_);
-    assert(newPage != nullptr);
-    assert(newPage->GetPinCount() == 1);
-
-    B_PLUS_TREE_INTERNAL_PAGE *newRoot = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(newPage->GetData());
-    newRoot->Init(root_page_id_);
-    newRoot->PopulateNewRoot(old_node->GetPageId(),key,new_node->GetPageId());
-    old_node->SetParentPageId(root_page_id_);
-    new_node->SetParentPageId(root_page_id_);
-    UpdateRootPageId();
-  
-    buffer_pool_manager_->UnpinPage(newRoot->GetPageId(),true);
-    return;
+      page_id_t newRootId;
+      auto *newRoot = NewNode<B_PLUS_TREE_INTERNAL_PAGE>(newRootId, INVALID_PAGE_ID, page_set, strategy);
+
+      newRoot->Init(newRootId);
+      newRoot->PopulateNewRoot(old_node->GetPageId(),key,new_node->GetPageId());
+      old_node->SetParentPageId(newRootId);
+      new_node->SetParentPageId(newRootId);
+      root_page_id_ = newRootId;
+      UpdateRootPageId();
+      return;
+    }
+
+    // old_node不安全，所以父亲的写锁还在page_set里
+    auto *parent = LatchedPage<B_PLUS_TREE_INTERNAL_PAGE>(page_set, old_node->GetParentPageId());
+    parent->InsertNodeAfter(old_node->GetPageId(), key, new_node->GetPageId());
+    if (parent->GetSize() > parent->GetMaxSize())
+    {
+      auto *parent2 = Split(parent, page_set, strategy);
+      InsertIntoParent(parent, parent2->KeyAt(0), parent2, page_set, strategy);
     }
 }
 
@@ -253,25 +248,23 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node,
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) 
 {
-  //若为空直接返回
-  if (IsEmpty())
+  WritePageSet page_set;
+  auto* leaf = FindLeafPageWrite(key, Operation::DELETE, page_set);
+  //若为空直接返回，page_set析构时放掉根锁
+  if (leaf == nullptr)
     return;
 
-  auto* leaf = FindLeafPage(key, false, Operation::DELETE, transaction);
-  if (leaf != nullptr)
+  //需要先找到正确的叶页作为删除目标，然后从叶页中删除条目。
+  //还要进行处理重分发或合并
+  int size_before_deletion = leaf->GetSize();
+  if (leaf->RemoveAndDeleteRecord(key, comparator_) != size_before_deletion)
   {
-    //需要先找到正确的叶页作为删除目标，然后从叶页中删除条目。
-    //还要进行处理重分发或合并
-      int size_before_deletion = leaf->GetSize();
-      if (leaf->RemoveAndDeleteRecord(key, comparator_) != size_before_deletion)
+      if (CoalesceOrRedistribute(leaf, page_set))
       {
-          if (CoalesceOrRedistribute(leaf, transaction))
-          {
-              transaction->AddIntoDeletedPageSet(leaf->GetPageId());
-          }
+          page_set.deleted_pages_.push_back(leaf->GetPageId());
       }
-      UnlockUnpinPages(Operation::DELETE, transaction);
   }
+  UnlockUnpinPages(page_set);
 }
 
 /*
@@ -283,16 +276,12 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction)
  */
 INDEX_TEMPLATE_ARGUMENTS
 template <typename N>
-bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction) 
+bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, WritePageSet &page_set) 
 { 
-  //先找到兄弟页
-  auto *leaf = FindLeafPage(key_t, false, Operation::INSERT, transaction);
-    if (leaf == nullptr)
+    if (node->IsRootPage())
     {
-      if (node->IsRootPage())
-      {
-        return AdjustRoot(node);
-      }
+        return AdjustRoot(node, page_set);
+    }
     if (node->IsLeafPage())
     {
         if (node->GetSize() >= node->GetMinSize())
@@ -308,14 +297,14 @@ bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction)
         }
     }
 
-    auto* page = buffer_pool_manager_->FetchPage(node->GetParentPageId());
-
-    auto parent = reinterpret_cast<BPlusTreeInternalPage<KeyType, page_id_t,KeyComparator>*>(page->GetData());
+    // node不安全，所以父亲的写锁还在page_set里
+    auto *parent = LatchedPage<B_PLUS_TREE_INTERNAL_PAGE>(page_set, node->GetParentPageId());
     int value_index = parent->ValueIndex(node->GetPageId());
 
-    assert(value_index != parent->GetSize());
+    assert(value_index != -1);
 
-    int sibling_page_id;
+    //先找到兄弟页，node是最左边的孩子时取右兄弟
+    page_id_t sibling_page_id;
     if (value_index == 0)
     {
         sibling_page_id = parent->ValueAt(value_index + 1);
@@ -325,151 +314,31 @@ bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction)
         sibling_page_id = parent->ValueAt(value_index - 1);
     }
 
-    page = buffer_pool_manager_->FetchPage(sibling_page_id);
-    
-    page->WLatch();
-    transaction->AddIntoPageSet(page);
-    auto sibling = reinterpret_cast<N*>(page->GetData());
-    bool redistribute = false;
-    //如果兄弟页的大小+输入页面的大小>页面的最大规格
-    //则重新分配，否则合并
-    if (sibling->GetSize() + node->GetSize() > node->GetMaxSize())
+    WritePageGuard guard = buffer_pool_manager_->FetchPageWrite(sibling_page_id);
+    if (!guard.IsValid())
     {
-        redistribute = true;
-        buffer_pool_manager_->UnpinPage(parent->GetPageId(), true);
-    }
-    if (redistribute) 
-    {
-        if (value_index == 0)
-        {
-            Redistribute<N>(sibling, node, 1);
-        }
-        return false;
+        throw Exception(EXCEPTION_TYPE_INDEX,
+            "all page are pinned while CoalesceOrRedistribute");
     }
+    auto sibling = guard.AsMut<N>();
+    page_set.pages_.push_back(std::move(guard));
 
-    bool ret;
-    if (value_index == 0) 
-    {
-        Coalesce<N>(node, sibling, parent, 1, transaction);
-        transaction->AddIntoDeletedPageSet(sibling_page_id);
-        ret = false;
-    }
-    else 
-    {
-        Coalesce<N>(sibling, node, parent, value_index, transaction);
-        ret = true;
-    }
-    buffer_pool_manager_->UnpinPage(parent->GetPageId(), true);
-    return ret;
-    }
-    ValueType v;
-    if (leaf->Lookup(key, v, comparator_))
-    {
-      UnlockUnpinPages(Operation::INSERT, transaction);
-      if (node->IsRootPage())
-      {
-        return AdjustRoot(node);
-      }
-    if (node->IsLeafPage())
-    {
-        if (node->GetSize() >= node->GetMinSize())
-        {
-            return false;
-        }
-    }
-    else
-    {
-        if (node->GetSize() > node->GetMinSize())
-        {
-            return false;
-        }
-    }
-
-    auto* page = buffer_pool_manager_->FetchPage(node->GetParentPageId());
-    if (page == nullptr)
-
-    auto parent =
-        reinterpret_cast<BPlusTreeInternalPage<KeyType, page_id_t,KeyComparator>*>(page->GetData());
-    int value_index = parent->ValueIndex(node->GetPageId());
-
-    assert(value_index != parent->GetSize());
-
-    int sibling_page_id;
-    if (value_index == 0)
-    {
-        sibling_page_id = parent->ValueAt(value_index + 1);
-    }
-    else
-    {
-        sibling_page_id = parent->ValueAt(value_index - 1);
-    }
-
-    page = buffer_pool_manager_->FetchPage(sibling_page_id);
-
-    
-    page->WLatch();
-    transaction->AddIntoPageSet(page);
-    auto sibling = reinterpret_cast<N*>(page->GetData());
-    bool redistribute = false;
-
+    //如果兄弟页的大小+输入页面的大小>页面的最大规格
+    //则重新分配，否则合并
     if (sibling->GetSize() + node->GetSize() > node->GetMaxSize())
     {
-        redistribute = true;
-        buffer_pool_manager_->UnpinPage(parent->GetPageId(), true);
-    }
-    if (redistribute) 
-    {
-        if (value_index == 0)
-        {
-            Redistribute<N>(sibling, node, 1);
-        }
+        Redistribute<N>(sibling, node, value_index);
         return false;
     }
 
-    bool ret;
     if (value_index == 0) 
     {
-        Coalesce<N>(node, sibling, parent, 1, transaction);
-        transaction->AddIntoDeletedPageSet(sibling_page_id);
-        ret = false;
-    }
-    else 
-    {
-        Coalesce<N>(sibling, node, parent, value_index, transaction);
-        ret = true;
-    }
-    buffer_pool_manager_->UnpinPage(parent->GetPageId(), true);
-    return ret;
-    }
-    if (leaf->GetSize() < leaf->GetMaxSize())
-    {
-      leaf->Insert(key, value, comparator_);
-    }
-    else
-    {
-      auto *leaf2 = Split<BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>>(leaf);
-      if (comparator_(key, leaf2->KeyAt(0)) < 0)
-      {
-        leaf->Insert(key, value, comparator_);
-      }
-      else
-      {
-        leaf2->Insert(key, value, comparator_);
-      }
-      if (comparator_(leaf->KeyAt(0), leaf2->KeyAt(0)) < 0)
-      {
-        leaf2->SetNextPageId(leaf->GetNextPageId());
-        leaf->SetNextPageId(leaf2->GetPageId());
-      }
-      else
-      {
-        leaf2->SetNextPageId(leaf->GetPageId());
-      }
-
-      InsertIntoParent(leaf, leaf2->KeyAt(0), leaf2, transaction);
+        //右兄弟并进node，删掉右兄弟
+        Coalesce<N>(node, sibling, parent, 1, page_set);
+        page_set.deleted_pages_.push_back(sibling_page_id);
+        return false;
     }
-
-    UnlockUnpinPages(Operation::INSERT, transaction);
+    Coalesce<N>(sibling, node, parent, value_index, page_set);
     return true;
 }
 
@@ -490,17 +359,17 @@ template <typename N>
 bool BPLUSTREE_TYPE::Coalesce(
     N *&neighbor_node, N *&node,
     BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *&parent,
-    int index, Transaction *transaction) 
+    int index, WritePageSet &page_set) 
 {
   
   assert(node->GetSize() + neighbor_node->GetSize() <= node->GetMaxSize());
   
-  // 移动后一个
+  // 移动后一个，node由调用者删除
   node->MoveAllTo(neighbor_node,index,buffer_pool_manager_);
-  transaction->AddIntoDeletedPageSet(node->GetPageId());
   parent->Remove(index);
-  if (parent->GetSize() <= parent->GetMinSize()) {
-    return CoalesceOrRedistribute(parent,transaction);
+  if (CoalesceOrRedistribute(parent,page_set)) {
+    page_set.deleted_pages_.push_back(parent->GetPageId());
+    return true;
   }
   return false;
 }
@@ -513,6 +382,7 @@ bool BPLUSTREE_TYPE::Coalesce(
  * Using template N to represent either internal page or leaf page.
  * @param   neighbor_node      sibling page of input "node"
  * @param   node               input from method coalesceOrRedistribute()
+ * @param   index              index of "node" in its parent
  */
 INDEX_TEMPLATE_ARGUMENTS
 template <typename N>
@@ -524,17 +394,7 @@ void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node, int index)
   }
   else
   {
-      auto* page = buffer_pool_manager_->FetchPage(node->GetParentPageId());
-      if (page == nullptr)
-      {
-          throw Exception(EXCEPTION_TYPE_INDEX,
-              "all page are pinned while Redistribute");
-      }
-      auto parent =
-          reinterpret_cast<BPlusTreeInternalPage<KeyType, page_id_t,KeyComparator>*>(page->GetData());
-      int idx = parent->ValueIndex(node->GetPageId());
-      buffer_pool_manager_->UnpinPage(parent->GetPageId(), false);
-      neighbor_node->MoveLastToFrontOf(node, idx, buffer_pool_manager_);
+     neighbor_node->MoveLastToFrontOf(node, index, buffer_pool_manager_);
   }
 }
 /*
@@ -548,12 +408,13 @@ void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node, int index)
  * happend
  */
 INDEX_TEMPLATE_ARGUMENTS
-bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) 
+bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node, WritePageSet &page_set) 
 {
   //针对必要情况更新根页
   if (old_root_node->IsLeafPage()) 
   {
-    assert(old_root_node->GetSize() == 0);
+    if (old_root_node->GetSize() > 0)
+      return false;
     assert (old_root_node->GetParentPageId() == INVALID_PAGE_ID);
     root_page_id_ = INVALID_PAGE_ID;
     UpdateRootPageId();
@@ -567,13 +428,9 @@ bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node)
     root_page_id_ = newRootId;
     UpdateRootPageId();
     
-    // 设置为无效
-    Page *page = buffer_pool_manager_->FetchPage(newRootId);
-    assert(page != nullptr);
-    B_PLUS_TREE_INTERNAL_PAGE *newRoot =
-            reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(page->GetData());
+    // 剩下的孩子刚刚合并过，写锁在page_set里，把它的父亲设置为无效
+    auto *newRoot = LatchedPage<BPlusTreePage>(page_set, newRootId);
     newRoot->SetParentPageId(INVALID_PAGE_ID);
-    buffer_pool_manager_->UnpinPage(newRootId, true);
     return true;
   }
   return false;
@@ -591,7 +448,7 @@ INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin() 
 { 
   KeyType key{};
-  return IndexIterator<KeyType, ValueType, KeyComparator>(FindLeafPage(key, true), 0, buffer_pool_manager_);
+  return IndexIterator<KeyType, ValueType, KeyComparator>(FindLeafPageRead(key, true), 0, page_reader_);
 }
 
 /*
@@ -602,12 +459,12 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin()
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key) 
 {
-    auto* leaf = FindLeafPage(key, false);
+    ReadPageGuard guard = FindLeafPageRead(key, false);
     int index = 0;
-    if (leaf != nullptr)
-      index = leaf->KeyIndex(key, comparator_);
+    if (guard.IsValid())
+      index = guard.As<B_PLUS_TREE_LEAF_PAGE_TYPE>()->KeyIndex(key, comparator_);
 
-    return IndexIterator<KeyType, ValueType, KeyComparator>(leaf, index, buffer_pool_manager_);
+    return IndexIterator<KeyType, ValueType, KeyComparator>(std::move(guard), index, page_reader_);
 }
 
 /*****************************************************************************
@@ -618,84 +475,108 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key)
  * the left most leaf page
  */
 INDEX_TEMPLATE_ARGUMENTS
-B_PLUS_TREE_LEAF_PAGE_TYPE *FindLeafPage(const KeyType &key,
-                                           bool leftMost = false,
-                                           OpType op = OpType::READ,
-                                           Transaction *transaction = nullptr)
+B_PLUS_TREE_LEAF_PAGE_TYPE *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key,
+                                                         bool leftMost)
 {
-  if (op != Operation::READONLY)
-  {
-    lockRoot();
-    root_is_locked = true;
-  }
+  if (buffer_pool_manager_ == nullptr)
+    throw Exception(EXCEPTION_TYPE_INDEX, "can't pin a page of a read only tree");
+
+  ReadPageGuard guard = FindLeafPageRead(key, leftMost);
+  if (!guard.IsValid())
+    return nullptr;
+
+  // 多pin一次交给调用者，guard只放掉自己的读锁和pin
+  Page *page = buffer_pool_manager_->FetchPage(guard.PageId());
+  assert(page != nullptr);
+  return reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+}
+
+/*
+ * Find the leaf page containing key for Insert (op == INSERT) or Remove (op ==
+ * DELETE). The root is locked and every page on the path is write latched on
+ * the way down, once a child is safe (op cannot split or merge it) the pages
+ * above it and the root lock are released, since op will not change them.
+ * The pages left are held in page_set until UnlockUnpinPages
+ */
+INDEX_TEMPLATE_ARGUMENTS
+B_PLUS_TREE_LEAF_PAGE_TYPE *BPLUSTREE_TYPE::FindLeafPageWrite(const KeyType &key,
+                                                              Operation op,
+                                                              WritePageSet &page_set,
+                                                              AccessStrategy *strategy)
+{
+  if (buffer_pool_manager_ == nullptr)
+    throw Exception(EXCEPTION_TYPE_INDEX, "can't modify a read only tree");
 
+  page_set.root_lock_ = std::unique_lock<std::mutex>(mutex_);
   if (IsEmpty())
   {
     return nullptr;
   }
 
-  auto* parent = buffer_pool_manager_->FetchPage(root_page_id_);
-  
-  if (op == Operation::READONLY)
-  {
-      parent->RLatch();
-  }
-  else
-  {
-      parent->WLatch();
-  }
-  if (transaction != nullptr)
-  {
-      transaction->AddIntoPageSet(parent);
-  }
-  auto* node = reinterpret_cast<BPlusTreePage*>(parent->GetData());
+  WritePageGuard guard = buffer_pool_manager_->FetchPageWrite(root_page_id_, strategy);
+  if (!guard.IsValid())
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned while FindLeafPageWrite");
+
+  auto* node = guard.AsMut<BPlusTreePage>();
+  page_set.pages_.push_back(std::move(guard));
   while (!node->IsLeafPage()) 
   {
       auto internal =
           reinterpret_cast<BPlusTreeInternalPage<KeyType, page_id_t,
           KeyComparator>*>(node);
       page_id_t parent_page_id = node->GetPageId(); 
-      page_id_t child_page_id;
-      if (leftMost)
-      {
-          child_page_id = internal->ValueAt(0);
-      }
-      else 
-      {
-          child_page_id = internal->Lookup(key, comparator_);
-      }
-      auto* child = buffer_pool_manager_->FetchPage(child_page_id);
+      page_id_t child_page_id = internal->Lookup(key, comparator_);
 
-      if (op == Operation::READONLY)
-      {
-          child->RLatch();
-          UnlockUnpinPages(op, transaction);
-      }
-      else
-      {
-          child->WLatch();
-      }
-      node = reinterpret_cast<BPlusTreePage*>(child->GetData());
+      guard = buffer_pool_manager_->FetchPageWrite(child_page_id, strategy);
+      if (!guard.IsValid())
+        throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned while FindLeafPageWrite");
+
+      node = guard.AsMut<BPlusTreePage>();
       assert(node->GetParentPageId() == parent_page_id);
-      if (op != Operation::READONLY && isSafe(node, op))
+      // 孩子安全时上面的页不会再被修改，先放掉它们和根锁
+      if (isSafe(node, op))
       {
-          UnlockUnpinPages(op, transaction);
-      }
-      if (transaction != nullptr)
-      {
-          transaction->AddIntoPageSet(child);
-      }
-      else
-      {
-          parent->RUnlatch();
-          buffer_pool_manager_->UnpinPage(parent->GetPageId(), false);
-          parent = child;
+          UnlockUnpinPages(page_set);
       }
+      page_set.pages_.push_back(std::move(guard));
   }
   return reinterpret_cast<BPlusTreeLeafPage<KeyType,
       ValueType, KeyComparator>*>(node);
 }
 
+/*
+ * Find leaf page containing particular key (or the left most leaf page) for a
+ * read only operation. The child is read latched before the guard of its
+ * parent is dropped, so every page on the path is fetched and unpinned exactly
+ * once. Return an invalid guard if the tree is empty
+ */
+INDEX_TEMPLATE_ARGUMENTS
+ReadPageGuard BPLUSTREE_TYPE::FindLeafPageRead(const KeyType &key, bool leftMost)
+{
+  if (IsEmpty())
+    return ReadPageGuard();
+
+  ReadPageGuard guard = page_reader_->FetchPageRead(root_page_id_);
+  if (!guard.IsValid())
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned while FindLeafPageRead");
+
+  auto* node = guard.As<BPlusTreePage>();
+  while (!node->IsLeafPage())
+  {
+      auto internal =
+          reinterpret_cast<BPlusTreeInternalPage<KeyType, page_id_t,
+          KeyComparator>*>(node);
+      page_id_t child_page_id = leftMost ? internal->ValueAt(0)
+                                         : internal->Lookup(key, comparator_);
+      // 先锁住孩子，赋值时才释放父亲
+      guard = page_reader_->FetchPageRead(child_page_id);
+      if (!guard.IsValid())
+        throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned while FindLeafPageRead");
+      node = guard.As<BPlusTreePage>();
+  }
+  return guard;
+}
+
 
 
 /*
@@ -737,13 +618,15 @@ void BPLUSTREE_TYPE::InsertFromFile(const std::string &file_name,
 {
   int64_t key;
   std::ifstream input(file_name);
+  // 批量插入只占用一个环的帧，不把其他线程的热页挤出缓冲池
+  AccessStrategy strategy(BULK_RING_SIZE);
   while (input) {
     input >> key;
 
     KeyType index_key;
     index_key.SetFromInteger(key);
     RID rid(key);
-    Insert(index_key, rid, transaction);
+    Insert(index_key, rid, transaction, &strategy);
   }
 }
 /*
@@ -10,9 +10,12 @@
  */
 #pragma once
 
+#include <deque>
+#include <mutex>
 #include <queue>
 #include <vector>
 
+#include "common/exception.h"
 #include "concurrency/transaction.h"
 #include "index/index_iterator.h"
 #include "page/b_plus_tree_internal_page.h"
@@ -21,6 +24,20 @@
 namespace scudb {
 
 #define BPLUSTREE_TYPE BPlusTree<KeyType, ValueType, KeyComparator>
+
+enum class Operation { READONLY = 0, INSERT, DELETE };
+
+// pages write latched by one Insert or Remove, from the highest page the
+// operation may still change down to the leaf. The guards release the latches
+// and the pins, also when the operation throws. Transaction::GetPageSet only
+// holds Page *, so the write path keeps its guards here and the transaction
+// argument of Insert and Remove is optional
+struct WritePageSet {
+  std::unique_lock<std::mutex> root_lock_;  // held while root_page_id_ may change
+  std::deque<WritePageGuard> pages_;
+  std::vector<page_id_t> deleted_pages_;    // deleted once pages_ are released
+};
+
 // Main class providing the API for the Interactive B+ Tree.
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTree {
@@ -30,12 +47,21 @@ public:
                            const KeyComparator &comparator,
                            page_id_t root_page_id = INVALID_PAGE_ID);
 
+  // read only tree whose pages come from page_reader, for example a
+  // ReadOnlyBufferPoolManager. GetValue and Begin work as usual, Insert,
+  // Remove and FindLeafPage throw an Exception
+  explicit BPlusTree(const std::string &name, PageReader *page_reader,
+                     const KeyComparator &comparator,
+                     page_id_t root_page_id);
+
   // Returns true if this B+ tree has no keys and values.
   bool IsEmpty() const;
 
-  // Insert a key-value pair into this B+ tree.
+  // Insert a key-value pair into this B+ tree. Pages read or created on a
+  // miss take the frames of strategy's ring, if one is given
   bool Insert(const KeyType &key, const ValueType &value,
-              Transaction *transaction = nullptr);
+              Transaction *transaction = nullptr,
+              AccessStrategy *strategy = nullptr);
 
   // Remove a key and its value from this B+ tree.
   void Remove(const KeyType &key, Transaction *transaction = nullptr);
@@ -58,70 +84,88 @@ public:
   // read data from file and remove one by one
   void RemoveFromFile(const std::string &file_name,
                       Transaction *transaction = nullptr);
-  // expose for test purpose
+  // expose for test purpose, the leaf is returned pinned (no latch held) and
+  // the caller unpins it
   B_PLUS_TREE_LEAF_PAGE_TYPE *FindLeafPage(const KeyType &key,
-                                           bool leftMost = false,
-                                           OpType op = OpType::READ,
-                                           Transaction *transaction = nullptr);
+                                           bool leftMost = false);
 private:
-  void StartNewTree(const KeyType &key, const ValueType &value);
+  void StartNewTree(const KeyType &key, const ValueType &value,
+                    WritePageSet &page_set,
+                    AccessStrategy *strategy = nullptr);
 
   bool InsertIntoLeaf(const KeyType &key, const ValueType &value,
-                      Transaction *transaction = nullptr);
+                      B_PLUS_TREE_LEAF_PAGE_TYPE *leaf,
+                      WritePageSet &page_set,
+                      AccessStrategy *strategy = nullptr);
 
   void InsertIntoParent(BPlusTreePage *old_node, const KeyType &key,
-                        BPlusTreePage *new_node,
-                        Transaction *transaction = nullptr);
+                        BPlusTreePage *new_node, WritePageSet &page_set,
+                        AccessStrategy *strategy = nullptr);
 
-  template <typename N> N *Split(N *node);
+  template <typename N>
+  N *Split(N *node, WritePageSet &page_set,
+           AccessStrategy *strategy = nullptr);
 
   template <typename N>
-  bool CoalesceOrRedistribute(N *node, Transaction *transaction = nullptr);
+  bool CoalesceOrRedistribute(N *node, WritePageSet &page_set);
 
   template <typename N>
   bool Coalesce(
       N *&neighbor_node, N *&node,
       BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *&parent,
-      int index, Transaction *transaction = nullptr);
+      int index, WritePageSet &page_set);
 
   template <typename N> void Redistribute(N *neighbor_node, N *node, int index);
 
-  bool AdjustRoot(BPlusTreePage *node);
+  bool AdjustRoot(BPlusTreePage *node, WritePageSet &page_set);
+
+  // read latched leaf for GetValue and Begin, see FindLeafPage
+  ReadPageGuard FindLeafPageRead(const KeyType &key, bool leftMost);
+
+  // write latched leaf for Insert and Remove, the pages above it which the
+  // operation may change stay latched in page_set. Return nullptr (with the
+  // root still locked) if the tree is empty
+  B_PLUS_TREE_LEAF_PAGE_TYPE *FindLeafPageWrite(const KeyType &key,
+                                                Operation op,
+                                                WritePageSet &page_set,
+                                                AccessStrategy *strategy = nullptr);
+
+  // new page, write latched and held in page_set until the operation ends
+  template <typename N>
+  N *NewNode(page_id_t &page_id, page_id_t hint_page_id,
+             WritePageSet &page_set, AccessStrategy *strategy = nullptr);
 
   void UpdateRootPageId(int insert_record = false);
 
 
-  void UnlockUnpinPages(Operation op, Transaction* transaction)
+  void UnlockUnpinPages(WritePageSet &page_set)
   {
-    if (transaction == nullptr)
-        return;
+    // guard析构时放掉写锁并unpin，页没有pin了才能删除
+    page_set.pages_.clear();
 
-    for (auto* page : *transaction->GetPageSet())
+    for (auto page_id : page_set.deleted_pages_)
     {
-        if (op == Operation::READONLY)
-        {
-            page->RUnlatch();
-            buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
-        }
-        else
-        {
-            page->WUnlatch();
-            buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
-        }
+        buffer_pool_manager_->DeletePage(page_id);
     }
-    transaction->GetPageSet()->clear();
+    page_set.deleted_pages_.clear();
 
-    for (auto page_id : *transaction->GetDeletedPageSet())
+    if (page_set.root_lock_.owns_lock())
     {
-        buffer_pool_manager_->DeletePage(page_id);
+        page_set.root_lock_.unlock();
     }
-    transaction->GetDeletedPageSet()->clear();
+  }
 
-    if (root_is_locked) 
+  // page of page_set, the operation already holds its write latch, so it is
+  // not fetched (and latched) a second time
+  template <typename N>
+  N *LatchedPage(WritePageSet &page_set, page_id_t page_id)
+  {
+    for (auto &guard : page_set.pages_)
     {
-        root_is_locked = false;
-        unlockRoot();
+        if (guard.PageId() == page_id)
+            return guard.AsMut<N>();
     }
+    throw Exception(EXCEPTION_TYPE_INDEX, "page is not latched by this operation");
   }
 
   template <typename N>
@@ -138,9 +182,6 @@ private:
     return true;
   }
 
-  inline void lockRoot() { mutex_.lock(); }
-  inline void unlockRoot() { mutex_.unlock(); }
-
   // member variable
   class Checker {
   public:
@@ -149,11 +190,11 @@ private:
   private:
       BufferPoolManager* buffer;
   };
-  std::mutex mutex_;                       // 保证线程安全
-  static thread_local bool root_is_locked; 
+  std::mutex mutex_;                       // 保护root_page_id_的修改
   std::string index_name_;
   page_id_t root_page_id_;
-  BufferPoolManager *buffer_pool_manager_;
+  BufferPoolManager *buffer_pool_manager_; // nullptr for a read only tree
+  PageReader *page_reader_;                // read path, buffer_pool_manager_ if there is one
   KeyComparator comparator_;
 };
 
@@ -1,8 +1,10 @@
 /**
  * b_plus_tree_internal_page.cpp
  */
+#include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 #include "common/exception.h"
 #include "page/b_plus_tree_internal_page.h"
@@ -71,7 +73,7 @@ B_PLUS_TREE_INTERNAL_PAGE_TYPE::Lookup(const KeyType &key,const KeyComparator &c
 
   // 二分法查找最大的小于input的键
   while (start <= end) { 
-    int mid = (end - start) / 2;
+    int mid = start + (end - start) / 2;
     
     if (comparator(array[mid].first,key) > 0) 
       end = mid - 1;
@@ -134,16 +136,12 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveHalfTo(//将一半key和value转移到
   int total = GetMaxSize() + 1;
   assert(GetSize() == total);
   int copyIdx = (total)/2;
-  page_id_t recipPageId = recipient->GetPageId();
   for (int i = copyIdx; i < total; i++) {
     recipient->array[i - copyIdx].first = array[i].first;
     recipient->array[i - copyIdx].second = array[i].second;
-    //更新父节点
-    auto childRawPage = buffer_pool_manager->FetchPage(array[i].second);
-    BPlusTreePage *childTreePage = reinterpret_cast<BPlusTreePage *>(childRawPage->GetData());
-    childTreePage->SetParentPageId(recipPageId);
-    buffer_pool_manager->UnpinPage(array[i].second,true);
   }
+  //更新移走的子节点的父节点
+  recipient->AdoptChildren(0, total - copyIdx, buffer_pool_manager);
   //设置和修改页的大小
   SetSize(copyIdx);
   recipient->SetSize(total - copyIdx);
@@ -194,7 +192,6 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveAllTo(
     BPlusTreeInternalPage *recipient, int index_in_parent,
     BufferPoolManager *buffer_pool_manager) {
   int start = recipient->GetSize();
-  page_id_t recipPageId = recipient->GetPageId();
   // 找到父节点
   Page *page = buffer_pool_manager->FetchPage(GetParentPageId());
   assert(page != nullptr);//保证指针非空
@@ -205,18 +202,111 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveAllTo(
   for (int i = 0; i < GetSize(); ++i) {
     recipient->array[start + i].first = array[i].first;
     recipient->array[start + i].second = array[i].second;
-    //更新相应父节点
-    auto childRawPage = buffer_pool_manager->FetchPage(array[i].second);
-    BPlusTreePage *childTreePage = reinterpret_cast<BPlusTreePage *>(childRawPage->GetData());
-    childTreePage->SetParentPageId(recipPageId);
-    buffer_pool_manager->UnpinPage(array[i].second,true);
   }
+  //更新相应子节点的父节点
+  recipient->AdoptChildren(start, start + GetSize(), buffer_pool_manager);
   //更新相应父节点的大小
   recipient->SetSize(start + GetSize());
   assert(recipient->GetSize() <= GetMaxSize());
   SetSize(0);
 }
 
+/*
+ * Make this page the parent of the children in array[begin, end). They are
+ * pinned CHILD_FETCH_BATCH at a time (see PinChildren), a batch is changed only
+ * once all its children are pinned. If a child cannot be pinned, the children
+ * of the earlier batches get their old parent back before an Exception is
+ * thrown, so a failed call leaves every child as it was
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::AdoptChildren(
+    int begin, int end, BufferPoolManager *buffer_pool_manager) {
+  int batch = ChildBatch(buffer_pool_manager);
+  std::vector<page_id_t> old_parents; //array[begin + i]原来的父节点
+  for (int first = begin; first < end; first += batch) {
+    std::vector<page_id_t> children;
+    for (int i = first; i < std::min(end, first + batch); i++) {
+      children.push_back(array[i].second);
+    }
+    std::vector<Page *> pages = PinChildren(children, buffer_pool_manager);
+    if (pages.empty()) {
+      //前面的批次刚放掉自己的帧，还给原来的父节点一般不会再取不到
+      SetParentOf(begin, old_parents, buffer_pool_manager);
+      throw Exception(EXCEPTION_TYPE_INDEX,
+                      "all page are pinned while moving children");
+    }
+    for (auto *page : pages) {
+      BPlusTreePage *child = reinterpret_cast<BPlusTreePage *>(page->GetData());
+      old_parents.push_back(child->GetParentPageId());
+      child->SetParentPageId(GetPageId());
+    }
+    buffer_pool_manager->UnpinPages(children, true);
+  }
+}
+
+/*
+ * Give the children in array[begin, begin + parents.size()) back the parents
+ * they had before AdoptChildren, one page at a time
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetParentOf(
+    int begin, const std::vector<page_id_t> &parents,
+    BufferPoolManager *buffer_pool_manager) {
+  for (size_t i = 0; i < parents.size(); i++) {
+    page_id_t child_page_id = array[begin + i].second;
+    Page *page = buffer_pool_manager->FetchPage(child_page_id);
+    if (page == nullptr) {
+      throw Exception(EXCEPTION_TYPE_INDEX,
+                      "all page are pinned while restoring children");
+    }
+    reinterpret_cast<BPlusTreePage *>(page->GetData())
+        ->SetParentPageId(parents[i]);
+    buffer_pool_manager->UnpinPage(child_page_id, true);
+  }
+}
+
+// 一次pin住的子节点数，最多占缓冲池的四分之一
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::ChildBatch(
+    BufferPoolManager *buffer_pool_manager) {
+  return static_cast<int>(std::min<size_t>(
+      CHILD_FETCH_BATCH, std::max<size_t>(1, buffer_pool_manager->GetPoolSize() / 4)));
+}
+
+/*
+ * Pin the pages of children ChildBatch() at a time, the misses of a batch
+ * being read concurrently. A child the batch cannot bring in is fetched alone.
+ * Return the pages in the order of children, or an empty vector, with nothing
+ * left pinned, if even that fails for one of them
+ */
+INDEX_TEMPLATE_ARGUMENTS
+std::vector<Page *> B_PLUS_TREE_INTERNAL_PAGE_TYPE::PinChildren(
+    const std::vector<page_id_t> &children,
+    BufferPoolManager *buffer_pool_manager) {
+  size_t batch = static_cast<size_t>(ChildBatch(buffer_pool_manager));
+  std::vector<Page *> pages;
+  for (size_t first = 0; first < children.size(); first += batch) {
+    std::vector<page_id_t> ids(children.begin() + first,
+                               children.begin() + std::min(children.size(), first + batch));
+    std::vector<Page *> fetched = buffer_pool_manager->FetchPages(ids);
+    pages.insert(pages.end(), fetched.begin(), fetched.end());
+  }
+  //批量取不到的子节点最后单独取
+  for (size_t i = 0; i < children.size(); i++) {
+    if (pages[i] == nullptr) {
+      pages[i] = buffer_pool_manager->FetchPage(children[i]);
+    }
+    if (pages[i] == nullptr) {
+      for (size_t j = 0; j < children.size(); j++) {
+        if (pages[j] != nullptr)
+          buffer_pool_manager->UnpinPage(children[j], false);
+      }
+      return std::vector<Page *>();
+    }
+  }
+  return pages;
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyAllFrom(
     MappingType *items, int size, BufferPoolManager *buffer_pool_manager) {}
@@ -300,11 +390,17 @@ INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::QueueUpChildren(
     std::queue<BPlusTreePage *> *queue,
     BufferPoolManager *buffer_pool_manager) {
+  std::vector<page_id_t> children;
   for (int i = 0; i < GetSize(); i++) {
-    auto *page = buffer_pool_manager->FetchPage(array[i].second);
-    if (page == nullptr)
-      throw Exception(EXCEPTION_TYPE_INDEX,
-                      "all page are pinned while printing");
+    children.push_back(array[i].second);
+  }
+  // 和AdoptChildren一样分批取出子节点，有子节点取不到时已经pin住的都放掉了
+  std::vector<Page *> pages = PinChildren(children, buffer_pool_manager);
+  if (pages.empty() && !children.empty()) {
+    throw Exception(EXCEPTION_TYPE_INDEX,
+                    "all page are pinned while printing");
+  }
+  for (auto *page : pages) {
     BPlusTreePage *node =
         reinterpret_cast<BPlusTreePage *>(page->GetData());
     queue->push(node);
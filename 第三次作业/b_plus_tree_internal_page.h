@@ -17,6 +17,7 @@
 #pragma once
 
 #include <queue>
+#include <vector>
 
 #include "page/b_plus_tree_page.h"
 
@@ -26,6 +27,7 @@ namespace scudb {
   BPlusTreeInternalPage<KeyType, ValueType, KeyComparator>
 
 #define B_PLUS_TREE_INTERNAL_PAGE  BPlusTreeInternalPage <KeyType, page_id_t, KeyComparator>
+#define CHILD_FETCH_BATCH 16 // children pinned at once when they change parent
   
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeInternalPage : public BPlusTreePage {
@@ -65,6 +67,13 @@ private:
                     BufferPoolManager *buffer_pool_manager);
   void CopyFirstFrom(const MappingType &pair, int parent_index,
                      BufferPoolManager *buffer_pool_manager);
+  void AdoptChildren(int begin, int end,
+                     BufferPoolManager *buffer_pool_manager);
+  void SetParentOf(int begin, const std::vector<page_id_t> &parents,
+                   BufferPoolManager *buffer_pool_manager);
+  static int ChildBatch(BufferPoolManager *buffer_pool_manager);
+  static std::vector<Page *> PinChildren(const std::vector<page_id_t> &children,
+                                         BufferPoolManager *buffer_pool_manager);
   MappingType array[0];
 };
 } // namespace scudb
\ No newline at end of file
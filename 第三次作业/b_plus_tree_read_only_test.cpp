@@ -0,0 +1,102 @@
+/**
+ * b_plus_tree_read_only_test.cpp
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/read_only_buffer_pool_manager.h"
+#include "common/exception.h"
+#include "gtest/gtest.h"
+#include "index/b_plus_tree.h"
+#include "page/header_page.h"
+#include "vtable/virtual_table.h"
+
+namespace scudb {
+
+/*
+ * Build a tree through a BufferPoolManager, then map the database file with a
+ * ReadOnlyBufferPoolManager and read the same tree through it
+ */
+TEST(BPlusTreeTests, ReadOnlyScanTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  const int64_t scale = 10000;
+  page_id_t root_page_id = INVALID_PAGE_ID;
+
+  {
+    DiskManager *disk_manager = new DiskManager("test.db");
+    BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+    // create header_page
+    page_id_t page_id;
+    bpm->NewPage(page_id);
+    bpm->UnpinPage(page_id, true);
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+
+    std::vector<int64_t> keys;
+    for (int64_t key = 1; key <= scale; key++) {
+      keys.push_back(key);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(15445));
+    GenericKey<8> index_key;
+    for (auto key : keys) {
+      index_key.SetFromInteger(key);
+      EXPECT_TRUE(tree.Insert(index_key, RID(key)));
+    }
+
+    HeaderPage *header_page =
+        static_cast<HeaderPage *>(bpm->FetchPage(HEADER_PAGE_ID));
+    EXPECT_TRUE(header_page->GetRootId("foo_pk", root_page_id));
+    bpm->UnpinPage(HEADER_PAGE_ID, false);
+
+    bpm->FlushAllPages();
+    delete bpm;
+    delete disk_manager;
+  }
+
+  ReadOnlyBufferPoolManager ro_bpm("test.db");
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree(
+      "foo_pk", &ro_bpm, comparator, root_page_id);
+
+  GenericKey<8> index_key;
+  std::vector<RID> rids;
+  for (int64_t key = 1; key <= scale; key += 97) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    EXPECT_TRUE(tree.GetValue(index_key, rids));
+    EXPECT_EQ(rids.size(), 1u);
+    EXPECT_EQ(static_cast<int64_t>(rids[0].GetSlotNum()), key);
+  }
+
+  // range scan from start_key, across the leaf chain to the last key
+  int64_t start_key = 1000;
+  int64_t current_key = start_key;
+  index_key.SetFromInteger(start_key);
+  for (auto iterator = tree.Begin(index_key); !iterator.isEnd();
+       ++iterator) {
+    EXPECT_EQ(static_cast<int64_t>((*iterator).second.GetSlotNum()),
+              current_key);
+    current_key = current_key + 1;
+  }
+  EXPECT_EQ(current_key, scale + 1);
+
+  // every view of the scan was given back
+  for (page_id_t page_id = 0;
+       page_id < static_cast<page_id_t>(ro_bpm.GetPoolSize()); page_id++) {
+    EXPECT_FALSE(ro_bpm.UnpinPage(page_id, false));
+  }
+
+  // nothing can be written through the mapping
+  index_key.SetFromInteger(scale + 1);
+  EXPECT_THROW(tree.Insert(index_key, RID(scale + 1)), Exception);
+
+  delete key_schema;
+  remove("test.db");
+  remove("test.log");
+}
+
+} // namespace scudb
@@ -2,6 +2,7 @@
  * index_iterator.cpp
  */
 #include <cassert>
+#include <utility>
 
 #include "index/index_iterator.h"
 
@@ -17,16 +18,18 @@ INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::IndexIterator() {}
 
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE::IndexIterator(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf, int index, BufferPoolManager *bufferPoolManager) : index_(index),leaf_(leaf), buff_pool_manager_(bufferPoolManager){}
-
+INDEXITERATOR_TYPE::IndexIterator(ReadPageGuard &&leaf_guard, int index, PageReader *pageReader, int read_ahead)
+    : index_(index), leaf_guard_(std::move(leaf_guard)),
+      leaf_(leaf_guard_.IsValid() ? leaf_guard_.As<B_PLUS_TREE_LEAF_PAGE_TYPE>() : nullptr),
+      page_reader_(pageReader), read_ahead_(read_ahead), prefetched_(0),
+      frontier_page_id_(leaf_ == nullptr ? INVALID_PAGE_ID : leaf_->GetPageId())
+{
+  ReadAhead();
+}
 
+// leaf_guard_释放叶子的读锁并unpin
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE::~IndexIterator() 
-{
-  buff_pool_manager_->FetchPage(leaf_->GetPageId())->RUnlatch();
-  buff_pool_manager_->UnpinPage(leaf_->GetPageId(), false);
-  buff_pool_manager_->UnpinPage(leaf_->GetPageId(), false);
-};
+INDEXITERATOR_TYPE::~IndexIterator() {}
 
 INDEX_TEMPLATE_ARGUMENTS
 bool INDEXITERATOR_TYPE::isEnd()
@@ -49,23 +52,57 @@ INDEXITERATOR_TYPE &INDEXITERATOR_TYPE::operator++()
   {
     page_id_t next_page_id = leaf_->GetNextPageId();
 
-    auto *page = buff_pool_manager_->FetchPage(next_page_id);
+    // 先锁住下一张叶子，赋值时才释放当前叶子
+    leaf_guard_ = page_reader_->FetchPageRead(next_page_id, &strategy_);
+    assert(leaf_guard_.IsValid());
 
-    page->RLatch();
-
-    buff_pool_manager_->FetchPage(leaf_->GetPageId())->RUnlatch();
-    buff_pool_manager_->UnpinPage(leaf_->GetPageId(), false);
-    buff_pool_manager_->UnpinPage(leaf_->GetPageId(), false);
-
-    auto next_leaf = reinterpret_cast<BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *>(page->GetData());
+    auto next_leaf = leaf_guard_.As<B_PLUS_TREE_LEAF_PAGE_TYPE>();
     assert(next_leaf->IsLeafPage());
     index_ = 0;
     leaf_ = next_leaf;
+
+    // 预取的窗口向前移动一张叶子
+    if (prefetched_ > 0)
+      prefetched_--;
+    else
+      frontier_page_id_ = next_page_id;
+    ReadAhead();
   }
 
   return *this;
 }
 
+/*
+ * Prefetch the leaves after leaf_ along the next_page_id_ chain, until
+ * read_ahead_ leaves are prefetched. The id of the leaf after the frontier is
+ * only known once the frontier is in memory, so stop at a frontier which is
+ * still loading and go on from there on the next leaf change
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::ReadAhead()
+{
+  while (prefetched_ < read_ahead_ && frontier_page_id_ != INVALID_PAGE_ID)
+  {
+    page_id_t next_page_id;
+    if (frontier_page_id_ == leaf_->GetPageId())
+    {
+      next_page_id = leaf_->GetNextPageId();
+    }
+    else
+    {
+      // 只看一眼，不算访问，预取的叶子在被扫描前保持冷
+      char data[PAGE_SIZE];
+      if (!page_reader_->PeekPage(frontier_page_id_, data))
+        break;
+      next_page_id = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(data)->GetNextPageId();
+    }
+    frontier_page_id_ = next_page_id;
+    if (next_page_id == INVALID_PAGE_ID || !page_reader_->PrefetchPage(next_page_id, &strategy_))
+      break;
+    prefetched_++;
+  }
+}
+
 template class IndexIterator<GenericKey<4>, RID, GenericComparator<4>>;
 template class IndexIterator<GenericKey<8>, RID, GenericComparator<8>>;
 template class IndexIterator<GenericKey<16>, RID, GenericComparator<16>>;
@@ -3,6 +3,8 @@
  * For range scan of b+ tree
  */
 #pragma once
+#include "buffer/access_strategy.h"
+#include "buffer/page_guard.h"
 #include "page/b_plus_tree_leaf_page.h"
 
 using namespace std;
@@ -12,14 +14,20 @@ namespace scudb {
 #define INDEXITERATOR_TYPE                                                     \
   IndexIterator<KeyType, ValueType, KeyComparator>
 
+// number of leaves prefetched ahead of the current one during a range scan
+#define INDEX_ITERATOR_READ_AHEAD 8
+
 INDEX_TEMPLATE_ARGUMENTS
 class IndexIterator {
 public:
   // you may define your own constructor based on your member variables
   IndexIterator();
 
-// 增加有参数的构造函数
-  IndexIterator(BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *,int, BufferPoolManager *);
+// 增加有参数的构造函数，接管已加读锁的叶子，read_ahead为沿叶子链预取的叶子数
+  IndexIterator(ReadPageGuard &&leaf_guard, int, PageReader *,
+                int read_ahead = INDEX_ITERATOR_READ_AHEAD);
+
+  IndexIterator(IndexIterator &&that) = default;
 
   ~IndexIterator();
 
@@ -30,10 +38,19 @@ public:
   IndexIterator &operator++();
 
 private:
+  void ReadAhead();
+
   // add your own private member variables here
   int index_;
+  ReadPageGuard leaf_guard_;     // read latch and pin of leaf_
   BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *leaf_;
-  BufferPoolManager *buff_pool_manager_;
+  PageReader *page_reader_;     // pool the leaves are read from
+  int read_ahead_;              // leaves to prefetch ahead of leaf_
+  int prefetched_;              // leaves already prefetched ahead of leaf_
+  page_id_t frontier_page_id_;  // last leaf prefetched along the chain
+  // a leaf read on a miss or prefetched takes a frame of this ring, a long scan does not
+  // push the rest of the pool out
+  AccessStrategy strategy_;
 };
 
 } // namespace scudb
\ No newline at end of file
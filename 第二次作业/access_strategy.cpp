@@ -0,0 +1,51 @@
+#include "buffer/access_strategy.h"
+#include "buffer/buffer_pool_manager.h"
+
+namespace scudb {
+
+AccessStrategy::AccessStrategy(size_t ring_size)
+    : ring_size_(ring_size > 0 ? ring_size : 1), reuses_(0) {}
+
+//丢弃还在各缓冲池预取队列中的请求，并等待正在调入的预取完成
+AccessStrategy::~AccessStrategy() {
+  std::vector<BufferPoolManager *> bpms;
+  {
+    std::lock_guard<std::mutex> lck(rings_latch_);
+    for (auto &ring : rings_) {
+      bpms.push_back(ring.bpm_);
+    }
+  }
+  for (auto bpm : bpms) {
+    bpm->ForgetStrategy(this);
+  }
+}
+
+//并行缓冲池的实例不多，顺序查找即可
+AccessStrategy::Ring &AccessStrategy::GetRing(BufferPoolManager *bpm) {
+  std::lock_guard<std::mutex> lck(rings_latch_);
+  for (auto &ring : rings_) {
+    if (ring.bpm_ == bpm) {
+      return ring;
+    }
+  }
+  Ring ring;
+  ring.bpm_ = bpm;
+  ring.slots_.assign(ring_size_, RingSlot{nullptr, INVALID_PAGE_ID});
+  ring.next_ = 0;
+  rings_.push_back(ring);
+  return rings_.back();
+}
+
+AccessStrategy::RingSlot &
+AccessStrategy::CurrentSlot(BufferPoolManager *bpm) {
+  Ring &ring = GetRing(bpm);
+  return ring.slots_[ring.next_];
+}
+
+void AccessStrategy::FillSlot(BufferPoolManager *bpm, Page *frame,
+                              page_id_t page_id) {
+  Ring &ring = GetRing(bpm);
+  ring.slots_[ring.next_] = RingSlot{frame, page_id};
+  ring.next_ = (ring.next_ + 1) % ring.slots_.size();
+}
+} // namespace scudb
@@ -0,0 +1,71 @@
+/*
+ * access_strategy.h
+ *
+ * Functionality: a small ring of buffer pool frames for a scan or a bulk
+ * load. A miss fetched under a strategy reuses the frame the ring filled
+ * ring_size misses ago, as long as that frame still holds the page the ring
+ * put there and nobody has it pinned, instead of evicting the coldest page of
+ * the whole pool. The pages of a long scan then only ever take ring_size
+ * frames and the working set of the other threads stays in the pool. Hits
+ * are not affected. Every pool the strategy is used with (every instance of
+ * a parallel pool) gets its own ring. A strategy must not outlive the pool
+ * and is used by one thread at a time, apart from the prefetchers of the pool
+ * loading the pages it prefetched; its destructor drops those that are still
+ * queued.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "page/page.h"
+
+namespace scudb {
+#define SCAN_RING_SIZE 16 // frames of the ring of a scan
+// dirty pages of a bulk load are written back when their frame is reused, a
+// larger ring spreads these writes out
+#define BULK_RING_SIZE 64
+
+class BufferPoolManager;
+
+class AccessStrategy {
+public:
+  explicit AccessStrategy(size_t ring_size = SCAN_RING_SIZE);
+
+  ~AccessStrategy();
+
+  inline size_t GetRingSize() const { return ring_size_; }
+
+  // number of misses served by reusing a frame of the ring
+  inline size_t GetReuses() const { return reuses_.load(); }
+
+private:
+  friend class BufferPoolManager;
+
+  struct RingSlot {
+    Page *frame_;
+    page_id_t page_id_; // page the ring loaded into frame_
+  };
+  struct Ring {
+    BufferPoolManager *bpm_;
+    std::vector<RingSlot> slots_;
+    size_t next_; // slot the next miss reuses
+  };
+
+  // slot the next miss of bpm may reuse
+  RingSlot &CurrentSlot(BufferPoolManager *bpm);
+  // record the frame a miss of bpm loaded page_id into, and move on
+  void FillSlot(BufferPoolManager *bpm, Page *frame, page_id_t page_id);
+  // a ring is only used under the latch of its pool, but the prefetchers of
+  // the other instances of a parallel pool may add rings at the same time
+  Ring &GetRing(BufferPoolManager *bpm);
+
+  size_t ring_size_;
+  std::mutex rings_latch_;  // protects rings_, not the rings themselves
+  std::deque<Ring> rings_;  // one per pool, never moved once added
+  std::atomic<size_t> reuses_;
+};
+} // namespace scudb
@@ -0,0 +1,273 @@
+/**
+ * ARC implementation
+ */
+#include "buffer/arc_replacer.h"
+#include "page/page.h"
+
+namespace scudb {
+
+//幽灵链表里记录的是页号，而不是帧
+//缓冲池只在帧被pin住或已被取走时调用replacer，这时页号不会被改写
+static int64_t GhostKey(Page *page) { return page->GetPageId(); }
+static int64_t GhostKey(int value) { return value; }
+
+// names of the counters of stats_, in the order of StatsCounter
+static const std::vector<std::string> ARC_STATS_COUNTERS = {
+    "inserts", "cold_inserts", "erases", "victims", "empty_victims",
+    "evictions", "b1_hits", "b2_hits"};
+
+template <typename T>
+ARCReplacer<T>::ARCReplacer(T first_frame, size_t num_frames)
+    : first_frame_(first_frame), num_frames_(num_frames),
+      cache_size_(num_frames),
+      prev_(num_frames + 2), next_(num_frames + 2),
+      list_of_(num_frames, NONE), key_(num_frames, 0), referenced_(num_frames, 0),
+      evictable_(num_frames, 0), list_size_{0, 0}, target_t1_size_(0),
+      size_(0), stats_(ARC_STATS_COUNTERS, {}) {
+  for (size_t sentinel = 0; sentinel < 2; ++sentinel) {
+    prev_[sentinel] = next_[sentinel] = sentinel;
+  }
+}
+
+template <typename T> ARCReplacer<T>::~ARCReplacer() {}
+
+//将可替换的帧从链表中摘下，帧仍计入所属链表的长度
+template <typename T> void ARCReplacer<T>::Unlink(size_t frame) {
+  size_t node = Node(frame);
+  next_[prev_[node]] = next_[node];
+  prev_[next_[node]] = prev_[node];
+}
+
+//将帧链到T1或T2的头部
+template <typename T>
+void ARCReplacer<T>::PushFront(ListId list_id, size_t frame) {
+  size_t node = Node(frame);
+  size_t sentinel = list_id;
+  prev_[node] = sentinel;
+  next_[node] = next_[sentinel];
+  prev_[next_[sentinel]] = node;
+  next_[sentinel] = node;
+}
+
+//改变帧所属的链表，只调整链表长度，不改变链接
+template <typename T>
+void ARCReplacer<T>::MoveTo(size_t frame, ListId list_id) {
+  if (list_of_[frame] != NONE) {
+    list_size_[list_of_[frame]]--;
+  }
+  list_of_[frame] = list_id;
+  if (list_id != NONE) {
+    list_size_[list_id]++;
+  }
+}
+
+//记录被换出的页号，幽灵链表的总长度不超过帧数
+template <typename T>
+void ARCReplacer<T>::AddGhost(GhostList &ghost, int64_t key) {
+  ghost.keys.push_front(key);
+  ghost.map[key] = ghost.keys.begin();
+  if (list_size_[T1] + ghost_[T1].keys.size() > cache_size_ &&
+      !ghost_[T1].keys.empty()) {
+    ghost_[T1].map.erase(ghost_[T1].keys.back());
+    ghost_[T1].keys.pop_back();
+  }
+  if (ghost_[T1].keys.size() + ghost_[T2].keys.size() > cache_size_ &&
+      !ghost_[T2].keys.empty()) {
+    ghost_[T2].map.erase(ghost_[T2].keys.back());
+    ghost_[T2].keys.pop_back();
+  }
+}
+
+template <typename T>
+bool ARCReplacer<T>::RemoveGhost(GhostList &ghost, int64_t key) {
+  auto it = ghost.map.find(key);
+  if (it == ghost.map.end()) {
+    return false;
+  }
+  ghost.keys.erase(it->second);
+  ghost.map.erase(it);
+  return true;
+}
+
+/*
+ * Record a reference of the frame and mark it as evictable. The first
+ * reference after a page is loaded into the frame adapts p when the page is
+ * found in a ghost list, a page referenced again moves to the front of T2
+ */
+template <typename T> void ARCReplacer<T>::Insert(const T &value) {
+  lock_guard<mutex> lck(latch);
+  size_t frame = FrameIndex(value);
+  stats_.Add(STAT_INSERTS);
+  int64_t key = GhostKey(value);
+  //下面重新链到所属链表的头部
+  if (evictable_[frame]) {
+    Unlink(frame);
+  }
+  if (list_of_[frame] != NONE && key_[frame] == key && referenced_[frame]) {
+    //再次访问的页移到T2
+    MoveTo(frame, T2);
+  } else {
+    //新调入的页，或预取后第一次被访问的页
+    key_[frame] = key;
+    referenced_[frame] = 1;
+    size_t b1_size = ghost_[T1].keys.size();
+    size_t b2_size = ghost_[T2].keys.size();
+    if (RemoveGhost(ghost_[T1], key)) {
+      //在B1中命中，说明T1太小，增大p
+      stats_.Add(STAT_B1_HITS);
+      size_t delta = max<size_t>(b2_size / b1_size, 1);
+      target_t1_size_ = min(cache_size_, target_t1_size_ + delta);
+      MoveTo(frame, T2);
+    } else if (RemoveGhost(ghost_[T2], key)) {
+      //在B2中命中，说明T2太小，减小p
+      stats_.Add(STAT_B2_HITS);
+      size_t delta = max<size_t>(b1_size / b2_size, 1);
+      target_t1_size_ = target_t1_size_ > delta ? target_t1_size_ - delta : 0;
+      MoveTo(frame, T2);
+    } else {
+      MoveTo(frame, T1);
+    }
+  }
+  PushFront(list_of_[frame], frame);
+  if (!evictable_[frame]) {
+    evictable_[frame] = 1;
+    size_++;
+  }
+}
+
+template <typename T> void ARCReplacer<T>::InsertCold(const T &value) {
+  lock_guard<mutex> lck(latch);
+  size_t frame = FrameIndex(value);
+  stats_.Add(STAT_COLD_INSERTS);
+  int64_t key = GhostKey(value);
+  if (list_of_[frame] == NONE || key_[frame] != key) {
+    //预取的页不查幽灵链表，等第一次真正访问时再调整p
+    if (evictable_[frame]) {
+      Unlink(frame);
+    }
+    key_[frame] = key;
+    referenced_[frame] = 0;
+    MoveTo(frame, T1);
+    PushFront(T1, frame);
+  } else if (!evictable_[frame]) {
+    //已在T1或T2中的页回到所属链表
+    PushFront(list_of_[frame], frame);
+  }
+  if (!evictable_[frame]) {
+    evictable_[frame] = 1;
+    size_++;
+  }
+}
+
+/* Take the LRU end of T1 when T1 is larger than its target size p, otherwise
+ * of T2, falling back to the other list when the chosen one has no evictable
+ * frame. The victim keeps counting in its list until Evict. Return false if
+ * no frame can be evicted
+ */
+template <typename T> bool ARCReplacer<T>::Victim(T &value) {
+  lock_guard<mutex> lck(latch);
+  if (size_ == 0) {
+    stats_.Add(STAT_EMPTY_VICTIMS);
+    return false;
+  }
+  stats_.Add(STAT_VICTIMS);
+  size_t from = (list_size_[T1] > 0 && list_size_[T1] > target_t1_size_) ? T1 : T2;
+  //链表中只有可替换的帧，哨兵的前一个节点就是最久未访问的帧
+  if (prev_[from] == from) {
+    from = from == T1 ? T2 : T1;
+  }
+  size_t frame = prev_[from] - 2;
+  Unlink(frame);
+  evictable_[frame] = 0;
+  size_--;
+  value = FrameAt(first_frame_, frame);
+  return true;
+}
+
+/*
+ * The page id is remembered in B1 or B2 only now, after the frame left T1 or
+ * T2, so the ghost lists stay bounded by the cache size
+ */
+template <typename T> void ARCReplacer<T>::Evict(const T &value) {
+  lock_guard<mutex> lck(latch);
+  size_t frame = FrameIndex(value);
+  if (frame >= num_frames_ || list_of_[frame] == NONE) {
+    return;
+  }
+  ListId from = list_of_[frame];
+  if (evictable_[frame]) {
+    Unlink(frame);
+    evictable_[frame] = 0;
+    size_--;
+  }
+  MoveTo(frame, NONE);
+  AddGhost(ghost_[from], key_[frame]);
+  stats_.Add(STAT_EVICTIONS);
+}
+
+/*
+ * Unlink the frame, it keeps counting in T1 or T2 and goes back to the front
+ * of its list with its next Insert. If removal is successful, return true,
+ * otherwise return false
+ */
+template <typename T> bool ARCReplacer<T>::Erase(const T &value) {
+  lock_guard<mutex> lck(latch);
+  size_t frame = FrameIndex(value);
+  if (frame >= num_frames_ || !evictable_[frame]) {
+    return false;
+  }
+  Unlink(frame);
+  evictable_[frame] = 0;
+  size_--;
+  stats_.Add(STAT_ERASES);
+  return true;
+}
+
+//返回可替换帧的数量
+template <typename T> size_t ARCReplacer<T>::Size() {
+  lock_guard<mutex> lck(latch);
+  return size_;
+}
+
+//返回当前的自适应参数p和各链表的长度
+template <typename T> ARCStats ARCReplacer<T>::GetStats() {
+  lock_guard<mutex> lck(latch);
+  return ARCStats{target_t1_size_, list_size_[T1], list_size_[T2],
+                  ghost_[T1].keys.size(), ghost_[T2].keys.size(),
+                  target_t1_size_, target_t1_size_};
+}
+
+template <typename T>
+std::string ARCReplacer<T>::DumpStats(const std::string &prefix) {
+  ARCStats arc_stats = GetStats();
+  return prefix + ".size " + std::to_string(Size()) + "\n" + prefix +
+         ".arc_p " + std::to_string(arc_stats.target_t1_size) + "\n" +
+         prefix + ".arc_t1 " + std::to_string(arc_stats.t1_size) + "\n" +
+         prefix + ".arc_t2 " + std::to_string(arc_stats.t2_size) + "\n" +
+         prefix + ".arc_b1 " + std::to_string(arc_stats.b1_size) + "\n" +
+         prefix + ".arc_b2 " + std::to_string(arc_stats.b2_size) + "\n" +
+         stats_.Dump(prefix);
+}
+
+//缓冲池扩容或缩容后调整c，并按新的c截断幽灵链表
+template <typename T> void ARCReplacer<T>::SetCacheSize(size_t cache_size) {
+  lock_guard<mutex> lck(latch);
+  cache_size_ = min(cache_size, num_frames_);
+  target_t1_size_ = min(target_t1_size_, cache_size_);
+  while (!ghost_[T1].keys.empty() &&
+         list_size_[T1] + ghost_[T1].keys.size() > cache_size_) {
+    ghost_[T1].map.erase(ghost_[T1].keys.back());
+    ghost_[T1].keys.pop_back();
+  }
+  while (!ghost_[T2].keys.empty() &&
+         ghost_[T1].keys.size() + ghost_[T2].keys.size() > cache_size_) {
+    ghost_[T2].map.erase(ghost_[T2].keys.back());
+    ghost_[T2].keys.pop_back();
+  }
+}
+
+template class ARCReplacer<Page *>;
+// test only
+template class ARCReplacer<int>;
+
+} // namespace scudb
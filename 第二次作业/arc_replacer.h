@@ -0,0 +1,125 @@
+/**
+ * arc_replacer.h
+ *
+ * Functionality: Adaptive Replacement Cache policy. Resident frames are kept
+ * in two LRU lists, T1 for pages referenced once since they were loaded and T2
+ * for pages referenced again. The page ids recently evicted from T1 and T2 are
+ * remembered in the ghost lists B1 and B2. Loading a page found in B1 means T1
+ * was too small and grows its target size p, a page found in B2 shrinks it, so
+ * the split between recency and frequency follows the workload by itself.
+ *
+ * A pinned frame still counts in the size of its list but is unlinked from it,
+ * only evictable frames are linked, so Victim takes the tail of a list in
+ * O(1). Victim only picks the frame: the pool may fail to claim it (pinned
+ * again by a hit in the meantime), so the page is remembered in B1 or B2 when
+ * the pool calls Evict, once the eviction is committed.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "buffer/frame_arena.h"
+#include "buffer/metrics.h"
+#include "buffer/replacer.h"
+
+using namespace std;
+namespace scudb {
+
+// current state of the ARC replacer
+struct ARCStats {
+  size_t target_t1_size; // adaptation parameter p
+  size_t t1_size;
+  size_t t2_size;
+  size_t b1_size;
+  size_t b2_size;
+  // smallest and largest p over the instances of a parallel pool, both are
+  // p for a single replacer
+  size_t min_target_t1_size;
+  size_t max_target_t1_size;
+};
+
+template <typename T> class ARCReplacer : public Replacer<T> {
+  enum ListId { NONE = -1, T1 = 0, T2 = 1 };
+  // ghost list of page ids, most recently evicted at the front
+  struct GhostList {
+    list<int64_t> keys;
+    unordered_map<int64_t, list<int64_t>::iterator> map;
+  };
+public:
+  // frames are the num_frames values starting at first_frame
+  ARCReplacer(T first_frame, size_t num_frames);
+
+  ~ARCReplacer();
+
+  void Insert(const T &value);
+
+  // mark the frame as evictable without a reference: a page new in the frame
+  // (prefetched) goes to T1 and its first Insert still counts as the first
+  // reference, a page already in T1 or T2 stays where it is
+  void InsertCold(const T &value);
+
+  bool Victim(T &value);
+
+  // the frame returned by Victim was claimed, its page leaves T1 or T2 for
+  // the ghost list. A victim never claimed stays in its list and comes back
+  // with its next Insert
+  void Evict(const T &value);
+
+  bool Erase(const T &value);
+
+  size_t Size();
+
+  ARCStats GetStats();
+
+  // text dump of p, the list sizes and the replacer counters, see Metrics
+  std::string DumpStats(const std::string &prefix);
+
+  // number of frames the pool currently uses, which bounds p and the ghost
+  // lists, at most num_frames. Equal to num_frames until it is set
+  void SetCacheSize(size_t cache_size);
+
+private:
+  inline size_t FrameIndex(const T &value) const {
+    return FrameOffset(value, first_frame_);
+  }
+  // node 0 and 1 are the sentinels of T1 and T2, frame i uses node i + 2
+  inline size_t Node(size_t frame) const { return frame + 2; }
+  void Unlink(size_t frame);
+  void PushFront(ListId list_id, size_t frame);
+  void MoveTo(size_t frame, ListId list_id);
+  void AddGhost(GhostList &ghost, int64_t key);
+  bool RemoveGhost(GhostList &ghost, int64_t key);
+
+  T first_frame_;
+  size_t num_frames_;
+  size_t cache_size_;        // c of the ARC paper
+  vector<size_t> prev_;      // previous node of each node
+  vector<size_t> next_;      // next node of each node
+  vector<ListId> list_of_;   // list the frame counts in, linked if evictable
+  vector<int64_t> key_;      // page held by the frame
+  vector<char> referenced_;  // whether the page was referenced since loaded
+  vector<char> evictable_;   // whether the frame can be evicted
+  size_t list_size_[2];      // size of T1 and T2, pinned frames included
+  GhostList ghost_[2];       // B1 and B2
+  size_t target_t1_size_;    // adaptation parameter p
+  size_t size_;              // number of evictable frames
+  mutable mutex latch;
+  enum StatsCounter {
+    STAT_INSERTS,
+    STAT_COLD_INSERTS,
+    STAT_ERASES,
+    STAT_VICTIMS,
+    STAT_EMPTY_VICTIMS,
+    STAT_EVICTIONS,
+    STAT_B1_HITS,
+    STAT_B2_HITS
+  };
+  Metrics stats_;
+};
+
+} // namespace scudb
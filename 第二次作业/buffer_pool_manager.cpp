@@ -1,40 +1,183 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <new>
+#include <sstream>
+#include <thread>
+
 #include "buffer/buffer_pool_manager.h"
+#include "common/exception.h"
 
 namespace scudb {
 
+// names of the counters and histograms of stats_, in the order of
+// StatsCounter and StatsHistogram
+static const std::vector<std::string> STATS_COUNTERS = {
+    "hits", "misses", "evictions", "dirty_writebacks", "disk_reads",
+    "disk_writes", "latch_waits"};
+static const std::vector<std::string> STATS_HISTOGRAMS = {
+    "fetch_hit_ns", "fetch_miss_ns", "disk_read_ns", "disk_write_ns",
+    "latch_wait_ns"};
+
 /*
  * BufferPoolManager Constructor
  * When log_manager is nullptr, logging is disabled (for test purpose)
+ * replacer_type selects the replacement policy, LRU by default, lru_k is the K
+ * of the LRU-K policy
  * WARNING: Do Not Edit This Function
  */
 
 //初始化缓冲池管理器
 BufferPoolManager::BufferPoolManager(size_t pool_size,
                                                  DiskManager *disk_manager,
-                                                 LogManager *log_manager)
-    : pool_size_(pool_size), disk_manager_(disk_manager),
-      log_manager_(log_manager) {
-  // a consecutive memory space for buffer pool
-  pages_ = new Page[pool_size_];
+                                                 LogManager *log_manager,
+                                                 ReplacerType replacer_type,
+                                                 size_t lru_k,
+                                                 HugePageMode huge_pages)
+    : BufferPoolManager(pool_size, 1, 0, disk_manager, log_manager,
+                        replacer_type, lru_k, huge_pages) {}
+
+/*
+ * Constructor of one instance of ParallelBufferPoolManager
+ * The instance only allocates page ids where
+ * page_id % num_instances == instance_index, so the parallel pool can route a
+ * page id back to the instance owning it
+ */
+BufferPoolManager::BufferPoolManager(size_t pool_size,
+                                     uint32_t num_instances,
+                                     uint32_t instance_index,
+                                     DiskManager *disk_manager,
+                                     LogManager *log_manager,
+                                     ReplacerType replacer_type,
+                                     size_t lru_k, HugePageMode huge_pages)
+    : disk_manager_(disk_manager), log_manager_(log_manager),
+      disk_scheduler_(new DiskScheduler(disk_manager)),
+      owns_disk_scheduler_(true), page_store_(nullptr),
+      pool_size_(pool_size), num_instances_(num_instances),
+      instance_index_(instance_index), next_page_id_(instance_index),
+      cleaner_running_(false), cleaner_max_pages_(0), cleaner_interval_(0),
+      cleaner_hand_(0), pages_cleaned_(0), dirty_victims_(0),
+      prefetch_stop_(false), stats_(STATS_COUNTERS, STATS_HISTOGRAMS) {
+  assert(num_instances_ > 0 && instance_index_ < num_instances_);
+  //在分配帧之前检查，否则LRU-K替换器抛出异常时已分配的内存无人释放
+  if (replacer_type == ReplacerType::LRU_K && lru_k == 0) {
+    delete disk_scheduler_;
+    throw Exception("can't build an LRU-K replacer with K = 0");
+  }
+  // a consecutive memory space for buffer pool, the address space of
+  // capacity_ frames is reserved so that Grow keeps the pages contiguous,
+  // only the frames in use are constructed and backed by memory
+  capacity_ = pool_size_ * MAX_POOL_SIZE_FACTOR;
+  arena_ = new FrameArena(capacity_ * FRAME_STRIDE, huge_pages);
+  pages_ = static_cast<Page *>(arena_->GetData());
+  for (size_t i = 0; i < pool_size_; ++i) {
+    new (GetFrame(i)) Page();
+  }
   page_table_ = new ExtendibleHash<page_id_t, Page *>(BUCKET_SIZE);
-  replacer_ = new LRUReplacer<Page *>;
+  switch (replacer_type) {
+  case ReplacerType::CLOCK:
+    replacer_ = new ClockReplacer<Page *>(pages_, capacity_);
+    break;
+  case ReplacerType::LRU_K:
+    replacer_ = new LRUKReplacer<Page *>(pages_, capacity_, lru_k);
+    break;
+  case ReplacerType::ARC:
+    replacer_ = new ARCReplacer<Page *>(pages_, capacity_);
+    break;
+  default:
+    replacer_ = new LRUReplacer<Page *>(pages_, capacity_);
+    break;
+  }
   free_list_ = new std::list<Page *>;
+  free_space_map_ = new FreeSpaceMap(this, instance_index_, num_instances_);
+  victim_cache_ = nullptr;
+  SetReplacerCacheSize();
+  frame_states_ = new FrameState[capacity_];
+  frame_cvs_ = new std::condition_variable[capacity_];
+  ring_frames_ = new std::atomic<bool>[capacity_];
+  for (size_t i = 0; i < capacity_; ++i) {
+    ring_frames_[i].store(false);
+  }
+  // at least 2 entries of the hit table per frame
+  hit_buckets_ = 1;
+  while (hit_buckets_ * HIT_TABLE_WAYS < 2 * capacity_) {
+    hit_buckets_ <<= 1;
+  }
+  hit_table_ = new std::atomic<uint64_t>[hit_buckets_ * HIT_TABLE_WAYS];
+  for (size_t i = 0; i < hit_buckets_ * HIT_TABLE_WAYS; ++i) {
+    hit_table_[i].store(0);
+  }
+  hit_readers_ = new HitReaders[METRICS_SHARDS];
+  for (size_t i = 0; i < METRICS_SHARDS; ++i) {
+    hit_readers_[i].count.store(0);
+  }
 
   // put all the pages into free list
   for (size_t i = 0; i < pool_size_; ++i) {
-    free_list_->push_back(&pages_[i]);
+    free_list_->push_back(GetFrame(i));
+    frame_states_[i] = FrameState::FREE;
+    StorePinCount(GetFrame(i), FRAME_UNPINNABLE);
+  }
+  for (size_t i = pool_size_; i < capacity_; ++i) {
+    frame_states_[i] = FrameState::RETIRED;
   }
 }
 
+/*
+ * Constructor for pools that only dispatch to other instances and do not own
+ * any frame themselves. The pool is a valid pool without frames, so a method
+ * the subclass does not override finds no page instead of null members
+ */
+BufferPoolManager::BufferPoolManager(DiskManager *disk_manager,
+                                     LogManager *log_manager)
+    : BufferPoolManager(0, 1, 0, disk_manager, log_manager) {}
+
 /*
  * BufferPoolManager Deconstructor
  * WARNING: Do Not Edit This Function
  */
 BufferPoolManager::~BufferPoolManager() {
-  delete[] pages_;
+  StopPageCleaner();
+  {
+    lock_guard<mutex> lck(latch_);
+    prefetch_stop_ = true;
+  }
+  prefetch_cv_.notify_all();
+  for (auto &prefetcher : prefetchers_) {
+    prefetcher.join();
+  }
+  //热启动：记下关闭时驻留的页，供下一个缓冲池调入
+  if (!manifest_file_.empty() && replacer_ != nullptr) {
+    vector<page_id_t> page_ids;
+    GetResidentPages(page_ids);
+    WriteManifest(manifest_file_, page_ids);
+  }
+  //等待仍在进行的预取读入完成，共享的调度器由并行缓冲池释放
+  if (owns_disk_scheduler_) {
+    delete disk_scheduler_;
+  } else {
+    disk_scheduler_->Drain();
+  }
+  //写完所有页后保存压缩文件的页映射
+  delete page_store_;
+  delete free_space_map_;
+  delete victim_cache_;
+  for (size_t i = 0; i < pool_size_; ++i) {
+    GetFrame(i)->~Page();
+  }
+  delete arena_;
   delete page_table_;
   delete replacer_;
   delete free_list_;
+  delete[] frame_states_;
+  delete[] frame_cvs_;
+  delete[] ring_frames_;
+  delete[] hit_table_;
+  delete[] hit_readers_;
 }
 
 /**
@@ -86,36 +229,517 @@ BufferPoolManager::~BufferPoolManager() {
 //   return tar;
 // }
 
-Page *BufferPoolManager::FetchPage(page_id_t page_id) {
-  //锁住该缓冲池
-  lock_guard<mutex> lck(latch_);
+Page *BufferPoolManager::FetchPage(page_id_t page_id,
+                                   AccessStrategy *strategy) {
+  uint64_t start = Metrics::Now();
+  //命中时不加缓冲池的锁，只对该帧的pin值原子加一
+  Page *page = TryPinResident(page_id);
+  if (page != nullptr) {
+    if (strategy == nullptr) {
+      LeaveRing(page);
+    }
+    //每次取页都算一次访问，不只是最后一次unpin
+    replacer_->RecordAccess(page);
+    stats_.Add(STAT_HITS);
+    stats_.RecordSince(STAT_FETCH_HIT_NS, start);
+    return page;
+  }
+  //未命中或者该帧正在换入换出时，锁住该缓冲池，磁盘读写期间会暂时释放
+  unique_lock<mutex> lck = LockLatch();
+  bool hit = false;
+  page = FetchPageImpl(page_id, lck, true, &hit, strategy);
+  if (page != nullptr) {
+    if (hit && strategy == nullptr) {
+      LeaveRing(page);
+    }
+    replacer_->RecordAccess(page);
+    stats_.Add(hit ? STAT_HITS : STAT_MISSES);
+    stats_.RecordSince(hit ? STAT_FETCH_HIT_NS : STAT_FETCH_MISS_NS, start);
+  }
+  return page;
+}
+
+/*
+ * A page of a ring that is fetched without the strategy is used by more than
+ * the scan, its next unpin counts as an access again
+ */
+void BufferPoolManager::LeaveRing(Page *page) {
+  std::atomic<bool> &ring_frame = ring_frames_[FrameIndex(page)];
+  if (ring_frame.load(memory_order_relaxed)) {
+    ring_frame.store(false, memory_order_relaxed);
+  }
+}
+
+/*
+ * Lock the latch, the time spent waiting for it is recorded when the metrics
+ * are enabled
+ */
+unique_lock<mutex> BufferPoolManager::LockLatch() {
+  if (!Metrics::Enabled()) {
+    return unique_lock<mutex>(latch_);
+  }
+  unique_lock<mutex> lck(latch_, try_to_lock);
+  if (!lck.owns_lock()) {
+    uint64_t start = Metrics::Now();
+    lck.lock();
+    stats_.Add(STAT_LATCH_WAITS);
+    stats_.RecordSince(STAT_LATCH_WAIT_NS, start);
+  }
+  return lck;
+}
+
+/*
+ * Lock free hit path: find the frame in the hit table and pin it, then check
+ * the frame still holds page_id, the check is stable because a pinned frame
+ * cannot be claimed for eviction.
+ * @return: nullptr if the latched path has to be taken
+ */
+Page *BufferPoolManager::TryPinResident(page_id_t page_id) {
+  HitReaders &readers = EnterHitPath();
+  Page *page = LookupHitTable(page_id);
+  int pins = page == nullptr ? -1 : PinFrame(page);
+  if (pins >= 0 &&
+      LoadPageId(page) != page_id) {
+    //表项已过期，帧里换成了别的页
+    ReleasePin(page, false);
+    pins = -1;
+  }
+  readers.count.fetch_sub(1, memory_order_release);
+  if (pins < 0) {
+    return nullptr;
+  }
+  if (pins == 0) {
+    replacer_->Erase(page);
+  }
+  return page;
+}
+
+//每个线程固定使用一个计数分片
+static size_t HitReadersShard() {
+  static std::atomic<size_t> next_shard(0);
+  static thread_local size_t shard =
+      next_shard.fetch_add(1, memory_order_relaxed) % METRICS_SHARDS;
+  return shard;
+}
+
+/*
+ * Enter a lock free path, the caller decrements the returned count when it
+ * no longer looks at a frame it has not pinned
+ */
+BufferPoolManager::HitReaders &BufferPoolManager::EnterHitPath() {
+  HitReaders &readers = hit_readers_[HitReadersShard()];
+  readers.count.fetch_add(1, memory_order_seq_cst);
+  return readers;
+}
+
+/*
+ * Wait until every thread that was inside a lock free path has left it.
+ * Threads entering later cannot reach the frames whose hit table entries are
+ * already removed
+ */
+void BufferPoolManager::WaitForHitReaders() {
+  atomic_thread_fence(memory_order_seq_cst);
+  for (size_t i = 0; i < METRICS_SHARDS; ++i) {
+    while (hit_readers_[i].count.load(memory_order_seq_cst) != 0) {
+      this_thread::yield();
+    }
+  }
+}
+
+/*
+ * Increment the pin count of a resident frame.
+ * @return: the pin count before the increment, -1 if the frame is free,
+ * loading or being evicted
+ */
+int BufferPoolManager::PinFrame(Page *page) {
+  int pins = LoadPinCount(page);
+  for (;;) {
+    //最后一个使用者正在把该帧交给replacer，很快结束
+    if (pins == FRAME_RELEASING) {
+      this_thread::yield();
+      pins = LoadPinCount(page);
+      continue;
+    }
+    if (pins < 0) {
+      return -1;
+    }
+    if (CasPinCount(page, pins, pins + 1)) {
+      return pins;
+    }
+  }
+}
+
+/*
+ * Decrement the pin count. The last unpin inserts the frame into the replacer
+ * before the count reaches 0, so an unpinned resident frame is always known
+ * to the replacer even if an evictor popped it while it was still pinned.
+ * @return: false if the frame was not pinned
+ */
+bool BufferPoolManager::ReleasePin(Page *page, bool accessed) {
+  int pins = LoadPinCount(page);
+  for (;;) {
+    if (pins <= 0) {
+      return false;
+    }
+    if (pins > 1) {
+      if (CasPinCount(page, pins, pins - 1)) {
+        return true;
+      }
+      continue;
+    }
+    if (CasPinCount(page, pins, FRAME_RELEASING)) {
+      //环中的页只被扫描用到，不把它当作热页
+      if (accessed && !ring_frames_[FrameIndex(page)].load(memory_order_relaxed)) {
+        replacer_->Insert(page);
+      } else {
+        replacer_->InsertCold(page);
+      }
+      StorePinCount(page, 0);
+      return true;
+    }
+  }
+}
+
+/*
+ * Take a frame with no pin for eviction or deletion, it cannot be pinned by
+ * the hit path afterwards. Called with the latch held
+ * @return: false if the frame is pinned
+ */
+bool BufferPoolManager::ClaimFrame(Page *page) {
+  int pins = LoadPinCount(page);
+  for (;;) {
+    if (pins == FRAME_RELEASING) {
+      this_thread::yield();
+      pins = LoadPinCount(page);
+      continue;
+    }
+    if (pins != 0) {
+      return false;
+    }
+    if (CasPinCount(page, pins, FRAME_UNPINNABLE)) {
+      //最后一次unpin可能在replacer选中它之后又把它放了回去
+      replacer_->Erase(page);
+      return true;
+    }
+  }
+}
+
+/*
+ * Ask the replacer for victims until one can be claimed, a frame pinned by
+ * the hit path after it was handed to the replacer is skipped, its last unpin
+ * gives it back. Called with the latch held
+ * @return: false if no frame can be evicted
+ */
+bool BufferPoolManager::PopVictim(Page *&victim) {
+  while (replacer_->Victim(victim)) {
+    if (ClaimFrame(victim)) {
+      //确定换出后才通知replacer，ARC在这时把页号记入幽灵链表
+      replacer_->Evict(victim);
+      return true;
+    }
+  }
+  return false;
+}
+
+//哈希表的一个桶，同一页号只会在这一个桶中
+Page *BufferPoolManager::LookupHitTable(page_id_t page_id) {
+  size_t bucket = (static_cast<uint32_t>(page_id) * 2654435761u) & (hit_buckets_ - 1);
+  std::atomic<uint64_t> *entries = &hit_table_[bucket * HIT_TABLE_WAYS];
+  for (size_t i = 0; i < HIT_TABLE_WAYS; ++i) {
+    uint64_t entry = entries[i].load(memory_order_seq_cst);
+    if (entry != 0 && static_cast<uint32_t>(entry >> 32) == static_cast<uint32_t>(page_id)) {
+      return GetFrame(static_cast<uint32_t>(entry) - 1);
+    }
+  }
+  return nullptr;
+}
+
+//桶满时不插入，该页只能通过加锁的路径命中
+void BufferPoolManager::PublishHitTable(page_id_t page_id, Page *page) {
+  size_t bucket = (static_cast<uint32_t>(page_id) * 2654435761u) & (hit_buckets_ - 1);
+  std::atomic<uint64_t> *entries = &hit_table_[bucket * HIT_TABLE_WAYS];
+  std::atomic<uint64_t> *empty = nullptr;
+  for (size_t i = 0; i < HIT_TABLE_WAYS; ++i) {
+    uint64_t entry = entries[i].load(memory_order_relaxed);
+    if (entry == 0) {
+      if (empty == nullptr) {
+        empty = &entries[i];
+      }
+    } else if (static_cast<uint32_t>(entry >> 32) == static_cast<uint32_t>(page_id)) {
+      return;
+    }
+  }
+  if (empty != nullptr) {
+    empty->store((static_cast<uint64_t>(static_cast<uint32_t>(page_id)) << 32) |
+                     (FrameIndex(page) + 1),
+                 memory_order_release);
+  }
+}
+
+void BufferPoolManager::RemoveHitTable(page_id_t page_id) {
+  size_t bucket = (static_cast<uint32_t>(page_id) * 2654435761u) & (hit_buckets_ - 1);
+  std::atomic<uint64_t> *entries = &hit_table_[bucket * HIT_TABLE_WAYS];
+  for (size_t i = 0; i < HIT_TABLE_WAYS; ++i) {
+    uint64_t entry = entries[i].load(memory_order_relaxed);
+    if (entry != 0 && static_cast<uint32_t>(entry >> 32) == static_cast<uint32_t>(page_id)) {
+      entries[i].store(0, memory_order_release);
+    }
+  }
+}
+
+/*
+ * Shared by FetchPage, FetchPages and the prefetchers. When pin is false the
+ * page is loaded without being pinned and handed to the replacer once it is
+ * resident, a page already in the pool (even still loading) is left alone.
+ * When read is given the read of a miss is not waited for: the I/O thread
+ * finishes the load and *read is ready once the page can be used
+ */
+Page *BufferPoolManager::FetchPageImpl(page_id_t page_id,
+                                       unique_lock<mutex> &lck, bool pin,
+                                       bool *hit, AccessStrategy *strategy,
+                                       future<void> *read) {
   Page *fetch_page = nullptr;
-  //先在存放所有页表的哈希表中查找有没有该页表，如果有那么让pin值+1并且在lru队列中删除该页表，返回该页表的指针
-  if (page_table_->Find(page_id,fetch_page)) { //1.1
-    fetch_page->pin_count_++;
-    replacer_->Erase(fetch_page);
-    return fetch_page;
-  }else{
+  for (;;) {
+    //先在存放所有页表的哈希表中查找有没有该页表，如果有那么让pin值+1并且在lru队列中删除该页表，返回该页表的指针
+    if (page_table_->Find(page_id, fetch_page)) { //1.1
+      if (!pin) {
+        return fetch_page;
+      }
+      size_t frame_id = FrameIndex(fetch_page);
+      //该页正在被其他线程调入或写回，只在这一帧上等待，其他页的命中不受影响
+      if (frame_states_[frame_id] != FrameState::RESIDENT) {
+        frame_cvs_[frame_id].wait(lck, [&] {
+          return frame_states_[frame_id] == FrameState::RESIDENT ||
+                 frame_states_[frame_id] == FrameState::RETIRED ||
+                 LoadPageId(fetch_page) != page_id;
+        });
+        continue;
+      }
+      int pins = PinFrame(fetch_page);
+      assert(pins >= 0);
+      if (pins == 0) {
+        replacer_->Erase(fetch_page);
+      }
+      PublishHitTable(page_id, fetch_page);
+      if (hit != nullptr) {
+        *hit = true;
+      }
+      return fetch_page;
+    }
     //如果在储存所有页面的可扩展哈希表当中没有找到该页表，那么将该页表从外存当中调入内存。
     //首先调用GetVictimPage()函数查看是否有可用空间，如果没有那么返回空指针
-    fetch_page = GetVictimPage();
-    if (fetch_page == nullptr||fetch_page->page_id_ == INVALID_PAGE_ID) 
+    //扫描等批量访问只在自己的环中换页，不挤占整个缓冲池
+    fetch_page =
+        strategy != nullptr ? GetStrategyVictim(strategy) : GetVictimPage();
+    if (fetch_page == nullptr)
       return nullptr;
-    //如果有可用页面那么查看lru队列中调回的页面是否是脏页面，如果是那么就写回磁盘
-    if (fetch_page->is_dirty_) {
-      disk_manager_->WritePage(fetch_page->GetPageId(),fetch_page->data_);
-    }
-    //将调回磁盘的页表从哈希表中删除并且调入新的页表
-    page_table_->Remove(fetch_page->GetPageId());
-    page_table_->Insert(page_id,fetch_page);
-    //放入该页表并且把pin值置为1（因为有进程使用）
-    disk_manager_->ReadPage(page_id,fetch_page->data_);
-    fetch_page->pin_count_ = 1;
+    size_t frame_id = FrameIndex(fetch_page);
+    //如果换出的是脏页，那么在不持有锁的情况下写回磁盘
+    bool released = EvictPage(fetch_page, lck);
+    //写回期间可能已有其他线程调入了该页，此时归还这一帧并重新查找
+    Page *loaded_page = nullptr;
+    if (released && page_table_->Find(page_id, loaded_page)) {
+      frame_states_[frame_id] = FrameState::FREE;
+      free_list_->push_back(fetch_page);
+      frame_cvs_[frame_id].notify_all();
+      continue;
+    }
+    //将新的页表插入哈希表，调入完成前该帧不能被命中路径pin住
+    page_table_->Insert(page_id, fetch_page);
     fetch_page->is_dirty_ = false;
-    fetch_page->page_id_= page_id;
+    SetPageId(fetch_page, page_id);
+    ring_frames_[frame_id].store(strategy != nullptr, memory_order_relaxed);
+    if (strategy != nullptr) {
+      strategy->FillSlot(this, fetch_page, page_id);
+    }
+    frame_states_[frame_id] = FrameState::LOADING;
+    frame_cvs_[frame_id].notify_all();
+    //释放锁后从磁盘读入该页，读入期间其他线程对该页的访问在这一帧上等待
+    VictimCache *victim_cache = victim_cache_;
+    lck.unlock();
+    //先到本地SSD上的二级缓存中查找，命中时不用读数据库文件
+    if (victim_cache != nullptr &&
+        victim_cache->Get(page_id, fetch_page->data_)) {
+      lck.lock();
+      FinishLoad(fetch_page, pin);
+      return fetch_page;
+    }
+    uint64_t read_start = Metrics::Now();
+    if (!pin || read != nullptr) {
+      //预取和批量读取不等待读入完成，由I/O线程完成调入，调用者可以继续处理下一页
+      future<void> done =
+          disk_scheduler_->ScheduleRead(page_id, fetch_page->data_, [=] {
+            stats_.Add(STAT_DISK_READS);
+            stats_.RecordSince(STAT_DISK_READ_NS, read_start);
+            unique_lock<mutex> load_lck = LockLatch();
+            FinishLoad(fetch_page, pin);
+          });
+      if (read != nullptr) {
+        *read = std::move(done);
+      }
+      lck.lock();
+      return fetch_page;
+    }
+    //同步的缺页在本线程上直接读入，不必交给I/O线程再等待
+    disk_scheduler_->ReadPage(page_id, fetch_page->data_);
+    stats_.Add(STAT_DISK_READS);
+    stats_.RecordSince(STAT_DISK_READ_NS, read_start);
+    lck.lock();
+    FinishLoad(fetch_page, true);
     return fetch_page;
   }
-  
+}
+
+//读入完成，把pin值置为1（因为有进程使用），预取的页调入后没有人使用，pin值为0并交给replacer
+void BufferPoolManager::FinishLoad(Page *page, bool pin) {
+  size_t frame_id = FrameIndex(page);
+  frame_states_[frame_id] = FrameState::RESIDENT;
+  //预取的页还没有被使用，不算一次访问
+  if (!pin) {
+    replacer_->InsertCold(page);
+  }
+  StorePinCount(page, pin ? 1 : 0);
+  PublishHitTable(LoadPageId(page), page);
+  frame_cvs_[frame_id].notify_all();
+}
+
+/*
+ * Queue the page to be loaded by the prefetchers of this pool, the threads are
+ * started by the first call. The page is not pinned, a later FetchPage either
+ * hits or waits on the frame while it is still loading.
+ * @return: false if the page id is invalid or too many prefetches are queued
+ */
+bool BufferPoolManager::PrefetchPage(page_id_t page_id,
+                                     AccessStrategy *strategy) {
+  if (page_id == INVALID_PAGE_ID) {
+    return false;
+  }
+  unique_lock<mutex> lck = LockLatch();
+  Page *page = nullptr;
+  if (page_table_->Find(page_id, page)) {
+    return true;
+  }
+  if (prefetch_queue_.size() >= pool_size_) {
+    return false;
+  }
+  if (prefetchers_.empty()) {
+    for (size_t i = 0; i < PREFETCH_THREAD_NUM; ++i) {
+      prefetchers_.emplace_back(&BufferPoolManager::Prefetcher, this);
+    }
+  }
+  //先建好环，策略析构时才知道要到这个缓冲池中清理预取请求
+  if (strategy != nullptr) {
+    strategy->GetRing(this);
+  }
+  prefetch_queue_.push_back(PrefetchRequest{page_id, strategy});
+  prefetch_cv_.notify_one();
+  return true;
+}
+
+//预取线程，从队列中取出页号调入内存
+void BufferPoolManager::Prefetcher() {
+  unique_lock<mutex> lck(latch_);
+  for (;;) {
+    prefetch_cv_.wait(lck, [&] {
+      return prefetch_stop_ || !prefetch_queue_.empty();
+    });
+    if (prefetch_stop_) {
+      return;
+    }
+    PrefetchRequest request = prefetch_queue_.front();
+    prefetch_queue_.pop_front();
+    AccessStrategy *strategy = request.strategy_;
+    if (strategy != nullptr) {
+      prefetch_strategies_.push_back(strategy);
+    }
+    //调入期间会释放锁，策略在此期间不能被析构
+    FetchPageImpl(request.page_id_, lck, false, nullptr, strategy);
+    if (strategy != nullptr) {
+      prefetch_strategies_.erase(find(prefetch_strategies_.begin(),
+                                      prefetch_strategies_.end(), strategy));
+      prefetch_done_cv_.notify_all();
+    }
+  }
+}
+
+void BufferPoolManager::ForgetStrategy(AccessStrategy *strategy) {
+  unique_lock<mutex> lck = LockLatch();
+  prefetch_queue_.erase(
+      remove_if(prefetch_queue_.begin(), prefetch_queue_.end(),
+                [&](const PrefetchRequest &request) {
+                  return request.strategy_ == strategy;
+                }),
+      prefetch_queue_.end());
+  prefetch_done_cv_.wait(lck, [&] {
+    return find(prefetch_strategies_.begin(), prefetch_strategies_.end(),
+                strategy) == prefetch_strategies_.end();
+  });
+}
+
+//只有该页已经在内存中时才pin住并返回，不会等待磁盘读写
+Page *BufferPoolManager::TryFetchPage(page_id_t page_id) {
+  Page *page = TryPinPage(page_id);
+  if (page != nullptr) {
+    replacer_->RecordAccess(page);
+  }
+  return page;
+}
+
+//pin住已在内存中的页，不算一次访问
+Page *BufferPoolManager::TryPinPage(page_id_t page_id) {
+  Page *page = TryPinResident(page_id);
+  if (page != nullptr) {
+    return page;
+  }
+  unique_lock<mutex> lck = LockLatch();
+  if (!page_table_->Find(page_id, page) ||
+      frame_states_[FrameIndex(page)] != FrameState::RESIDENT) {
+    return nullptr;
+  }
+  if (PinFrame(page) == 0) {
+    replacer_->Erase(page);
+  }
+  return page;
+}
+
+//pin住时帧不会被换出，放掉时不算对该页的一次访问
+bool BufferPoolManager::PeekPage(page_id_t page_id, char *data) {
+  Page *page = TryPinPage(page_id);
+  if (page == nullptr) {
+    return false;
+  }
+  page->RLatch();
+  memcpy(data, page->GetData(), PAGE_SIZE);
+  page->RUnlatch();
+  ReleasePin(page, false);
+  return true;
+}
+
+/*
+ * Copy of the page that does not bring it into the pool: from its frame when
+ * the pool holds it, else straight from disk. Used by the free space map to
+ * read the header page before the first NewPage, which may be the one
+ * allocating the header page
+ */
+void BufferPoolManager::ReadPageUncached(page_id_t page_id, char *data) {
+  unique_lock<mutex> lck = LockLatch();
+  Page *page = nullptr;
+  if (!page_table_->Find(page_id, page)) {
+    //不在缓冲池中时磁盘上的就是最新内容，持有锁读入，期间没有人能调入并修改它
+    disk_scheduler_->ReadPage(page_id, data);
+    return;
+  }
+  //正在调入或写回时等它完成
+  page = FetchPageImpl(page_id, lck, true);
+  lck.unlock();
+  if (page == nullptr) {
+    memset(data, 0, PAGE_SIZE);
+    return;
+  }
+  page->RLatch();
+  memcpy(data, page->GetData(), PAGE_SIZE);
+  page->RUnlatch();
+  ReleasePin(page, false);
 }
 
 //Page *BufferPoolManager::find
@@ -149,22 +773,124 @@ Page *BufferPoolManager::FetchPage(page_id_t page_id) {
 
 //解除对该页表的控制
 bool BufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty) {
-  lock_guard<mutex> lck(latch_);
-  Page *unpin_page = nullptr;
-  page_table_->Find(page_id,unpin_page);
-  if (unpin_page == nullptr|| unpin_page->page_id_ == INVALID_PAGE_ID||unpin_page->GetPinCount() <= 0) {
-    if(unpin_page->GetPinCount() <= 0)
-      unpin_page->is_dirty_ = is_dirty;
+  //调用者持有pin时该帧中的页号不会改变，可以不加锁在命中表中找到该帧
+  HitReaders &readers = EnterHitPath();
+  Page *unpin_page = LookupHitTable(page_id);
+  if (unpin_page != nullptr &&
+      LoadPageId(unpin_page) != page_id) {
+    unpin_page = nullptr;
+  }
+  readers.count.fetch_sub(1, memory_order_release);
+  if (unpin_page == nullptr) {
+    unique_lock<mutex> lck = LockLatch();
+    unpin_page = nullptr;
+    page_table_->Find(page_id,unpin_page);
+    if (unpin_page == nullptr|| LoadPageId(unpin_page) == INVALID_PAGE_ID) {
+      return false;
+    }
+  }
+  if (LoadPinCount(unpin_page) <= 0) {
     return false;
-  }else{
-    //如果页表pin值为0，那么将其加入lru链表当中
-    unpin_page->pin_count_--;
-    if (unpin_page->pin_count_ == 0) {
-      replacer_->Insert(unpin_page);
+  }
+  //只要有一个使用者修改过该页，该页就是脏页
+  if (is_dirty) {
+    __atomic_store_n(&unpin_page->is_dirty_, true, __ATOMIC_RELAXED);
+  }
+  //如果页表pin值减为0，那么将其加入lru链表当中
+  return ReleasePin(unpin_page);
+}
+
+/*
+ * Pin the pages found in the hit table without the latch, then take the latch
+ * once for all the others. The misses are scheduled back to back and read
+ * concurrently by the disk scheduler, whose threads also finish the loads, so
+ * a batch never holds a LOADING frame another fetch would wait on
+ */
+vector<Page *> BufferPoolManager::FetchPages(const vector<page_id_t> &page_ids) {
+  vector<Page *> pages;
+  vector<future<void>> reads;
+  FetchPagesAsync(page_ids, pages, reads);
+  for (auto &read : reads) {
+    if (read.valid()) {
+      read.wait();
+    }
+  }
+  return pages;
+}
+
+//reads[i]有效时，pages[i]要等它完成后才能使用
+void BufferPoolManager::FetchPagesAsync(const vector<page_id_t> &page_ids,
+                                        vector<Page *> &pages,
+                                        vector<future<void>> &reads) {
+  pages.assign(page_ids.size(), nullptr);
+  reads.clear();
+  reads.resize(page_ids.size());
+  vector<size_t> misses;
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    pages[i] = TryPinResident(page_ids[i]);
+    if (pages[i] != nullptr) {
+      LeaveRing(pages[i]);
+      replacer_->RecordAccess(pages[i]);
+      stats_.Add(STAT_HITS);
+    } else if (page_ids[i] != INVALID_PAGE_ID) {
+      misses.push_back(i);
+    }
+  }
+  if (misses.empty()) {
+    return;
+  }
+  //未命中的页只加一次锁，同一批中重复的页在该帧上等待前一次调入完成
+  unique_lock<mutex> lck = LockLatch();
+  for (size_t i : misses) {
+    bool hit = false;
+    pages[i] = FetchPageImpl(page_ids[i], lck, true, &hit, nullptr, &reads[i]);
+    if (pages[i] != nullptr) {
+      if (hit) {
+        LeaveRing(pages[i]);
+      }
+      replacer_->RecordAccess(pages[i]);
+      stats_.Add(hit ? STAT_HITS : STAT_MISSES);
     }
-    return true;
   }
-  
+}
+
+//批量unpin，在命中表中找不到的页只加一次锁查找
+bool BufferPoolManager::UnpinPages(const vector<page_id_t> &page_ids,
+                                   bool is_dirty) {
+  vector<Page *> pages(page_ids.size(), nullptr);
+  bool missing = false;
+  HitReaders &readers = EnterHitPath();
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    pages[i] = LookupHitTable(page_ids[i]);
+    if (pages[i] != nullptr &&
+        LoadPageId(pages[i]) != page_ids[i]) {
+      pages[i] = nullptr;
+    }
+    missing = missing || pages[i] == nullptr;
+  }
+  readers.count.fetch_sub(1, memory_order_release);
+  if (missing) {
+    unique_lock<mutex> lck = LockLatch();
+    for (size_t i = 0; i < page_ids.size(); ++i) {
+      if (pages[i] == nullptr && page_table_->Find(page_ids[i], pages[i]) &&
+          LoadPageId(pages[i]) == INVALID_PAGE_ID) {
+        pages[i] = nullptr;
+      }
+    }
+  }
+  bool unpinned = true;
+  for (Page *page : pages) {
+    if (page == nullptr ||
+        LoadPinCount(page) <= 0) {
+      unpinned = false;
+      continue;
+    }
+    if (is_dirty) {
+      __atomic_store_n(&page->is_dirty_, true, __ATOMIC_RELAXED);
+    }
+    unpinned = ReleasePin(page) && unpinned;
+  }
+  return unpinned;
 }
 
 /*
@@ -193,18 +919,136 @@ bool BufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty) {
 
 //刷新页表
 bool BufferPoolManager::FlushPage(page_id_t page_id) {
-  lock_guard<mutex> lck(latch_);
-  Page *flush_page = nullptr;
-  page_table_->Find(page_id,flush_page);
-  //如果页表是脏页那么写回磁盘，并且将isdirty置为false
-  if (flush_page == nullptr || flush_page->page_id_ == INVALID_PAGE_ID) {
-    return false;
+  std::vector<Page *> dirty_pages;
+  {
+    unique_lock<mutex> lck = LockLatch();
+    Page *flush_page = nullptr;
+    page_table_->Find(page_id,flush_page);
+    //如果页表是脏页那么写回磁盘，并且将isdirty置为false
+    if (flush_page == nullptr || LoadPageId(flush_page) == INVALID_PAGE_ID) {
+      return false;
+    }
+    //正在调入的页不会是脏页，正在换出的页由换出负责写回
+    size_t frame_id = FrameIndex(flush_page);
+    if (frame_states_[frame_id] != FrameState::RESIDENT) {
+      return true;
+    }
+    //先清除脏标记，写回期间再被修改的页会重新变脏
+    if (!__atomic_exchange_n(&flush_page->is_dirty_, false, __ATOMIC_ACQ_REL)) {
+      return true;
+    }
+    //和FlushPages一样pin住后放开锁再等待写回：I/O线程完成预取时要拿这把锁，
+    //持锁等待会让排在写请求前面的读回调把I/O线程全部占住
+    int pins = PinFrame(flush_page);
+    if (pins < 0) {
+      //该帧已被选为换出对象，由换出写回
+      __atomic_store_n(&flush_page->is_dirty_, true, __ATOMIC_RELEASE);
+      return true;
+    }
+    if (pins == 0) {
+      replacer_->Erase(flush_page);
+    }
+    dirty_pages.push_back(flush_page);
+  }
+  WriteSortedPages(dirty_pages);
+  UnpinFlushedPages(dirty_pages);
+  return true;
+}
+
+//按页号顺序写回所有脏页
+void BufferPoolManager::FlushAllPages() {
+  FlushPages(0, numeric_limits<page_id_t>::max());
+  if (page_store_ != nullptr) {
+    page_store_->Sync();
+  }
+}
+
+/*
+ * Write back the dirty pages whose id is in [first_page_id, last_page_id].
+ * The dirty set is snapshotted under the latch: those pages are pinned so they
+ * cannot be evicted, and their dirty flag is cleared so a change made during
+ * the write dirties them again. The writes are done in page id order without
+ * holding the latch, which turns a checkpoint into one sequential pass over
+ * the file instead of random writes in page table order.
+ */
+void BufferPoolManager::FlushPages(page_id_t first_page_id,
+                                   page_id_t last_page_id) {
+  std::vector<Page *> dirty_pages;
+  PinDirtyPages(first_page_id, last_page_id, dirty_pages);
+  WriteSortedPages(dirty_pages);
+  UnpinFlushedPages(dirty_pages);
+}
+
+//pin住区间内所有的脏页并清除脏标记
+void BufferPoolManager::PinDirtyPages(page_id_t first_page_id,
+                                      page_id_t last_page_id,
+                                      std::vector<Page *> &dirty_pages) {
+  unique_lock<mutex> lck = LockLatch();
+  for (size_t i = 0; i < pool_size_; ++i) {
+    Page *page = GetFrame(i);
+    if (frame_states_[i] != FrameState::RESIDENT ||
+        !__atomic_load_n(&page->is_dirty_, __ATOMIC_ACQUIRE) ||
+        LoadPageId(page) < first_page_id || LoadPageId(page) > last_page_id) {
+      continue;
+    }
+    //不从replacer中删除，写回后帧仍在原来的位置；写回期间被取作牺牲帧
+    //的帧因为pin住而换不出，放掉pin时重新插入
+    PinFrame(page);
+    __atomic_store_n(&page->is_dirty_, false, __ATOMIC_RELEASE);
+    dirty_pages.push_back(page);
+  }
+}
+
+/*
+ * Write the pages back in page id order, FLUSH_BATCH_SIZE pages in flight at
+ * a time. Each page is copied under its read latch and the copy is written,
+ * so the flush never holds the latches of several pages at once. Pages with
+ * contiguous ids go to the disk scheduler as one run
+ */
+void BufferPoolManager::WriteSortedPages(std::vector<Page *> &pages) {
+  sort(pages.begin(), pages.end(), [](Page *a, Page *b) {
+    return LoadPageId(a) < LoadPageId(b);
+  });
+  //副本按页对齐，以O_DIRECT打开的数据库文件也能一次写出一段
+  FrameArena buffer(min(pages.size(), static_cast<size_t>(FLUSH_BATCH_SIZE)) *
+                    PAGE_SIZE);
+  char *copies = static_cast<char *>(buffer.GetData());
+  std::vector<std::future<void>> writes;
+  for (size_t begin = 0; begin < pages.size(); begin += FLUSH_BATCH_SIZE) {
+    size_t end = min(pages.size(), begin + FLUSH_BATCH_SIZE);
+    uint64_t write_start = Metrics::Now();
+    writes.clear();
+    std::vector<const char *> run;
+    for (size_t i = begin; i < end; ++i) {
+      char *data = copies + (i - begin) * PAGE_SIZE;
+      pages[i]->RLatch();
+      memcpy(data, pages[i]->GetData(), PAGE_SIZE);
+      pages[i]->RUnlatch();
+      run.push_back(data);
+      //页号不再连续时把前面这一段交给调度器
+      if (i + 1 == end ||
+          LoadPageId(pages[i + 1]) != LoadPageId(pages[i]) + 1) {
+        page_id_t first_page_id =
+            LoadPageId(pages[i]) - static_cast<page_id_t>(run.size() - 1);
+        writes.push_back(
+            disk_scheduler_->ScheduleWriteRun(first_page_id, std::move(run)));
+        run.clear();
+      }
+    }
+    for (auto &write : writes) {
+      write.wait();
+      stats_.RecordSince(STAT_DISK_WRITE_NS, write_start);
+    }
+    stats_.Add(STAT_DISK_WRITES, end - begin);
+  }
+}
+
+//写回完成后解除pin
+void BufferPoolManager::UnpinFlushedPages(const std::vector<Page *> &pages) {
+  //写回不是对页的访问
+  for (auto *page : pages) {
+    ReleasePin(page, false);
   }
-  if (flush_page->is_dirty_) {
-    disk_manager_->WritePage(page_id,flush_page->GetData());
-    flush_page->is_dirty_ = false;
-    return true;
-  }else return true;
 }
 
 /**
@@ -239,24 +1083,37 @@ bool BufferPoolManager::FlushPage(page_id_t page_id) {
 
 //删除一张页表
 bool BufferPoolManager::DeletePage(page_id_t page_id) {
-  lock_guard<mutex> lck(latch_);
+  if (free_space_map_->IsMapPage(page_id)) {
+    return false;
+  }
+  unique_lock<mutex> lck = LockLatch();
   Page *delete_page = nullptr;
   page_table_->Find(page_id,delete_page);
-  if(delete_page->page_id_ == INVALID_PAGE_ID)
-    return false;
   if (delete_page != nullptr) {
-    //如果该页表被pin住了，那么返回false
-    if (delete_page->GetPinCount() > 0) {
+    //如果该页表被pin住了，或者正在被调入、写回，那么返回false
+    size_t frame_id = FrameIndex(delete_page);
+    if (frame_states_[frame_id] != FrameState::RESIDENT ||
+        !ClaimFrame(delete_page)) {
       return false;
     }
     //删除该页表，将其从lru链表和可扩展哈希表当中删除。并且重置了该指针的内存空间。
-    replacer_->Erase(delete_page);
     page_table_->Remove(page_id);
+    RemoveHitTable(page_id);
+    SetPageId(delete_page, INVALID_PAGE_ID);
     delete_page->is_dirty_= false;
     delete_page->ResetMemory();
+    frame_states_[frame_id] = FrameState::FREE;
     free_list_->push_back(delete_page);
   }
+  //二级缓存中的旧内容不能再被读到
+  VictimCache *victim_cache = victim_cache_;
+  lck.unlock();
+  if (victim_cache != nullptr) {
+    victim_cache->Erase(page_id);
+  }
   disk_manager_->DeallocatePage(page_id);
+  //空闲页映射通过本缓冲池读写映射页，不能持有latch_
+  free_space_map_->Free(page_id);
   return true;
 }
 
@@ -298,29 +1155,118 @@ bool BufferPoolManager::DeletePage(page_id_t page_id) {
 // }
 
 //新建一张页表
-Page *BufferPoolManager::NewPage(page_id_t &page_id) {
-  lock_guard<mutex> lck(latch_);
+Page *BufferPoolManager::NewPage(page_id_t &page_id, page_id_t hint_page_id,
+                                 AccessStrategy *strategy) {
+  //优先复用被删除的页，空闲页映射要在持有latch_之前访问；没有空闲页时
+  //Allocate不加锁直接返回
+  page_id_t reused_page_id = INVALID_PAGE_ID;
+  bool reused = free_space_map_->Allocate(hint_page_id, reused_page_id);
+  unique_lock<mutex> lck = LockLatch();
   Page *new_page = nullptr;
-  new_page = GetVictimPage();
-  if (new_page == nullptr) 
+  new_page = strategy != nullptr ? GetStrategyVictim(strategy) : GetVictimPage();
+  if (new_page == nullptr) {
+    if (reused) {
+      lck.unlock();
+      free_space_map_->Free(reused_page_id);
+    }
     return nullptr;
-  //写入磁盘空间
-  page_id = disk_manager_->AllocatePage();
-  //如果需要从lru当中调回的是脏页那么将其写回磁盘
-  if (new_page->is_dirty_) {
-    disk_manager_->WritePage(new_page->GetPageId(),new_page->data_);
-  }
-  //从内存当中删除该磁盘并且将新页表插入
-  page_table_->Remove(new_page->GetPageId());
+  }
+  //如果需要从lru当中调回的是脏页那么在不持有锁的情况下将其写回磁盘
+  EvictPage(new_page, lck);
+  //写入磁盘空间，并将新页表插入
+  page_id = reused ? reused_page_id : AllocatePage();
   page_table_->Insert(page_id,new_page);
-  new_page->page_id_ = page_id;
+  SetPageId(new_page, page_id);
+  size_t frame_id = FrameIndex(new_page);
+  ring_frames_[frame_id].store(strategy != nullptr, memory_order_relaxed);
+  if (strategy != nullptr) {
+    strategy->FillSlot(this, new_page, page_id);
+  }
   new_page->ResetMemory();
-  new_page->is_dirty_ = false;
-  new_page->pin_count_ = 1;
+  //复用的页在磁盘上还是旧内容，标记为脏页以便写回清零后的内容
+  new_page->is_dirty_ = reused;
+  frame_states_[frame_id] = FrameState::RESIDENT;
+  StorePinCount(new_page, 1);
+  PublishHitTable(page_id, new_page);
+  frame_cvs_[frame_id].notify_all();
 
   return new_page;
 }
 
+/*
+ * Write the victim page back to disk if it is dirty, or to the victim cache if
+ * it is clean and the cache is enabled, then remove its entry from the page
+ * table. The latch is released during the write: the frame is marked EVICTING
+ * and keeps its old page table entry, so a concurrent FetchPage of the old
+ * page waits on this frame until the write is done instead of reading a stale
+ * copy from disk (or missing the copy in the cache).
+ * @return: true if the latch was released
+ */
+bool BufferPoolManager::EvictPage(Page *victim, unique_lock<mutex> &lck) {
+  size_t frame_id = FrameIndex(victim);
+  bool released = false;
+  if (!victim->is_dirty_ && victim_cache_ != nullptr &&
+      LoadPageId(victim) != INVALID_PAGE_ID) {
+    frame_states_[frame_id] = FrameState::EVICTING;
+    VictimCache *victim_cache = victim_cache_;
+    lck.unlock();
+    victim_cache->Put(LoadPageId(victim), victim->data_);
+    lck.lock();
+    released = true;
+  } else if (victim->is_dirty_) {
+    frame_states_[frame_id] = FrameState::EVICTING;
+    lck.unlock();
+    uint64_t write_start = Metrics::Now();
+    disk_scheduler_->WritePage(LoadPageId(victim), victim->data_);
+    stats_.Add(STAT_DIRTY_WRITEBACKS);
+    stats_.Add(STAT_DISK_WRITES);
+    stats_.RecordSince(STAT_DISK_WRITE_NS, write_start);
+    lck.lock();
+    victim->is_dirty_ = false;
+    released = true;
+  }
+  if (LoadPageId(victim) != INVALID_PAGE_ID) {
+    stats_.Add(STAT_EVICTIONS);
+    page_table_->Remove(LoadPageId(victim));
+    RemoveHitTable(LoadPageId(victim));
+    SetPageId(victim, INVALID_PAGE_ID);
+  }
+  return released;
+}
+
+//新建一张页表并交给guard管理
+BasicPageGuard BufferPoolManager::NewPageGuarded(page_id_t &page_id,
+                                                 page_id_t hint_page_id,
+                                                 AccessStrategy *strategy) {
+  Page *page = NewPage(page_id, hint_page_id, strategy);
+  if (page == nullptr) {
+    return BasicPageGuard();
+  }
+  return BasicPageGuard(this, page);
+}
+
+//读取一张页表，加读锁后交给guard管理
+ReadPageGuard BufferPoolManager::FetchPageRead(page_id_t page_id,
+                                               AccessStrategy *strategy) {
+  Page *page = FetchPage(page_id, strategy);
+  if (page == nullptr) {
+    return ReadPageGuard();
+  }
+  page->RLatch();
+  return ReadPageGuard(this, page);
+}
+
+//读取一张页表，加写锁后交给guard管理
+WritePageGuard BufferPoolManager::FetchPageWrite(page_id_t page_id,
+                                                 AccessStrategy *strategy) {
+  Page *page = FetchPage(page_id, strategy);
+  if (page == nullptr) {
+    return WritePageGuard();
+  }
+  page->WLatch();
+  return WritePageGuard(this, page);
+}
+
 //查看有没有空闲位置给到页表，查看freelist和lru链表空闲
 // Page *BufferPoolManager::GetVictimPage() {
 //   Page *tar = nullptr;
@@ -346,14 +1292,25 @@ Page *BufferPoolManager::NewPage(page_id_t &page_id) {
 Page *BufferPoolManager::GetVictimPage() {
   Page *victim = nullptr;
 
+  //缩容时退役的帧可能还留在空闲链表中，跳过它们
+  while (!free_list_->empty() &&
+         FrameIndex(free_list_->front()) >= pool_size_) {
+    free_list_->pop_front();
+  }
   //先查看空闲链表freelist,如果没有空闲位置了那么去调用lru队列删除一个页表
   if (free_list_->empty()) {
-    //如果lru队列的大小也是0，也即所有使用的页表都是被一些进程pin的，都不可调回磁盘当中，那么返回空指针
-    if (replacer_->Size() == 0) {
-      return victim;
+    //如果lru队列当中没有能换出的页表，也即所有使用的页表都是被一些进程pin的，都不可调回磁盘当中，那么返回空指针
+    //否则删除lru队列当中最后一张没有被pin住的页表
+    if (!PopVictim(victim)) {
+      return nullptr;
+    }
+    //后台清理线程没有跟上，前台仍然要写回脏页，唤醒清理线程
+    if (victim->is_dirty_) {
+      dirty_victims_++;
+      if (cleaner_running_) {
+        cleaner_cv_.notify_one();
+      }
     }
-    //如果lru队列当中有可调用的页表，那么删除lru队列当中最后一张页表
-    replacer_->Victim(victim);
     return victim;
   } else {
     //空闲链表freelist有位置，那么直接减少freelist的一个空闲位置，插入一张页表，返回该指针
@@ -363,4 +1320,543 @@ Page *BufferPoolManager::GetVictimPage() {
   }
 }
 
+bool BufferPoolManager::LoadFreeSpaceMap() {
+  return free_space_map_ != nullptr && free_space_map_->Load();
+}
+
+/*
+ * Reuse the frame of the next slot of the ring if it still holds the page the
+ * ring loaded and nobody has it pinned: the scan is done with that page, so
+ * it is evicted without asking the replacer. Otherwise (slot still empty,
+ * page already evicted, or pinned) take a victim from the whole pool, the
+ * ring records it once the new page is in. Called with the latch held
+ */
+Page *BufferPoolManager::GetStrategyVictim(AccessStrategy *strategy) {
+  AccessStrategy::RingSlot &slot = strategy->CurrentSlot(this);
+  Page *victim = slot.frame_;
+  if (victim != nullptr && FrameIndex(victim) < pool_size_ &&
+      frame_states_[FrameIndex(victim)] == FrameState::RESIDENT &&
+      LoadPageId(victim) == slot.page_id_ && ClaimFrame(victim)) {
+    strategy->reuses_++;
+    if (victim->is_dirty_) {
+      dirty_victims_++;
+    }
+    return victim;
+  }
+  return GetVictimPage();
+}
+
+void BufferPoolManager::SetManifestFile(const string &file_name) {
+  manifest_file_ = file_name;
+}
+
+/*
+ * Ids of the resident pages, hottest first: the pinned pages, then the
+ * victims of the replacer from the most to the least recently used. Only
+ * used at shutdown, draining the replacer is how its order is read
+ */
+void BufferPoolManager::GetResidentPages(vector<page_id_t> &page_ids) {
+  lock_guard<mutex> lck(latch_);
+  for (size_t i = 0; i < pool_size_; ++i) {
+    if (frame_states_[i] == FrameState::RESIDENT &&
+        LoadPinCount(GetFrame(i)) > 0) {
+      page_ids.push_back(LoadPageId(GetFrame(i)));
+    }
+  }
+  vector<page_id_t> unpinned;
+  Page *victim = nullptr;
+  while (replacer_->Victim(victim)) {
+    if (frame_states_[FrameIndex(victim)] == FrameState::RESIDENT) {
+      unpinned.push_back(LoadPageId(victim));
+    }
+  }
+  page_ids.insert(page_ids.end(), unpinned.rbegin(), unpinned.rend());
+}
+
+size_t BufferPoolManager::LoadManifest(const string &file_name, bool wait) {
+  vector<page_id_t> page_ids;
+  if (!ReadManifest(file_name, page_ids, GetPoolSize())) {
+    return 0;
+  }
+  vector<future<void>> reads;
+  vector<page_id_t> loaded;
+  LoadPages(page_ids, reads, loaded);
+  if (wait) {
+    for (auto &read : reads) {
+      read.wait();
+    }
+    OrderLoadedPages(loaded);
+  }
+  return reads.size();
+}
+
+/*
+ * Load the hottest pages of page_ids that fit in the pool, like a prefetch
+ * but in page id order, so the reads sweep the file once. The latch is taken
+ * per page, a page already in the pool is left alone. The pages read are
+ * added to loaded, hottest first
+ */
+void BufferPoolManager::LoadPages(vector<page_id_t> page_ids,
+                                  vector<future<void>> &reads,
+                                  vector<page_id_t> &loaded) {
+  {
+    unique_lock<mutex> lck = LockLatch();
+    if (page_ids.size() > pool_size_) {
+      page_ids.resize(pool_size_);
+    }
+  }
+  vector<page_id_t> hottest_first = page_ids;
+  sort(page_ids.begin(), page_ids.end());
+  vector<page_id_t> read_ids; // in page id order
+  for (page_id_t page_id : page_ids) {
+    if (page_id == INVALID_PAGE_ID) {
+      continue;
+    }
+    future<void> read;
+    unique_lock<mutex> lck = LockLatch();
+    //所有帧都被pin住，剩下的页也调不进来
+    if (FetchPageImpl(page_id, lck, false, nullptr, nullptr, &read) ==
+        nullptr) {
+      break;
+    }
+    if (read.valid()) {
+      reads.push_back(std::move(read));
+      read_ids.push_back(page_id);
+    }
+  }
+  //没有读入的页（已在缓冲池中）不调整顺序
+  for (page_id_t page_id : hottest_first) {
+    if (binary_search(read_ids.begin(), read_ids.end(), page_id)) {
+      loaded.push_back(page_id);
+    }
+  }
+}
+
+/*
+ * The reads of LoadPages complete in any order and each page entered the
+ * replacer cold when its read was done. Hand the pages to the replacer again
+ * from the coldest to the hottest, as if each had been used once in that
+ * order. A page pinned or evicted since then is skipped, the same protocol
+ * as the last unpin keeps the hit path from pinning a frame meanwhile
+ */
+void BufferPoolManager::OrderLoadedPages(const vector<page_id_t> &loaded) {
+  unique_lock<mutex> lck = LockLatch();
+  for (auto it = loaded.rbegin(); it != loaded.rend(); ++it) {
+    Page *page = nullptr;
+    if (!page_table_->Find(*it, page) ||
+        frame_states_[FrameIndex(page)] != FrameState::RESIDENT) {
+      continue;
+    }
+    //弱CAS可能假失败，pin值仍为0时重试
+    int pins = 0;
+    bool released = false;
+    while (pins == 0 && !(released = CasPinCount(page, pins, FRAME_RELEASING))) {
+    }
+    if (released) {
+      replacer_->Insert(page);
+      StorePinCount(page, 0);
+    }
+  }
+}
+
+//先写到临时文件再改名，写到一半崩溃也不会留下损坏的清单
+bool BufferPoolManager::WriteManifest(const string &file_name,
+                                      const vector<page_id_t> &page_ids) {
+  string tmp_name = file_name + ".tmp";
+  ofstream out(tmp_name, ios::binary | ios::trunc);
+  if (!out) {
+    return false;
+  }
+  uint32_t header[2] = {MANIFEST_MAGIC, static_cast<uint32_t>(page_ids.size())};
+  out.write(reinterpret_cast<const char *>(header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(page_ids.data()),
+            page_ids.size() * sizeof(page_id_t));
+  out.close();
+  if (!out) {
+    std::remove(tmp_name.c_str());
+    return false;
+  }
+  return std::rename(tmp_name.c_str(), file_name.c_str()) == 0;
+}
+
+bool BufferPoolManager::ReadManifest(const string &file_name,
+                                     vector<page_id_t> &page_ids,
+                                     size_t max_pages) {
+  ifstream in(file_name, ios::binary | ios::ate);
+  if (!in) {
+    return false;
+  }
+  size_t file_size = static_cast<size_t>(in.tellg());
+  in.seekg(0);
+  uint32_t header[2];
+  if (!in.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+      header[0] != MANIFEST_MAGIC) {
+    return false;
+  }
+  //页数和文件大小对不上说明清单已损坏，不按它分配内存
+  if (header[1] != (file_size - sizeof(header)) / sizeof(page_id_t) ||
+      (file_size - sizeof(header)) % sizeof(page_id_t) != 0) {
+    return false;
+  }
+  page_ids.resize(min(static_cast<size_t>(header[1]), max_pages));
+  if (!in.read(reinterpret_cast<char *>(page_ids.data()),
+               page_ids.size() * sizeof(page_id_t))) {
+    page_ids.clear();
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Start the background page cleaner. Every interval, or as soon as the free
+ * list drops below free_target, the cleaner evicts the coldest unpinned pages
+ * chosen by the replacer until free_target frames are free, writing back the
+ * dirty ones without holding the latch. Foreground misses then take a clean
+ * frame from the free list and only pay for the read.
+ */
+void BufferPoolManager::StartPageCleaner(size_t max_pages_per_round,
+                                         std::chrono::milliseconds interval) {
+  StopPageCleaner();
+  lock_guard<mutex> lck(latch_);
+  cleaner_max_pages_ = max_pages_per_round;
+  cleaner_interval_ = interval;
+  cleaner_running_ = true;
+  page_cleaner_ = std::thread(&BufferPoolManager::PageCleaner, this);
+}
+
+//停止后台清理线程
+void BufferPoolManager::StopPageCleaner() {
+  {
+    lock_guard<mutex> lck(latch_);
+    cleaner_running_ = false;
+  }
+  cleaner_cv_.notify_all();
+  if (page_cleaner_.joinable()) {
+    page_cleaner_.join();
+  }
+}
+
+/*
+ * Background page cleaner: every round write back at most cleaner_max_pages_
+ * dirty pages nobody has pinned. The pages stay resident and keep their place
+ * in the replacer, a later eviction finds them clean and does not wait for a
+ * write
+ */
+void BufferPoolManager::PageCleaner() {
+  unique_lock<mutex> lck(latch_);
+  while (cleaner_running_) {
+    lck.unlock();
+    std::vector<Page *> dirty_pages;
+    PinUnpinnedDirtyPages(cleaner_max_pages_, dirty_pages);
+    WriteSortedPages(dirty_pages);
+    UnpinFlushedPages(dirty_pages);
+    pages_cleaned_ += dirty_pages.size();
+    lck.lock();
+    //等到下一轮，或者被换出脏页的前台线程唤醒
+    if (cleaner_running_) {
+      cleaner_cv_.wait_for(lck, cleaner_interval_);
+    }
+  }
+}
+
+/*
+ * Pin up to max_pages dirty resident pages whose pin count is 0, sweeping the
+ * frames from where the previous round stopped. A page pinned by a user is
+ * skipped, it may still be changed. Like PinDirtyPages the frames are not
+ * erased from the replacer and the dirty flag is cleared before the copy
+ */
+void BufferPoolManager::PinUnpinnedDirtyPages(size_t max_pages,
+                                              std::vector<Page *> &dirty_pages) {
+  unique_lock<mutex> lck = LockLatch();
+  for (size_t n = 0; n < pool_size_ && dirty_pages.size() < max_pages; ++n) {
+    //缩容后指针可能越过了最后一帧
+    cleaner_hand_ = cleaner_hand_ < pool_size_ ? cleaner_hand_ : 0;
+    Page *page = GetFrame(cleaner_hand_);
+    bool resident = frame_states_[cleaner_hand_] == FrameState::RESIDENT;
+    cleaner_hand_++;
+    if (!resident || !__atomic_load_n(&page->is_dirty_, __ATOMIC_ACQUIRE)) {
+      continue;
+    }
+    //只pin住pin值为0的帧，用户正在使用的页跳过
+    int pins = 0;
+    if (!CasPinCount(page, pins, 1)) {
+      continue;
+    }
+    __atomic_store_n(&page->is_dirty_, false, __ATOMIC_RELEASE);
+    dirty_pages.push_back(page);
+  }
+}
+
+size_t BufferPoolManager::GetPagesCleaned() { return pages_cleaned_.load(); }
+
+size_t BufferPoolManager::GetDirtyVictims() { return dirty_victims_.load(); }
+
+//返回缓冲池的大小
+size_t BufferPoolManager::GetPoolSize() {
+  unique_lock<mutex> lck = LockLatch();
+  return pool_size_;
+}
+
+/*
+ * Construct n more frames after the ones in use, without holding the latch
+ * since no other thread can reach them yet, then hand them to the free list
+ */
+size_t BufferPoolManager::Grow(size_t n) {
+  lock_guard<mutex> resize_lck(resize_latch_);
+  size_t old_size = pool_size_;
+  n = min(n, capacity_ - old_size);
+  for (size_t i = old_size; i < old_size + n; ++i) {
+    new (GetFrame(i)) Page();
+    StorePinCount(GetFrame(i), FRAME_UNPINNABLE);
+  }
+  unique_lock<mutex> lck = LockLatch();
+  for (size_t i = old_size; i < old_size + n; ++i) {
+    frame_states_[i] = FrameState::FREE;
+    free_list_->push_back(GetFrame(i));
+  }
+  pool_size_ = old_size + n;
+  SetReplacerCacheSize();
+  return n;
+}
+
+/*
+ * Release the last frames of pages_ so the frames in use stay contiguous,
+ * taking the latch for one frame at a time: a free frame is retired at once,
+ * the page of an unpinned one is moved to a free frame below it, or evicted
+ * when there is none (a dirty one is written back without the latch), a
+ * frame doing disk I/O is waited for, and a pinned one stops the shrink. Once no thread can still reach the released frames through the hit
+ * table, they are destroyed and their memory is given back to the OS
+ */
+size_t BufferPoolManager::Shrink(size_t n) {
+  lock_guard<mutex> resize_lck(resize_latch_);
+  size_t old_size = pool_size_;
+  size_t released = 0;
+  while (released < n && pool_size_ > 1) {
+    unique_lock<mutex> lck = LockLatch();
+    size_t frame_id = pool_size_ - 1;
+    Page *page = GetFrame(frame_id);
+    frame_cvs_[frame_id].wait(lck, [&] {
+      return frame_states_[frame_id] != FrameState::LOADING &&
+             frame_states_[frame_id] != FrameState::EVICTING;
+    });
+    if (frame_states_[frame_id] == FrameState::RESIDENT) {
+      if (!ClaimFrame(page)) {
+        break;
+      }
+      //有空闲帧时把页挪过去，仍留在缓冲池中；写回期间该帧处于EVICTING
+      //状态，其他线程不会使用它
+      if (!MovePage(page)) {
+        EvictPage(page, lck);
+      }
+    }
+    //空闲帧在空闲链表中的位置在最后统一删除
+    frame_states_[frame_id] = FrameState::RETIRED;
+    pool_size_--;
+    released++;
+    frame_cvs_[frame_id].notify_all();
+  }
+  if (released == 0) {
+    return 0;
+  }
+  {
+    unique_lock<mutex> lck = LockLatch();
+    free_list_->remove_if(
+        [&](Page *page) { return FrameIndex(page) >= pool_size_; });
+    SetReplacerCacheSize();
+  }
+  WaitForHitReaders();
+  for (size_t i = pool_size_; i < old_size; ++i) {
+    GetFrame(i)->~Page();
+  }
+  arena_->Release(GetFrame(pool_size_), GetFrame(old_size));
+  return released;
+}
+
+/*
+ * Move the page of a claimed frame to the lowest free frame below it, the
+ * page stays resident under the same page id. Called with the latch held
+ * @return: false if there is no such free frame
+ */
+bool BufferPoolManager::MovePage(Page *page) {
+  size_t frame_id = FrameIndex(page);
+  auto lowest = min_element(
+      free_list_->begin(), free_list_->end(),
+      [&](Page *a, Page *b) { return FrameIndex(a) < FrameIndex(b); });
+  if (lowest == free_list_->end() || FrameIndex(*lowest) >= frame_id) {
+    return false;
+  }
+  Page *target = *lowest;
+  free_list_->erase(lowest);
+  size_t target_id = FrameIndex(target);
+  page_id_t page_id = LoadPageId(page);
+  //旧帧已被取走，不会再被pin住，复制期间没有人修改它
+  memcpy(target->data_, page->data_, PAGE_SIZE);
+  __atomic_store_n(&target->is_dirty_,
+                   __atomic_load_n(&page->is_dirty_, __ATOMIC_ACQUIRE),
+                   __ATOMIC_RELEASE);
+  SetPageId(target, page_id);
+  bool ring_frame = ring_frames_[frame_id].load(memory_order_relaxed);
+  ring_frames_[target_id].store(ring_frame, memory_order_relaxed);
+  RemoveHitTable(page_id);
+  page_table_->Insert(page_id, target);
+  frame_states_[target_id] = FrameState::RESIDENT;
+  //换了一帧，原来在replacer中的位置丢失，按一次释放重新插入
+  if (ring_frame) {
+    replacer_->InsertCold(target);
+  } else {
+    replacer_->Insert(target);
+  }
+  StorePinCount(target, 0);
+  PublishHitTable(page_id, target);
+  frame_cvs_[target_id].notify_all();
+  __atomic_store_n(&page->is_dirty_, false, __ATOMIC_RELEASE);
+  SetPageId(page, INVALID_PAGE_ID);
+  return true;
+}
+
+// ARC bounds p and its ghost lists by the frames in use
+void BufferPoolManager::SetReplacerCacheSize() {
+  auto *arc_replacer = dynamic_cast<ARCReplacer<Page *> *>(replacer_);
+  if (arc_replacer != nullptr) {
+    arc_replacer->SetCacheSize(pool_size_);
+  }
+}
+
+/*
+ * Text dump of the pool state, the counters and histograms of the pool, and
+ * the stats of the replacer and the page table when they keep any, one
+ * "name value" line each
+ */
+std::string BufferPoolManager::DumpStats() {
+  std::string prefix = "buffer_pool";
+  if (num_instances_ > 1) {
+    prefix += "." + std::to_string(instance_index_);
+  }
+  std::ostringstream out;
+  {
+    unique_lock<mutex> lck = LockLatch();
+    out << prefix << ".pool_size " << pool_size_ << "\n";
+    out << prefix << ".capacity " << capacity_ << "\n";
+    out << prefix << ".arena_bytes " << arena_->GetSize() << "\n";
+    out << prefix << ".huge_pages "
+        << static_cast<int>(arena_->GetHugePageMode()) << "\n";
+    out << prefix << ".free_frames " << free_list_->size() << "\n";
+    out << prefix << ".replacer_size " << replacer_->Size() << "\n";
+  }
+  out << prefix << ".pages_cleaned " << pages_cleaned_.load() << "\n";
+  out << prefix << ".dirty_victims " << dirty_victims_.load() << "\n";
+  out << stats_.Dump(prefix);
+  //每个实例的替换器分别输出，ARC的p也是各实例各自调整的
+  out << replacer_->DumpStats(prefix + ".replacer");
+  auto *hash_table = dynamic_cast<ExtendibleHash<page_id_t, Page *> *>(page_table_);
+  if (hash_table != nullptr) {
+    out << hash_table->DumpStats(prefix + ".page_table");
+  }
+  CompressionStats compression_stats;
+  if (GetCompressionStats(compression_stats)) {
+    out << prefix << ".compression.pages_written "
+        << compression_stats.pages_written << "\n";
+    out << prefix << ".compression.pages_read " << compression_stats.pages_read
+        << "\n";
+    out << prefix << ".compression.bytes_written "
+        << compression_stats.bytes_written << "\n";
+    out << prefix << ".compression.bytes_read " << compression_stats.bytes_read
+        << "\n";
+    out << prefix << ".compression.file_bytes " << compression_stats.file_bytes
+        << "\n";
+    out << prefix << ".compression.compress_ns "
+        << compression_stats.compress_ns << "\n";
+    out << prefix << ".compression.decompress_ns "
+        << compression_stats.decompress_ns << "\n";
+  }
+  VictimCacheStats cache_stats;
+  if (GetVictimCacheStats(cache_stats)) {
+    out << prefix << ".victim_cache.capacity " << cache_stats.capacity << "\n";
+    out << prefix << ".victim_cache.size " << cache_stats.size << "\n";
+    out << prefix << ".victim_cache.hits " << cache_stats.hits << "\n";
+    out << prefix << ".victim_cache.misses " << cache_stats.misses << "\n";
+    out << prefix << ".victim_cache.spills " << cache_stats.spills << "\n";
+  }
+  return out.str();
+}
+
+//只能启用一次，之后的调用不起作用
+void BufferPoolManager::EnableCompression(const string &file_name) {
+  if (page_store_ != nullptr) {
+    return;
+  }
+  page_store_ = new CompressedPageStore(file_name);
+  disk_scheduler_->SetPageStore(page_store_);
+}
+
+bool BufferPoolManager::OpenDatabaseFile(const string &db_file,
+                                         bool direct_io) {
+  return disk_scheduler_->OpenPageFile(db_file, direct_io);
+}
+
+bool BufferPoolManager::GetCompressionStats(CompressionStats &stats) {
+  if (page_store_ == nullptr) {
+    return false;
+  }
+  stats = page_store_->GetStats();
+  return true;
+}
+
+//只能启用一次，之后的调用不起作用
+void BufferPoolManager::EnableVictimCache(const string &file_name,
+                                          size_t capacity) {
+  unique_lock<mutex> lck = LockLatch();
+  if (victim_cache_ == nullptr) {
+    victim_cache_ = new VictimCache(file_name, capacity);
+  }
+}
+
+bool BufferPoolManager::GetVictimCacheStats(VictimCacheStats &stats) {
+  VictimCache *victim_cache;
+  {
+    unique_lock<mutex> lck = LockLatch();
+    victim_cache = victim_cache_;
+  }
+  if (victim_cache == nullptr) {
+    return false;
+  }
+  stats = victim_cache->GetStats();
+  return true;
+}
+
+/*
+ * Report the state of the ARC replacer, including its adaptation parameter p
+ * @return: false if the pool does not use the ARC policy
+ */
+bool BufferPoolManager::GetARCStats(ARCStats &stats) {
+  auto *arc_replacer = dynamic_cast<ARCReplacer<Page *> *>(replacer_);
+  if (arc_replacer == nullptr) {
+    return false;
+  }
+  stats = arc_replacer->GetStats();
+  return true;
+}
+
+//分配一个新的页号，跳过留给空闲页映射的页号
+page_id_t BufferPoolManager::AllocatePage() {
+  page_id_t page_id;
+  do {
+    //单个缓冲池时仍由磁盘管理器分配页号
+    if (num_instances_ == 1) {
+      page_id = disk_manager_->AllocatePage();
+      continue;
+    }
+    //作为并行缓冲池的一个实例时，只分配对实例数取模等于自身下标的页号
+    page_id = next_page_id_;
+    next_page_id_ += num_instances_;
+    assert(static_cast<uint32_t>(page_id) % num_instances_ == instance_index_);
+  } while (free_space_map_->IsMapPage(page_id));
+  //磁盘管理器记录已分配的最大页号，各实例交替分配时它总是领先于所有实例
+  if (num_instances_ > 1) {
+    while (disk_manager_->AllocatePage() < page_id) {
+    }
+  }
+  return page_id;
+}
+
 } // namespace cmudb
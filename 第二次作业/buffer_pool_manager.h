@@ -7,42 +7,388 @@
  */
 
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
 #include <list>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "buffer/access_strategy.h"
+#include "buffer/arc_replacer.h"
+#include "buffer/clock_replacer.h"
+#include "buffer/disk_scheduler.h"
+#include "buffer/frame_arena.h"
+#include "buffer/free_space_map.h"
+#include "buffer/lru_k_replacer.h"
 #include "buffer/lru_replacer.h"
+#include "buffer/metrics.h"
+#include "buffer/page_guard.h"
+#include "buffer/victim_cache.h"
 #include "disk/disk_manager.h"
 #include "hash/extendible_hash.h"
 #include "logging/log_manager.h"
 #include "page/page.h"
 
 namespace scudb {
-class BufferPoolManager {
+#define PREFETCH_THREAD_NUM 4 // threads loading prefetched pages of a pool
+#define HIT_TABLE_WAYS 4      // entries per bucket of the lock free hit table
+#define MAX_POOL_SIZE_FACTOR 4 // Grow stops at 4 times the initial size, see Grow
+#define FLUSH_BATCH_SIZE 64    // page writes a flush keeps in flight
+#define MANIFEST_MAGIC 0x5453464d // "MFST", first word of a manifest file
+
+// replacement policy used to pick the victim frame
+enum class ReplacerType { LRU, CLOCK, LRU_K, ARC };
+
+class BufferPoolManager : public PageReader {
 public:
   BufferPoolManager(size_t pool_size, DiskManager *disk_manager,
-                          LogManager *log_manager = nullptr);
+                          LogManager *log_manager = nullptr,
+                          ReplacerType replacer_type = ReplacerType::LRU,
+                          size_t lru_k = LRUK_REPLACER_K,
+                          HugePageMode huge_pages = HugePageMode::NONE);
 
-  ~BufferPoolManager();
+  // one instance of a ParallelBufferPoolManager, only owns the page ids
+  // where page_id % num_instances == instance_index
+  BufferPoolManager(size_t pool_size, uint32_t num_instances,
+                    uint32_t instance_index, DiskManager *disk_manager,
+                    LogManager *log_manager = nullptr,
+                    ReplacerType replacer_type = ReplacerType::LRU,
+                    size_t lru_k = LRUK_REPLACER_K,
+                    HugePageMode huge_pages = HugePageMode::NONE);
 
-  Page *FetchPage(page_id_t page_id);
+  virtual ~BufferPoolManager();
 
-  bool UnpinPage(page_id_t page_id, bool is_dirty);
+  // a miss under a strategy reuses a frame of its ring, see AccessStrategy
+  virtual Page *FetchPage(page_id_t page_id,
+                          AccessStrategy *strategy = nullptr);
 
-  bool FlushPage(page_id_t page_id);
+  // start loading the page into a frame in the background, without pinning
+  // it. Under a strategy the frame comes from its ring like a miss would
+  virtual bool PrefetchPage(page_id_t page_id,
+                            AccessStrategy *strategy = nullptr);
 
-  Page *NewPage(page_id_t &page_id);
+  // pin the page only if it is already in the pool, never waits for disk I/O
+  virtual Page *TryFetchPage(page_id_t page_id);
 
-  bool DeletePage(page_id_t page_id);
+  // copy the page into data if it is already in the pool, without pinning it
+  // for the caller or counting an access in the replacer. For read-ahead,
+  // which must look at a page it is not using yet
+  virtual bool PeekPage(page_id_t page_id, char *data);
+
+  virtual bool UnpinPage(page_id_t page_id, bool is_dirty);
+
+  // pin every page of page_ids taking the latch once, the misses are read
+  // concurrently. pages[i] is nullptr if page_ids[i] cannot be brought in, a
+  // page repeated in page_ids is pinned once per occurrence
+  virtual std::vector<Page *> FetchPages(const std::vector<page_id_t> &page_ids);
+
+  // unpin every page of page_ids, false if one of them was not pinned
+  virtual bool UnpinPages(const std::vector<page_id_t> &page_ids,
+                          bool is_dirty);
+
+  virtual bool FlushPage(page_id_t page_id);
+
+  // write back every dirty page, in page id order
+  virtual void FlushAllPages();
+
+  // write back the dirty pages with first_page_id <= page_id <= last_page_id,
+  // in page id order and without holding the latch during the writes
+  virtual void FlushPages(page_id_t first_page_id, page_id_t last_page_id);
+
+  // a page freed by DeletePage is reused first, the one closest to
+  // hint_page_id (see FreeSpaceMap::Allocate)
+  virtual Page *NewPage(page_id_t &page_id,
+                        page_id_t hint_page_id = INVALID_PAGE_ID,
+                        AccessStrategy *strategy = nullptr);
+
+  virtual bool DeletePage(page_id_t page_id);
+
+  // guarded versions of NewPage/FetchPage, the guard unpins the page (and
+  // releases its latch) when it goes out of scope. The guard is invalid when
+  // the page cannot be brought into the pool
+  BasicPageGuard NewPageGuarded(page_id_t &page_id,
+                                page_id_t hint_page_id = INVALID_PAGE_ID,
+                                AccessStrategy *strategy = nullptr);
+
+  virtual ReadPageGuard FetchPageRead(page_id_t page_id,
+                                      AccessStrategy *strategy = nullptr);
+
+  WritePageGuard FetchPageWrite(page_id_t page_id,
+                                AccessStrategy *strategy = nullptr);
+
+  virtual size_t GetPoolSize();
+
+  // add n frames to the pool. The pool never grows past MAX_POOL_SIZE_FACTOR
+  // times the size it was built with (the capacity in DumpStats): the
+  // constructor reserves the address space of that many frames so the frames
+  // stay contiguous and the frame indexed replacers never reallocate. The
+  // reservation costs address space only, raise the factor for pools that
+  // must grow further. Return the number of frames added, 0 at the cap
+  virtual size_t Grow(size_t n);
+
+  // release up to n frames from the end of the pool, the pool keeps at least
+  // one frame. An unpinned page in a released frame moves to a free frame
+  // lower in the pool if there is one and stays cached, otherwise it is
+  // evicted. Return the number of frames released, less than n when a frame
+  // to release holds a pinned page, which cannot be moved
+  virtual size_t Shrink(size_t n);
+
+  // text dump of the buffer pool metrics, see Metrics::SetEnabled
+  virtual std::string DumpStats();
+
+  // state of the ARC replacer, false if another policy is used
+  virtual bool GetARCStats(ARCStats &stats);
+
+  // background page cleaner, writes back at most max_pages_per_round dirty
+  // unpinned pages every interval (sooner when an eviction had to write a
+  // dirty page). The pages stay in the pool, only their write moves off the
+  // eviction path
+  virtual void StartPageCleaner(
+      size_t max_pages_per_round = 16,
+      std::chrono::milliseconds interval = std::chrono::milliseconds(10));
+
+  virtual void StopPageCleaner();
+
+  // read the free space map of an existing database up front, otherwise the
+  // first NewPage or DeletePage reads it, see FreeSpaceMap
+  virtual bool LoadFreeSpaceMap();
+
+  // warm restart: when set, the destructor writes the ids of the resident
+  // pages to file_name, hottest first, for LoadManifest of the next pool
+  void SetManifestFile(const std::string &file_name);
+
+  // read the pages of a manifest back into the pool, the hottest ones up to
+  // the pool size, in page id order and concurrently through the disk
+  // scheduler. The pages are not pinned so traffic can be admitted meanwhile.
+  // Once the reads are done the pages are handed to the replacer again in
+  // manifest order, so the hottest page is evicted last. When wait is false
+  // the reads are left in flight and the pages keep the order their reads
+  // completed in. Return the number of pages read
+  virtual size_t LoadManifest(const std::string &file_name, bool wait = true);
+
+  // second tier on local SSD for the clean pages evicted from the pool, a
+  // spill file of capacity pages (split over the instances of a parallel
+  // pool), see VictimCache. Throw an Exception if the file cannot be created
+  virtual void EnableVictimCache(const std::string &file_name,
+                                 size_t capacity);
+
+  // counters of the victim cache, false if it is not enabled
+  virtual bool GetVictimCacheStats(VictimCacheStats &stats);
+
+  // keep the pages compressed in file_name instead of the DiskManager file,
+  // see CompressedPageStore. Call it before the first page is read or
+  // written. It can be enabled on an existing database: a page not written
+  // since is read from the DiskManager file (see DiskScheduler::SetPageStore).
+  // Throw an Exception if the file cannot be opened
+  virtual void EnableCompression(const std::string &file_name);
+
+  // read and write the pages through a descriptor of db_file, the file of
+  // the DiskManager, so that a flush writes each run of contiguous dirty
+  // pages with one pwritev. With direct_io the file is opened with O_DIRECT
+  // and the pages are not cached by the OS as well, false is returned if the
+  // file system does not support it. Call it before the first page is read
+  // or written. Throw an Exception if the file cannot be opened
+  bool OpenDatabaseFile(const std::string &db_file, bool direct_io = false);
+
+  // counters of the compressed page file, false if it is not enabled
+  bool GetCompressionStats(CompressionStats &stats);
+
+  // number of dirty pages written back by the page cleaner
+  virtual size_t GetPagesCleaned();
+
+  // number of times FetchPage/NewPage still had to evict a dirty page
+  virtual size_t GetDirtyVictims();
+
+protected:
+  // used by pools that do not own any frame themselves
+  BufferPoolManager(DiskManager *disk_manager, LogManager *log_manager);
+
+  void WriteSortedPages(std::vector<Page *> &pages);
+
+  // manifest file: MANIFEST_MAGIC, number of pages, then the page ids.
+  // ReadManifest keeps the first max_pages ids, false if the count in the
+  // header does not match the size of the file
+  static bool WriteManifest(const std::string &file_name,
+                            const std::vector<page_id_t> &page_ids);
+  static bool ReadManifest(const std::string &file_name,
+                           std::vector<page_id_t> &page_ids,
+                           size_t max_pages);
 
-private:
-  size_t pool_size_; // number of pages in buffer pool
-  Page *pages_;      // array of pages
   DiskManager *disk_manager_;
   LogManager *log_manager_;
+  // all page reads and writes go through it, the instances of a parallel
+  // pool share the scheduler of the parallel pool
+  DiskScheduler *disk_scheduler_;
+  bool owns_disk_scheduler_; // the destructor deletes disk_scheduler_
+  CompressedPageStore *page_store_; // nullptr unless pages are compressed
+
+private:
+  friend class ParallelBufferPoolManager;
+  friend class AccessStrategy;
+  friend class ReadOnlyBufferPoolManager;
+  friend class FreeSpaceMap;
+
+  size_t pool_size_; // number of pages in buffer pool
+  size_t capacity_;  // frames reserved in pages_, pool_size_ <= capacity_
+  uint32_t num_instances_;  // number of instances in the parallel pool
+  uint32_t instance_index_; // index of this instance in the parallel pool
+  page_id_t next_page_id_;  // next page id to allocate in striped mode
+  FrameArena *arena_; // page aligned memory of the frames
+  Page *pages_;      // frames FRAME_STRIDE bytes apart, the first pool_size_ in use
+  // serializes Grow and Shrink, pool_size_ is written holding both latches
+  std::mutex resize_latch_;
   HashTable<page_id_t, Page *> *page_table_; // to keep track of pages
   Replacer<Page *> *replacer_;   // to find an unpinned page for replacement
   std::list<Page *> *free_list_; // to find a free page for replacement
+  FreeSpaceMap *free_space_map_; // deleted page ids to allocate again
+  VictimCache *victim_cache_;    // nullptr unless enabled, set under latch_
   std::mutex latch_;             // to protect shared data structure
+  // the latch is not held while a frame is LOADING or EVICTING, other
+  // threads asking for the same page wait on the condition of that frame.
+  // Frames past pool_size_ are RETIRED
+  enum class FrameState { FREE, LOADING, RESIDENT, EVICTING, RETIRED };
+  FrameState *frame_states_;            // state of each frame
+  std::condition_variable *frame_cvs_;  // to wait on a frame doing disk I/O
+  // frames last filled through an AccessStrategy, their unpin hands them to
+  // the replacer cold until a fetch without the strategy hits them
+  std::atomic<bool> *ring_frames_;
+  inline size_t FrameIndex(Page *page) { return FrameOffset(page, pages_); }
+  inline Page *GetFrame(size_t frame_id) { return FrameAt(pages_, frame_id); }
+
+  // a hit only pins the frame with an atomic increment of its pin_count_,
+  // without the latch. The pin_count_ of a FREE, LOADING or EVICTING frame is
+  // FRAME_UNPINNABLE, the last unpin holds FRAME_RELEASING while it gives the
+  // frame back to the replacer. A frame is claimed for eviction by moving its
+  // pin_count_ from 0 to FRAME_UNPINNABLE
+  static constexpr int FRAME_UNPINNABLE = -1;
+  static constexpr int FRAME_RELEASING = -2;
+  int PinFrame(Page *page);
+  // an unpin that is not an access of the page (prefetch, flush, peek) hands
+  // the frame back without touching its replacement history
+  bool ReleasePin(Page *page, bool accessed = true);
+  bool ClaimFrame(Page *page);
+  Page *TryPinResident(page_id_t page_id);
+  Page *TryPinPage(page_id_t page_id);
+  bool PopVictim(Page *&victim);
+  void LeaveRing(Page *page);
+
+  // page id -> frame entries read without the latch, written under it. An
+  // entry can be missing (bucket full) or stale, a hit is always confirmed
+  // after pinning, anything else goes through page_table_
+  std::atomic<uint64_t> *hit_table_;
+  size_t hit_buckets_;  // power of 2
+  Page *LookupHitTable(page_id_t page_id);
+  void PublishHitTable(page_id_t page_id, Page *page);
+  void RemoveHitTable(page_id_t page_id);
+
+  // pin_count_ and page_id_ of a frame are read by the lock free paths while
+  // other threads change them, every access goes through these helpers
+  static inline int LoadPinCount(Page *page) {
+    return __atomic_load_n(&page->pin_count_, __ATOMIC_ACQUIRE);
+  }
+  static inline void StorePinCount(Page *page, int pins) {
+    __atomic_store_n(&page->pin_count_, pins, __ATOMIC_RELEASE);
+  }
+  // on failure pins is set to the current pin count
+  static inline bool CasPinCount(Page *page, int &pins, int new_pins) {
+    return __atomic_compare_exchange_n(&page->pin_count_, &pins, new_pins,
+                                       true, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_ACQUIRE);
+  }
+  static inline page_id_t LoadPageId(Page *page) {
+    return __atomic_load_n(&page->page_id_, __ATOMIC_ACQUIRE);
+  }
+  static inline void SetPageId(Page *page, page_id_t page_id) {
+    __atomic_store_n(&page->page_id_, page_id, __ATOMIC_RELEASE);
+  }
+
+  // threads inside the lock free paths, which may still look at a frame
+  // after its hit table entry is removed. Shrink waits for them before it
+  // gives the memory of the released frames back
+  struct alignas(64) HitReaders {
+    std::atomic<size_t> count;
+  };
+  HitReaders *hit_readers_; // METRICS_SHARDS shards of threads
+  HitReaders &EnterHitPath();
+  void WaitForHitReaders();
+  void SetReplacerCacheSize();
+
+  Page *FetchPageImpl(page_id_t page_id, std::unique_lock<std::mutex> &lck,
+                      bool pin, bool *hit = nullptr,
+                      AccessStrategy *strategy = nullptr,
+                      std::future<void> *read = nullptr);
+  void FetchPagesAsync(const std::vector<page_id_t> &page_ids,
+                       std::vector<Page *> &pages,
+                       std::vector<std::future<void>> &reads);
+  void FinishLoad(Page *page, bool pin);
   Page *GetVictimPage();
+  Page *GetStrategyVictim(AccessStrategy *strategy);
+  bool EvictPage(Page *victim, std::unique_lock<std::mutex> &lck);
+  void ReadPageUncached(page_id_t page_id, char *data);
+  bool MovePage(Page *page);
+  void PinDirtyPages(page_id_t first_page_id, page_id_t last_page_id,
+                     std::vector<Page *> &dirty_pages);
+  void UnpinFlushedPages(const std::vector<Page *> &pages);
+  void PageCleaner();
+  void PinUnpinnedDirtyPages(size_t max_pages,
+                             std::vector<Page *> &dirty_pages);
+
+  std::string manifest_file_; // written by the destructor if not empty
+  void GetResidentPages(std::vector<page_id_t> &page_ids);
+  void LoadPages(std::vector<page_id_t> page_ids,
+                 std::vector<std::future<void>> &reads,
+                 std::vector<page_id_t> &loaded);
+  void OrderLoadedPages(const std::vector<page_id_t> &loaded);
+
+  std::thread page_cleaner_;
+  bool cleaner_running_;       // protected by latch_
+  size_t cleaner_max_pages_;   // pages written back per round at most
+  std::chrono::milliseconds cleaner_interval_;
+  size_t cleaner_hand_;        // next frame the cleaner looks at
+  std::condition_variable cleaner_cv_; // to wake up the cleaner
+  std::atomic<size_t> pages_cleaned_;
+  std::atomic<size_t> dirty_victims_;
+
+  void Prefetcher();
+  // drop the queued prefetches of a strategy being destroyed and wait for
+  // the ones being loaded
+  void ForgetStrategy(AccessStrategy *strategy);
+
+  struct PrefetchRequest {
+    page_id_t page_id_;
+    AccessStrategy *strategy_;
+  };
+  std::vector<std::thread> prefetchers_;  // started by the first prefetch
+  std::deque<PrefetchRequest> prefetch_queue_; // protected by latch_
+  std::condition_variable prefetch_cv_;   // to wake up the prefetchers
+  bool prefetch_stop_;                    // protected by latch_
+  // strategies of the prefetches being loaded, protected by latch_
+  std::vector<AccessStrategy *> prefetch_strategies_;
+  std::condition_variable prefetch_done_cv_; // a prefetch was loaded
+
+  enum StatsCounter {
+    STAT_HITS,
+    STAT_MISSES,
+    STAT_EVICTIONS,
+    STAT_DIRTY_WRITEBACKS,
+    STAT_DISK_READS,
+    STAT_DISK_WRITES,
+    STAT_LATCH_WAITS
+  };
+  enum StatsHistogram {
+    STAT_FETCH_HIT_NS,
+    STAT_FETCH_MISS_NS,
+    STAT_DISK_READ_NS,
+    STAT_DISK_WRITE_NS,
+    STAT_LATCH_WAIT_NS
+  };
+  Metrics stats_;
+  std::unique_lock<std::mutex> LockLatch();
+  page_id_t AllocatePage();
 };
 } // namespace cmudb
@@ -0,0 +1,98 @@
+/**
+ * buffer_pool_manager_benchmark.cpp
+ *
+ * Hit-only scaling of FetchPage/UnpinPage. Every page of the working set is
+ * resident, so each fetch takes the optimistic hit path (pin through the hit
+ * table) and never the latch of the pool. The thread count doubles up to the
+ * number of cores (or the count given); the last column is the throughput per
+ * thread relative to one thread, near 1.0 for linear scaling.
+ *
+ * usage: buffer_pool_manager_benchmark [frames] [seconds] [threads]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+
+using namespace scudb;
+
+namespace {
+
+//每个线程随机读取常驻页，返回每秒完成的FetchPage/UnpinPage次数
+double RunThreads(BufferPoolManager *bpm, const std::vector<page_id_t> &pages,
+                  size_t num_threads, double seconds) {
+  std::atomic<bool> stop(false);
+  std::atomic<size_t> total(0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937_64 rng(t + 1);
+      std::uniform_int_distribution<size_t> pick(0, pages.size() - 1);
+      size_t ops = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        page_id_t page_id = pages[pick(rng)];
+        if (bpm->FetchPage(page_id) != nullptr) {
+          bpm->UnpinPage(page_id, false);
+          ops++;
+        }
+      }
+      total += ops;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return total.load() / seconds;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1024;
+  double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+  size_t cores = argc > 3 ? strtoul(argv[3], nullptr, 10)
+                          : std::thread::hardware_concurrency();
+  cores = std::max<size_t>(cores, 1);
+  if (frames == 0) {
+    fprintf(stderr, "frames must be positive\n");
+    return 1;
+  }
+
+  {
+    DiskManager disk_manager("bpm_benchmark.db");
+    BufferPoolManager bpm(frames, &disk_manager);
+    //工作集只占一半的帧，保证全部命中
+    std::vector<page_id_t> pages;
+    for (size_t i = 0; i < frames / 2 + 1; ++i) {
+      page_id_t page_id;
+      if (bpm.NewPage(page_id) == nullptr) {
+        break;
+      }
+      pages.push_back(page_id);
+      bpm.UnpinPage(page_id, true);
+    }
+
+    printf("%zu frames, %zu resident pages, %zu cores\n", frames, pages.size(),
+           cores);
+    printf("%8s %16s %12s\n", "threads", "ops/s", "per thread");
+    double single = 0;
+    for (size_t num_threads = 1; num_threads <= cores; num_threads *= 2) {
+      double ops = RunThreads(&bpm, pages, num_threads, seconds);
+      if (num_threads == 1) {
+        single = ops;
+      }
+      printf("%8zu %16.0f %12.2f\n", num_threads, ops,
+             ops / num_threads / single);
+    }
+  }
+  remove("bpm_benchmark.db");
+  remove("bpm_benchmark.log");
+  return 0;
+}
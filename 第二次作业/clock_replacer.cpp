@@ -0,0 +1,109 @@
+/**
+ * CLOCK implementation
+ */
+#include "buffer/clock_replacer.h"
+#include "page/page.h"
+
+namespace scudb {
+
+// names of the counters of stats_, in the order of StatsCounter
+static const std::vector<std::string> CLOCK_STATS_COUNTERS = {
+    "inserts", "cold_inserts", "erases", "victims", "empty_victims",
+    "second_chances"};
+
+//初始化时钟，所有帧都不可替换
+template <typename T>
+ClockReplacer<T>::ClockReplacer(T first_frame, size_t num_frames)
+    : first_frame_(first_frame), num_frames_(num_frames),
+      in_clock_(num_frames), ref_(num_frames), size_(0), hand_(0),
+      stats_(CLOCK_STATS_COUNTERS, {}) {
+  for (size_t i = 0; i < num_frames_; ++i) {
+    in_clock_[i].store(false);
+    ref_[i].store(false);
+  }
+}
+
+template <typename T> ClockReplacer<T>::~ClockReplacer() {}
+
+/*
+ * Insert value into the clock: mark the frame as evictable and set its
+ * reference bit, no mutex is taken
+ */
+template <typename T> void ClockReplacer<T>::Insert(const T &value) {
+  size_t frame = FrameIndex(value);
+  stats_.Add(STAT_INSERTS);
+  //先设置访问位再标记为可替换，保证Victim看到该帧时访问位已经置上
+  ref_[frame].store(true);
+  if (!in_clock_[frame].exchange(true)) {
+    size_++;
+  }
+}
+
+template <typename T> void ClockReplacer<T>::InsertCold(const T &value) {
+  size_t frame = FrameIndex(value);
+  stats_.Add(STAT_COLD_INSERTS);
+  if (!in_clock_[frame].exchange(true)) {
+    size_++;
+  }
+}
+
+/* Sweep the clock hand from its last position, give every evictable frame
+ * whose reference bit is set a second chance by clearing the bit, and evict
+ * the first evictable frame whose bit is already cleared. Return false if no
+ * frame can be evicted
+ */
+template <typename T> bool ClockReplacer<T>::Victim(T &value) {
+  lock_guard<mutex> lck(latch);
+  while (size_.load() > 0) {
+    size_t frame = hand_;
+    hand_ = (hand_ + 1) % num_frames_;
+    if (!in_clock_[frame].load()) {
+      continue;
+    }
+    //访问位为1则给第二次机会
+    if (ref_[frame].exchange(false)) {
+      stats_.Add(STAT_SECOND_CHANCES);
+      continue;
+    }
+    //与Erase竞争时，只有成功把可替换标记清掉的一方才算数
+    if (in_clock_[frame].exchange(false)) {
+      size_--;
+      stats_.Add(STAT_VICTIMS);
+      value = FrameAt(first_frame_, frame);
+      return true;
+    }
+  }
+  stats_.Add(STAT_EMPTY_VICTIMS);
+  return false;
+}
+
+/*
+ * Remove value from the clock. If removal is successful, return true,
+ * otherwise return false
+ */
+template <typename T> bool ClockReplacer<T>::Erase(const T &value) {
+  size_t frame = FrameIndex(value);
+  if (frame >= num_frames_) {
+    return false;
+  }
+  if (in_clock_[frame].exchange(false)) {
+    size_--;
+    stats_.Add(STAT_ERASES);
+    return true;
+  }
+  return false;
+}
+
+//返回可替换帧的数量
+template <typename T> size_t ClockReplacer<T>::Size() { return size_.load(); }
+
+template <typename T>
+std::string ClockReplacer<T>::DumpStats(const std::string &prefix) {
+  return prefix + ".size " + std::to_string(Size()) + "\n" + stats_.Dump(prefix);
+}
+
+template class ClockReplacer<Page *>;
+// test only
+template class ClockReplacer<int>;
+
+} // namespace scudb
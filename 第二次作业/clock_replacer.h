@@ -0,0 +1,69 @@
+/**
+ * clock_replacer.h
+ *
+ * Functionality: CLOCK (second chance) replacement policy. Every frame has a
+ * reference bit which is set when the frame is unpinned, the clock hand sweeps
+ * over the frames and evicts the first evictable frame whose reference bit is
+ * already cleared, clearing the bits it passes by. Insert and Erase only do
+ * atomic operations on the frame, so the hit path never takes a mutex.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "buffer/frame_arena.h"
+#include "buffer/metrics.h"
+#include "buffer/replacer.h"
+
+using namespace std;
+namespace scudb {
+
+template <typename T> class ClockReplacer : public Replacer<T> {
+public:
+  // frames are the num_frames values starting at first_frame
+  ClockReplacer(T first_frame, size_t num_frames);
+
+  ~ClockReplacer();
+
+  void Insert(const T &value);
+
+  // mark the frame as evictable without setting its reference bit, for a
+  // page loaded ahead of use or only looked at by the pool
+  void InsertCold(const T &value);
+
+  bool Victim(T &value);
+
+  bool Erase(const T &value);
+
+  size_t Size();
+
+  // text dump of the replacer counters, see Metrics
+  std::string DumpStats(const std::string &prefix);
+
+private:
+  inline size_t FrameIndex(const T &value) const {
+    return FrameOffset(value, first_frame_);
+  }
+
+  T first_frame_;
+  size_t num_frames_;
+  vector<atomic<bool>> in_clock_; // whether the frame can be evicted
+  vector<atomic<bool>> ref_;      // reference bit of each frame
+  atomic<size_t> size_;           // number of frames that can be evicted
+  size_t hand_;                   // clock hand, protected by latch
+  mutex latch;                    // only taken by Victim to move the hand
+  enum StatsCounter {
+    STAT_INSERTS,
+    STAT_COLD_INSERTS,
+    STAT_ERASES,
+    STAT_VICTIMS,
+    STAT_EMPTY_VICTIMS,
+    STAT_SECOND_CHANCES
+  };
+  Metrics stats_;
+};
+
+} // namespace scudb
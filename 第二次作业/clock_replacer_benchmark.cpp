@@ -0,0 +1,184 @@
+/**
+ * clock_replacer_benchmark.cpp
+ *
+ * Hit ratio and speed of ClockReplacer against LRUReplacer. Each workload is
+ * a trace of page accesses replayed on a simulated pool: a hit erases the
+ * frame from the replacer and inserts it again (pin and unpin), a miss takes
+ * a free frame or a victim. The traces are
+ *   uniform - pages picked uniformly among 4 times the number of frames
+ *   zipfian - the same pages picked with a zipfian distribution (theta 0.99)
+ *   scan    - a loop over 1.25 times the number of frames
+ * The last line runs only hits from several threads, where LRU takes its
+ * mutex on every Insert/Erase and CLOCK only does atomic operations.
+ *
+ * usage: clock_replacer_benchmark [frames] [accesses] [threads]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer/clock_replacer.h"
+#include "buffer/lru_replacer.h"
+
+using namespace scudb;
+
+namespace {
+
+std::vector<int> UniformTrace(size_t pages, size_t accesses) {
+  std::mt19937_64 rng(1);
+  std::uniform_int_distribution<int> pick(0, static_cast<int>(pages) - 1);
+  std::vector<int> trace(accesses);
+  for (auto &page : trace) {
+    page = pick(rng);
+  }
+  return trace;
+}
+
+//按zipf分布的累积概率二分查找页号，热点页分散到整个页号空间
+std::vector<int> ZipfianTrace(size_t pages, size_t accesses) {
+  std::vector<double> cdf(pages);
+  double sum = 0;
+  for (size_t i = 0; i < pages; ++i) {
+    sum += 1.0 / std::pow(static_cast<double>(i + 1), 0.99);
+    cdf[i] = sum;
+  }
+  std::vector<int> permutation(pages);
+  for (size_t i = 0; i < pages; ++i) {
+    permutation[i] = static_cast<int>(i);
+  }
+  std::mt19937_64 rng(2);
+  std::shuffle(permutation.begin(), permutation.end(), rng);
+  std::uniform_real_distribution<double> pick(0, sum);
+  std::vector<int> trace(accesses);
+  for (auto &page : trace) {
+    size_t rank = std::lower_bound(cdf.begin(), cdf.end(), pick(rng)) -
+                  cdf.begin();
+    page = permutation[std::min(rank, pages - 1)];
+  }
+  return trace;
+}
+
+std::vector<int> ScanTrace(size_t pages, size_t accesses) {
+  std::vector<int> trace(accesses);
+  for (size_t i = 0; i < accesses; ++i) {
+    trace[i] = static_cast<int>(i % pages);
+  }
+  return trace;
+}
+
+struct Result {
+  double hit_ratio;
+  double ops_per_second;
+};
+
+//用替换器模拟一个frames帧的缓冲池重放访问序列
+Result Replay(Replacer<int> *replacer, size_t frames, size_t pages,
+              const std::vector<int> &trace) {
+  std::vector<int> page_frame(pages, -1);
+  std::vector<int> frame_page(frames, -1);
+  size_t used = 0;
+  size_t hits = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int page : trace) {
+    int frame = page_frame[page];
+    if (frame >= 0) {
+      hits++;
+      replacer->Erase(frame);
+    } else {
+      if (used < frames) {
+        frame = static_cast<int>(used++);
+      } else if (replacer->Victim(frame)) {
+        page_frame[frame_page[frame]] = -1;
+      } else {
+        continue;
+      }
+      page_frame[page] = frame;
+      frame_page[frame] = page;
+    }
+    replacer->Insert(frame);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return Result{static_cast<double>(hits) / trace.size(),
+                trace.size() / elapsed.count()};
+}
+
+//多个线程只做命中：Erase之后立即Insert
+double HitPath(Replacer<int> *replacer, size_t frames, size_t num_threads,
+               size_t accesses) {
+  for (size_t i = 0; i < frames; ++i) {
+    replacer->Insert(static_cast<int>(i));
+  }
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([=] {
+      std::mt19937_64 rng(t + 1);
+      std::uniform_int_distribution<int> pick(0, static_cast<int>(frames) - 1);
+      for (size_t i = 0; i < accesses; ++i) {
+        int frame = pick(rng);
+        replacer->Erase(frame);
+        replacer->Insert(frame);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return num_threads * accesses / elapsed.count();
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4096;
+  size_t accesses = argc > 2 ? strtoul(argv[2], nullptr, 10) : 5000000;
+  size_t num_threads = argc > 3 ? strtoul(argv[3], nullptr, 10)
+                                : std::thread::hardware_concurrency();
+  if (frames == 0 || accesses == 0 || num_threads == 0) {
+    fprintf(stderr, "frames, accesses and threads must be positive\n");
+    return 1;
+  }
+
+  struct Workload {
+    std::string name;
+    size_t pages;
+    std::vector<int> trace;
+  };
+  std::vector<Workload> workloads;
+  size_t pages = frames * 4;
+  size_t scan_pages = frames * 5 / 4;
+  workloads.push_back({"uniform", pages, UniformTrace(pages, accesses)});
+  workloads.push_back({"zipfian", pages, ZipfianTrace(pages, accesses)});
+  workloads.push_back({"scan", scan_pages, ScanTrace(scan_pages, accesses)});
+
+  printf("%zu frames, %zu accesses per workload\n", frames, accesses);
+  printf("%-10s %10s %14s %10s %14s\n", "workload", "LRU hits", "LRU ops/s",
+         "CLOCK hits", "CLOCK ops/s");
+  for (auto &workload : workloads) {
+    LRUReplacer<int> lru(0, frames);
+    ClockReplacer<int> clock(0, frames);
+    Result lru_result = Replay(&lru, frames, workload.pages, workload.trace);
+    Result clock_result =
+        Replay(&clock, frames, workload.pages, workload.trace);
+    printf("%-10s %9.2f%% %14.0f %9.2f%% %14.0f\n", workload.name.c_str(),
+           lru_result.hit_ratio * 100, lru_result.ops_per_second,
+           clock_result.hit_ratio * 100, clock_result.ops_per_second);
+  }
+
+  LRUReplacer<int> lru(0, frames);
+  ClockReplacer<int> clock(0, frames);
+  double lru_hits = HitPath(&lru, frames, num_threads, accesses / num_threads);
+  double clock_hits =
+      HitPath(&clock, frames, num_threads, accesses / num_threads);
+  printf("hit path, %zu threads: LRU %.0f ops/s, CLOCK %.0f ops/s\n",
+         num_threads, lru_hits, clock_hits);
+  return 0;
+}
@@ -0,0 +1,283 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "buffer/compressed_page_store.h"
+#include "buffer/metrics.h"
+#include "buffer/page_compressor.h"
+#include "common/exception.h"
+
+namespace scudb {
+
+namespace {
+// one entry of the map file
+struct MapEntry {
+  int32_t page_id;
+  uint32_t size;
+  uint32_t capacity;
+  uint32_t reserved;
+  uint64_t offset;
+};
+} // namespace
+
+CompressedPageStore::CompressedPageStore(const std::string &file_name)
+    : file_name_(file_name), overwrites_(0), syncing_(false), file_end_(0),
+      pages_written_(0), pages_read_(0),
+      bytes_written_(0), bytes_read_(0), compress_ns_(0), decompress_ns_(0) {
+  fd_ = open(file_name.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd_ < 0) {
+    throw Exception("can't open compressed page file " + file_name);
+  }
+  if (!LoadMap()) {
+    close(fd_);
+    throw Exception("corrupted page map " + file_name + ".map");
+  }
+}
+
+CompressedPageStore::~CompressedPageStore() {
+  Sync();
+  close(fd_);
+}
+
+/*
+ * Read file_name.map, a missing map is an empty file. Slots are rebuilt from
+ * the map: the gaps between the mapped slots are free
+ */
+bool CompressedPageStore::LoadMap() {
+  std::ifstream in(file_name_ + ".map", std::ios::binary);
+  if (!in) {
+    return true;
+  }
+  uint32_t header[2];
+  if (!in.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+      header[0] != COMPRESSED_MAP_MAGIC) {
+    return false;
+  }
+  std::vector<MapEntry> entries(header[1]);
+  if (!in.read(reinterpret_cast<char *>(entries.data()),
+               entries.size() * sizeof(MapEntry))) {
+    return false;
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const MapEntry &a, const MapEntry &b) {
+              return a.offset < b.offset;
+            });
+  for (const auto &entry : entries) {
+    if (entry.offset < file_end_ || entry.size > entry.capacity ||
+        entry.size > PAGE_SIZE) {
+      return false;
+    }
+    if (entry.offset > file_end_) {
+      FreeSlot(file_end_, static_cast<uint32_t>(entry.offset - file_end_));
+    }
+    page_map_[entry.page_id] = PageSlot{entry.offset, entry.size,
+                                        entry.capacity, true};
+    file_end_ = entry.offset + entry.capacity;
+  }
+  return true;
+}
+
+/*
+ * Write the map to a temporary file and rename it, a crash in the middle
+ * leaves the previous map. The slots the previous map pointed to are only
+ * freed once the rename is done, and from the snapshot on every mapped slot
+ * is treated as saved, so a page written meanwhile moves again
+ */
+bool CompressedPageStore::Sync() {
+  std::lock_guard<std::mutex> sync_lck(sync_latch_);
+  std::vector<MapEntry> entries;
+  std::vector<std::pair<uint64_t, uint32_t>> releasing;
+  {
+    std::unique_lock<std::mutex> lck(latch_);
+    //原地覆盖的槽写完之前不能进快照，等待期间新的写都换新槽
+    syncing_ = true;
+    overwrites_cv_.wait(lck, [&] { return overwrites_ == 0; });
+    syncing_ = false;
+    for (auto &slot : page_map_) {
+      entries.push_back(MapEntry{slot.first, slot.second.size,
+                                 slot.second.capacity, 0, slot.second.offset});
+      slot.second.synced = true;
+    }
+    releasing.swap(pending_free_);
+  }
+  bool saved = fdatasync(fd_) == 0;
+  std::string tmp_name = file_name_ + ".map.tmp";
+  if (saved) {
+    std::ofstream out(tmp_name, std::ios::binary | std::ios::trunc);
+    uint32_t header[2] = {COMPRESSED_MAP_MAGIC,
+                          static_cast<uint32_t>(entries.size())};
+    out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(entries.data()),
+              entries.size() * sizeof(MapEntry));
+    out.close();
+    saved = static_cast<bool>(out) &&
+            std::rename(tmp_name.c_str(), (file_name_ + ".map").c_str()) == 0;
+    if (!saved) {
+      std::remove(tmp_name.c_str());
+    }
+  }
+  //映射没有保存下来时，旧映射仍然指向这些槽，留到下一次Sync再释放
+  std::lock_guard<std::mutex> lck(latch_);
+  for (const auto &slot : releasing) {
+    if (saved) {
+      FreeSlot(slot.first, slot.second);
+    } else {
+      pending_free_.push_back(slot);
+    }
+  }
+  return saved;
+}
+
+/*
+ * Smallest free slot of at least capacity bytes, its tail goes back to the
+ * free slots. Otherwise grow the file. Called with the latch held
+ */
+uint64_t CompressedPageStore::TakeSlot(uint32_t capacity) {
+  auto it = free_slots_.lower_bound(capacity);
+  if (it == free_slots_.end()) {
+    uint64_t offset = file_end_;
+    file_end_ += capacity;
+    return offset;
+  }
+  uint32_t slot_capacity = it->first;
+  uint64_t offset = it->second.back();
+  it->second.pop_back();
+  if (it->second.empty()) {
+    free_slots_.erase(it);
+  }
+  if (slot_capacity > capacity) {
+    FreeSlot(offset + capacity, slot_capacity - capacity);
+  }
+  return offset;
+}
+
+void CompressedPageStore::FreeSlot(uint64_t offset, uint32_t capacity) {
+  free_slots_[capacity].push_back(offset);
+}
+
+void CompressedPageStore::WritePage(page_id_t page_id, const char *page_data) {
+  char buffer[PAGE_SIZE];
+  uint64_t start = Metrics::Now();
+  //压缩后不比原页小的页原样存放
+  size_t size = PageCompressor::Compress(page_data, buffer, PAGE_SIZE - 1);
+  if (start != 0) {
+    compress_ns_ += Metrics::Now() - start;
+  }
+  const char *data = buffer;
+  if (size == 0) {
+    size = PAGE_SIZE;
+    data = page_data;
+  }
+  uint32_t capacity = static_cast<uint32_t>(
+      (size + COMPRESSED_SLOT_UNIT - 1) / COMPRESSED_SLOT_UNIT *
+      COMPRESSED_SLOT_UNIT);
+  uint64_t offset;
+  bool overwrite = false;
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    auto it = page_map_.find(page_id);
+    if (it != page_map_.end() && !it->second.synced && !syncing_ &&
+        it->second.capacity >= capacity) {
+      //上次Sync之后写的槽没有被保存的映射引用，放得下就原地覆盖
+      offset = it->second.offset;
+      overwrite = true;
+      overwrites_++;
+    } else {
+      //新槽写完之后才放进映射，Sync的快照不会引用还没写好的槽
+      offset = TakeSlot(capacity);
+    }
+  }
+  bool written = pwrite(fd_, data, size, static_cast<off_t>(offset)) ==
+                 static_cast<ssize_t>(size);
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    auto it = page_map_.find(page_id);
+    if (overwrite) {
+      if (written) {
+        it->second.size = static_cast<uint32_t>(size);
+      }
+      if (--overwrites_ == 0) {
+        overwrites_cv_.notify_all();
+      }
+    } else if (!written) {
+      //写失败时映射仍指向旧槽
+      FreeSlot(offset, capacity);
+    } else {
+      //保存的映射引用的槽要等下一次Sync之后才能释放
+      if (it != page_map_.end()) {
+        if (it->second.synced) {
+          pending_free_.emplace_back(it->second.offset, it->second.capacity);
+        } else {
+          FreeSlot(it->second.offset, it->second.capacity);
+        }
+      }
+      page_map_[page_id] =
+          PageSlot{offset, static_cast<uint32_t>(size), capacity, false};
+    }
+  }
+  if (!written) {
+    return;
+  }
+  pages_written_++;
+  bytes_written_ += size;
+}
+
+/*
+ * A page never written reads as zeros. On an I/O error or a corrupted slot
+ * the page is zeroed as well and false is returned
+ */
+bool CompressedPageStore::ReadPage(page_id_t page_id, char *page_data) {
+  PageSlot slot;
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    auto it = page_map_.find(page_id);
+    if (it == page_map_.end()) {
+      memset(page_data, 0, PAGE_SIZE);
+      return true;
+    }
+    slot = it->second;
+  }
+  char buffer[PAGE_SIZE];
+  char *target = slot.size == PAGE_SIZE ? page_data : buffer;
+  if (pread(fd_, target, slot.size, static_cast<off_t>(slot.offset)) !=
+      static_cast<ssize_t>(slot.size)) {
+    memset(page_data, 0, PAGE_SIZE);
+    return false;
+  }
+  pages_read_++;
+  bytes_read_ += slot.size;
+  if (slot.size == PAGE_SIZE) {
+    return true;
+  }
+  uint64_t start = Metrics::Now();
+  bool decompressed = PageCompressor::Decompress(buffer, slot.size, page_data);
+  if (start != 0) {
+    decompress_ns_ += Metrics::Now() - start;
+  }
+  if (!decompressed) {
+    memset(page_data, 0, PAGE_SIZE);
+  }
+  return decompressed;
+}
+
+bool CompressedPageStore::Contains(page_id_t page_id) {
+  std::lock_guard<std::mutex> lck(latch_);
+  return page_map_.find(page_id) != page_map_.end();
+}
+
+CompressionStats CompressedPageStore::GetStats() {
+  uint64_t file_bytes;
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    file_bytes = file_end_;
+  }
+  return CompressionStats{pages_written_.load(), pages_read_.load(),
+                          bytes_written_.load(), bytes_read_.load(),
+                          file_bytes,           compress_ns_.load(),
+                          decompress_ns_.load()};
+}
+} // namespace scudb
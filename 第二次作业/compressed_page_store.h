@@ -0,0 +1,107 @@
+/*
+ * compressed_page_store.h
+ *
+ * Functionality: page file that keeps every page compressed by PageCompressor
+ * (or raw if it does not compress) in a variable size slot. Slots are a
+ * multiple of COMPRESSED_SLOT_UNIT bytes, a page id -> slot map says where
+ * each page is. The map is kept in memory and saved to file_name.map by Sync
+ * and the destructor. A slot the saved map points to is never written over
+ * until the next Sync has replaced that map: a page rewritten after a Sync
+ * moves to a free slot large enough, or to the end of the file, and its old
+ * slot only becomes free once the next Sync is done. A crash therefore leaves
+ * every page as it was at the last Sync. A page rewritten twice between two
+ * Syncs is overwritten in its new slot if it still fits there. A new slot
+ * only enters the map once its write is done, and Sync waits for the
+ * overwrites in flight, so a saved map never points to a slot being written.
+ * The free slots are the gaps between the mapped ones, they are not merged.
+ * A page never written reads back as zeros, like past the end of a
+ * DiskManager file, Contains tells such a page apart.
+ *
+ * Reads and writes of different pages run concurrently, the caller must not
+ * read and write one page at the same time (the buffer pool never does).
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+
+namespace scudb {
+#define COMPRESSED_SLOT_UNIT 128
+#define COMPRESSED_MAP_MAGIC 0x5a4d5043 // "CPMZ", first word of the map file
+
+struct CompressionStats {
+  size_t pages_written;
+  size_t pages_read;
+  size_t bytes_written; // bytes of the slots written, PAGE_SIZE if raw
+  size_t bytes_read;
+  size_t file_bytes;    // size of the page file
+  size_t compress_ns;   // CPU time, only counted while Metrics are enabled
+  size_t decompress_ns;
+};
+
+class CompressedPageStore {
+public:
+  // open (or create) file_name and load its map, throw an Exception if the
+  // file cannot be opened or the map is corrupted
+  explicit CompressedPageStore(const std::string &file_name);
+
+  // save the map
+  ~CompressedPageStore();
+
+  CompressedPageStore(const CompressedPageStore &) = delete;
+  CompressedPageStore &operator=(const CompressedPageStore &) = delete;
+
+  void WritePage(page_id_t page_id, const char *page_data);
+
+  // false if the slot cannot be read or decompressed
+  bool ReadPage(page_id_t page_id, char *page_data);
+
+  // true once page_id was written to the store
+  bool Contains(page_id_t page_id);
+
+  // write the map to file_name.map and free the slots it no longer points
+  // to, false on an I/O error
+  bool Sync();
+
+  CompressionStats GetStats();
+
+private:
+  struct PageSlot {
+    uint64_t offset;
+    uint32_t size;     // bytes of the page in the slot, PAGE_SIZE if raw
+    uint32_t capacity; // bytes of the slot
+    bool synced;       // the saved map may point to this slot
+  };
+
+  uint64_t TakeSlot(uint32_t capacity);
+  void FreeSlot(uint64_t offset, uint32_t capacity);
+  bool LoadMap();
+
+  std::string file_name_;
+  int fd_;
+  std::mutex sync_latch_; // one Sync at a time
+  std::mutex latch_; // protects the map, the free slots and the fields below
+  std::condition_variable overwrites_cv_; // the last overwrite completed
+  size_t overwrites_; // writes in flight into a slot of the map
+  bool syncing_;      // Sync waits for the overwrites, take new slots
+  std::unordered_map<page_id_t, PageSlot> page_map_;
+  std::map<uint32_t, std::vector<uint64_t>> free_slots_; // capacity -> offsets
+  // slots of the saved map that were replaced since, freed by the next Sync
+  std::vector<std::pair<uint64_t, uint32_t>> pending_free_;
+  uint64_t file_end_;
+
+  std::atomic<size_t> pages_written_;
+  std::atomic<size_t> pages_read_;
+  std::atomic<size_t> bytes_written_;
+  std::atomic<size_t> bytes_read_;
+  std::atomic<size_t> compress_ns_;
+  std::atomic<size_t> decompress_ns_;
+};
+} // namespace scudb
@@ -0,0 +1,109 @@
+/**
+ * compressed_page_store_benchmark.cpp
+ *
+ * Bytes read by a range scan and CPU cost of compression for B+ tree leaves
+ * with GenericKey<64> keys. The leaves are built like BPlusTreeLeafPage: a 28
+ * byte header followed by full (key, RID) pairs, the 64 byte keys made from
+ * integers as GenericKey::SetFromInteger does (8 bytes then zeros). They are
+ * written to a CompressedPageStore and scanned back in order; the scan reads
+ * the slots instead of PAGE_SIZE bytes per leaf. The CPU columns are the
+ * time spent in PageCompressor per page.
+ *
+ * usage: compressed_page_store_benchmark [leaves] [file]
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "buffer/compressed_page_store.h"
+#include "buffer/metrics.h"
+
+using namespace scudb;
+
+#define LEAF_HEADER_SIZE 28
+#define LEAF_KEY_SIZE 64
+#define LEAF_PAIR_SIZE (LEAF_KEY_SIZE + 8) // key and RID
+
+namespace {
+
+//按叶子页的布局填充：头部、连续的key和RID
+void BuildLeaf(char *data, page_id_t page_id, int64_t first_key, int pairs) {
+  memset(data, 0, PAGE_SIZE);
+  int32_t header[7] = {2, 0, pairs, pairs, INVALID_PAGE_ID, page_id,
+                       page_id + 1};
+  memcpy(data, header, sizeof(header));
+  for (int i = 0; i < pairs; ++i) {
+    char *pair = data + LEAF_HEADER_SIZE + i * LEAF_PAIR_SIZE;
+    int64_t key = first_key + i;
+    memcpy(pair, &key, sizeof(key));
+    int32_t rid[2] = {static_cast<int32_t>(key / 32),
+                      static_cast<int32_t>(key % 32)};
+    memcpy(pair + LEAF_KEY_SIZE, rid, sizeof(rid));
+  }
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t leaves = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+  std::string file_name =
+      argc > 2 ? argv[2] : "compressed_page_store_benchmark.db";
+  if (leaves == 0) {
+    fprintf(stderr, "leaves must be positive\n");
+    return 1;
+  }
+  int pairs = (PAGE_SIZE - LEAF_HEADER_SIZE) / LEAF_PAIR_SIZE;
+
+  //打开计时统计，CompressionStats才会记录压缩和解压的CPU时间
+  Metrics::SetEnabled(true);
+  std::vector<char> data(PAGE_SIZE);
+  double write_seconds;
+  double scan_seconds;
+  CompressionStats stats;
+  {
+    CompressedPageStore store(file_name);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t leaf = 0; leaf < leaves; ++leaf) {
+      page_id_t page_id = static_cast<page_id_t>(leaf);
+      BuildLeaf(data.data(), page_id, static_cast<int64_t>(leaf) * pairs,
+                pairs);
+      store.WritePage(page_id, data.data());
+    }
+    store.Sync();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    write_seconds = elapsed.count();
+
+    start = std::chrono::steady_clock::now();
+    for (size_t leaf = 0; leaf < leaves; ++leaf) {
+      if (!store.ReadPage(static_cast<page_id_t>(leaf), data.data())) {
+        fprintf(stderr, "can't read leaf %zu\n", leaf);
+        return 1;
+      }
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    scan_seconds = elapsed.count();
+    stats = store.GetStats();
+  }
+  remove(file_name.c_str());
+  remove((file_name + ".map").c_str());
+
+  double raw_bytes = static_cast<double>(leaves) * PAGE_SIZE;
+  printf("%zu leaves, %d pairs of GenericKey<64> and RID each\n", leaves,
+         pairs);
+  printf("scan bytes read      %12zu (%.1f%% of %.0f)\n", stats.bytes_read,
+         stats.bytes_read * 100.0 / raw_bytes, raw_bytes);
+  printf("file bytes           %12zu\n", stats.file_bytes);
+  printf("compress             %12.2f us/page\n",
+         stats.compress_ns / 1000.0 / stats.pages_written);
+  printf("decompress           %12.2f us/page\n",
+         stats.decompress_ns / 1000.0 / stats.pages_read);
+  printf("write + sync         %12.1f MB/s of pages\n",
+         raw_bytes / write_seconds / 1048576);
+  printf("scan                 %12.1f MB/s of pages\n",
+         raw_bytes / scan_seconds / 1048576);
+  return 0;
+}
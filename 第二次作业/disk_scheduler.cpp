@@ -0,0 +1,233 @@
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "buffer/disk_scheduler.h"
+#include "buffer/frame_arena.h"
+#include "common/exception.h"
+
+namespace scudb {
+
+DiskScheduler::DiskScheduler(DiskManager *disk_manager, size_t num_threads)
+    : disk_manager_(disk_manager), page_store_(nullptr), fd_(-1),
+      direct_(false),
+      num_threads_(num_threads), in_flight_(0), stop_(false) {}
+
+DiskScheduler::~DiskScheduler() {
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    stop_ = true;
+  }
+  queue_cv_.notify_all();
+  for (auto &io_thread : io_threads_) {
+    io_thread.join();
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+std::future<void>
+DiskScheduler::ScheduleRead(page_id_t page_id, char *data,
+                            std::function<void()> on_complete) {
+  return Schedule(
+      DiskRequest{false, page_id, data, {}, std::move(on_complete), {}});
+}
+
+std::future<void>
+DiskScheduler::ScheduleWrite(page_id_t page_id, const char *data,
+                             std::function<void()> on_complete) {
+  //写请求只读取data，这里去掉const只是为了和读请求共用一个结构
+  return Schedule(DiskRequest{true, page_id, const_cast<char *>(data), {},
+                              std::move(on_complete), {}});
+}
+
+std::future<void>
+DiskScheduler::ScheduleWriteRun(page_id_t first_page_id,
+                                std::vector<const char *> pages,
+                                std::function<void()> on_complete) {
+  return Schedule(DiskRequest{true, first_page_id, nullptr, std::move(pages),
+                              std::move(on_complete), {}});
+}
+
+//同步读写直接在调用线程上完成，不经过队列
+void DiskScheduler::ReadPage(page_id_t page_id, char *data) {
+  Serve(false, page_id, data);
+}
+
+void DiskScheduler::WritePage(page_id_t page_id, const char *data) {
+  Serve(true, page_id, const_cast<char *>(data));
+}
+
+void DiskScheduler::Drain() {
+  std::unique_lock<std::mutex> lck(latch_);
+  idle_cv_.wait(lck, [&] { return queue_.empty() && in_flight_ == 0; });
+}
+
+void DiskScheduler::SetPageStore(CompressedPageStore *page_store) {
+  std::lock_guard<std::mutex> lck(latch_);
+  page_store_ = page_store;
+}
+
+bool DiskScheduler::OpenPageFile(const std::string &db_file, bool direct_io) {
+  bool direct = direct_io;
+  int fd = open(db_file.c_str(),
+                O_RDWR | O_CREAT | (direct_io ? O_DIRECT : 0), 0644);
+  //文件系统不支持O_DIRECT时退回普通读写
+  if (fd < 0 && direct_io && errno == EINVAL) {
+    direct = false;
+    fd = open(db_file.c_str(), O_RDWR | O_CREAT, 0644);
+  }
+  if (fd < 0) {
+    throw Exception("can't open database file " + db_file);
+  }
+  std::lock_guard<std::mutex> lck(latch_);
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  fd_ = fd;
+  direct_ = direct;
+  return direct == direct_io;
+}
+
+//O_DIRECT要求缓冲区对齐
+static inline bool IsAligned(const char *data) {
+  return reinterpret_cast<uintptr_t>(data) % FRAME_ALIGNMENT == 0;
+}
+
+std::future<void> DiskScheduler::Schedule(DiskRequest request) {
+  std::future<void> done = request.done.get_future();
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    if (io_threads_.empty()) {
+      for (size_t i = 0; i < num_threads_; ++i) {
+        io_threads_.emplace_back(&DiskScheduler::IOThread, this);
+      }
+    }
+    queue_.push_back(std::move(request));
+  }
+  queue_cv_.notify_one();
+  return done;
+}
+
+//启用压缩后页面写进压缩文件，压缩文件里还没有的页从原来的文件读
+void DiskScheduler::Serve(bool is_write, page_id_t page_id, char *data) {
+  CompressedPageStore *page_store;
+  int fd;
+  bool direct;
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    page_store = page_store_;
+    fd = fd_;
+    direct = direct_;
+  }
+  if (page_store != nullptr && !is_write && !page_store->Contains(page_id)) {
+    page_store = nullptr;
+  }
+  off_t offset = static_cast<off_t>(page_id) * PAGE_SIZE;
+  //没有对齐的缓冲区经过栈上对齐的副本读写，缓冲池的帧都是对齐的
+  if (page_store == nullptr && fd >= 0 && direct && !IsAligned(data)) {
+    alignas(FRAME_ALIGNMENT) char buffer[PAGE_SIZE];
+    if (is_write) {
+      memcpy(buffer, data, PAGE_SIZE);
+      pwrite(fd, buffer, PAGE_SIZE, offset);
+    } else {
+      ssize_t size = std::max<ssize_t>(pread(fd, buffer, PAGE_SIZE, offset), 0);
+      memcpy(data, buffer, size);
+      memset(data + size, 0, PAGE_SIZE - size);
+    }
+    return;
+  }
+  if (page_store != nullptr) {
+    if (is_write) {
+      page_store->WritePage(page_id, data);
+    } else {
+      page_store->ReadPage(page_id, data);
+    }
+  } else if (fd >= 0 && is_write) {
+    pwrite(fd, data, PAGE_SIZE, offset);
+  } else if (fd >= 0) {
+    //和DiskManager一样，文件末尾之后的部分读作0
+    ssize_t size = std::max<ssize_t>(pread(fd, data, PAGE_SIZE, offset), 0);
+    memset(data + size, 0, PAGE_SIZE - size);
+  } else if (is_write) {
+    disk_manager_->WritePage(page_id, data);
+  } else {
+    disk_manager_->ReadPage(page_id, data);
+  }
+}
+
+/*
+ * Write a run of contiguous pages with pwritev, IOV_MAX pages per call.
+ * Without the page file, or with O_DIRECT and an unaligned page, every page
+ * is written on its own
+ */
+void DiskScheduler::ServeRun(page_id_t first_page_id,
+                             const std::vector<const char *> &run) {
+  int fd;
+  bool aligned = true;
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    fd = page_store_ == nullptr ? fd_ : -1;
+    if (direct_) {
+      for (const char *page : run) {
+        aligned = aligned && IsAligned(page);
+      }
+    }
+  }
+  if (fd < 0 || !aligned) {
+    for (size_t i = 0; i < run.size(); ++i) {
+      Serve(true, first_page_id + static_cast<page_id_t>(i),
+            const_cast<char *>(run[i]));
+    }
+    return;
+  }
+  std::vector<struct iovec> iov(std::min<size_t>(run.size(), IOV_MAX));
+  for (size_t begin = 0; begin < run.size(); begin += iov.size()) {
+    size_t count = std::min(iov.size(), run.size() - begin);
+    for (size_t i = 0; i < count; ++i) {
+      iov[i].iov_base = const_cast<char *>(run[begin + i]);
+      iov[i].iov_len = PAGE_SIZE;
+    }
+    off_t offset =
+        (static_cast<off_t>(first_page_id) + static_cast<off_t>(begin)) *
+        PAGE_SIZE;
+    pwritev(fd, iov.data(), static_cast<int>(count), offset);
+  }
+}
+
+//I/O线程，停止前先处理完队列中剩余的请求
+void DiskScheduler::IOThread() {
+  std::unique_lock<std::mutex> lck(latch_);
+  for (;;) {
+    queue_cv_.wait(lck, [&] { return stop_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+    DiskRequest request = std::move(queue_.front());
+    queue_.pop_front();
+    ++in_flight_;
+    lck.unlock();
+    if (!request.run.empty()) {
+      ServeRun(request.page_id, request.run);
+    } else {
+      Serve(request.is_write, request.page_id, request.data);
+    }
+    if (request.on_complete) {
+      request.on_complete();
+    }
+    request.done.set_value();
+    lck.lock();
+    if (--in_flight_ == 0 && queue_.empty()) {
+      idle_cv_.notify_all();
+    }
+  }
+}
+} // namespace scudb
@@ -0,0 +1,115 @@
+/*
+ * disk_scheduler.h
+ *
+ * Functionality: asynchronous page reads and writes on top of the
+ * DiskManager. Requests are queued and served by a pool of I/O threads, the
+ * caller gets a completion handle (std::future) to wait on, or a callback run
+ * by the I/O thread once the request is done. Many requests can be in flight
+ * while the threads that issued them keep working. Requests are not ordered
+ * against each other, the buffer pool never has two in flight for one frame.
+ *
+ * A caller that would only wait for its request reads or writes inline
+ * instead (ReadPage/WritePage), on its own thread, so a synchronous miss pays
+ * no queueing or thread handoff. One scheduler can serve several buffer
+ * pools, the instances of a ParallelBufferPoolManager share the one of the
+ * parallel pool.
+ *
+ * Once OpenPageFile is called the pages are read and written with
+ * pread/pwrite on a descriptor of the database file instead of through the
+ * DiskManager, and a run of contiguous pages is written with one pwritev.
+ * The file can be opened with O_DIRECT, the pages then bypass the page cache
+ * and are not cached twice, once in the pool and once by the OS. Buffers
+ * not aligned to FRAME_ALIGNMENT go through an aligned copy.
+ */
+
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer/compressed_page_store.h"
+#include "disk/disk_manager.h"
+
+namespace scudb {
+#define DISK_SCHEDULER_THREAD_NUM 4 // I/O threads of a scheduler
+
+class DiskScheduler {
+public:
+  // the I/O threads are started by the first request
+  DiskScheduler(DiskManager *disk_manager,
+                size_t num_threads = DISK_SCHEDULER_THREAD_NUM);
+
+  // wait for the queued requests and stop the I/O threads
+  ~DiskScheduler();
+
+  DiskScheduler(const DiskScheduler &) = delete;
+  DiskScheduler &operator=(const DiskScheduler &) = delete;
+
+  // read page_id into data, on_complete (if any) runs on the I/O thread
+  // before the returned future becomes ready
+  std::future<void> ScheduleRead(page_id_t page_id, char *data,
+                                 std::function<void()> on_complete = nullptr);
+
+  std::future<void> ScheduleWrite(page_id_t page_id, const char *data,
+                                  std::function<void()> on_complete = nullptr);
+
+  // write pages[i] to page first_page_id + i, as one pwritev when the page
+  // file is open
+  std::future<void> ScheduleWriteRun(page_id_t first_page_id,
+                                     std::vector<const char *> pages,
+                                     std::function<void()> on_complete = nullptr);
+
+  // read or write on the calling thread, for callers that would wait anyway
+  void ReadPage(page_id_t page_id, char *data);
+  void WritePage(page_id_t page_id, const char *data);
+
+  // wait until every queued request has completed, the I/O threads keep
+  // running
+  void Drain();
+
+  // write the pages to page_store instead of the DiskManager, set before the
+  // first request. A page page_store does not contain yet is still read from
+  // the DiskManager (or the page file), so an existing database moves into
+  // page_store one page at a time, as its pages are written
+  void SetPageStore(CompressedPageStore *page_store);
+
+  // serve the requests with a descriptor of db_file, the file of the
+  // DiskManager, call before the first request. With direct_io the file is
+  // opened with O_DIRECT, false is returned if the file system refused it and
+  // buffered I/O is used. Throw an Exception if the file cannot be opened
+  bool OpenPageFile(const std::string &db_file, bool direct_io = false);
+
+private:
+  struct DiskRequest {
+    bool is_write;
+    page_id_t page_id;
+    char *data;
+    std::vector<const char *> run; // pages of a ScheduleWriteRun, data unused
+    std::function<void()> on_complete;
+    std::promise<void> done;
+  };
+
+  std::future<void> Schedule(DiskRequest request);
+  void Serve(bool is_write, page_id_t page_id, char *data);
+  void ServeRun(page_id_t first_page_id, const std::vector<const char *> &run);
+  void IOThread();
+
+  DiskManager *disk_manager_;
+  CompressedPageStore *page_store_; // nullptr unless pages are compressed
+  int fd_; // database file opened by OpenPageFile, -1 to use the DiskManager
+  bool direct_; // fd_ was opened with O_DIRECT
+  size_t num_threads_;
+  std::mutex latch_;                     // protects the fields below
+  std::condition_variable queue_cv_;     // to wake up the I/O threads
+  std::condition_variable idle_cv_;      // the last request completed
+  std::deque<DiskRequest> queue_;
+  size_t in_flight_;                     // requests taken by an I/O thread
+  std::vector<std::thread> io_threads_;
+  bool stop_;
+};
+} // namespace scudb
@@ -1,22 +1,80 @@
 #include <list>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "common/exception.h"
 #include "hash/extendible_hash.h"
 #include "page/page.h"
 using namespace std;
 
 namespace scudb {
 
+// names of the counters of stats_, in the order of StatsCounter
+static const std::vector<std::string> HASH_STATS_COUNTERS = {
+    "finds", "find_hits", "inserts", "removes", "splits",
+    "directory_doublings", "retries", "merges", "directory_halvings"};
+
+namespace {
+// tag of a hash: 7 high bits of the mixed hash, the top bit marks a used slot
+inline uint8_t Tag(size_t hash) {
+  return 0x80 | uint8_t((uint64_t(hash) * 0x9e3779b97f4a7c15ull) >> 57);
+}
+
+// bit i set if group[i] == tag, for the BUCKET_TAG_GROUP tags of group
+inline uint32_t MatchTags(const uint8_t *group, uint8_t tag) {
+#ifdef __SSE2__
+  __m128i tags = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+  return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(tags, _mm_set1_epi8(char(tag)))));
+#else
+  uint32_t matches = 0;
+  for (int i = 0; i < BUCKET_TAG_GROUP; i++) {
+    if (group[i] == tag) matches |= 1u << i;
+  }
+  return matches;
+#endif
+}
+
+//每个线程固定使用一个读者计数分片
+inline size_t ReaderShard() {
+  static std::atomic<size_t> next_shard(0);
+  static thread_local size_t shard =
+      next_shard.fetch_add(1, memory_order_relaxed) % METRICS_SHARDS;
+  return shard;
+}
+} // namespace
+
 /*
  * constructor
  * array_size: fixed array size for each bucket
  */
 template <typename K, typename V>
-ExtendibleHash<K, V>::ExtendibleHash(size_t size) :  globalDepth(0),bucketSize(size),bucketNum(1) {
-  buckets.push_back(make_shared<Bucket>(0));
+ExtendibleHash<K, V>::ExtendibleHash(size_t size) : bucketSize(size),bucketNum(1),
+    readers(new DirectoryReaders[METRICS_SHARDS]), epoch(0),
+    stats_(HASH_STATS_COUNTERS, {}) {
+  for (size_t i = 0; i < METRICS_SHARDS; i++) {
+    readers[i].count[0].store(0);
+    readers[i].count[1].store(0);
+  }
+  Directory *dir = new Directory(0);
+  Bucket *bucket = new Bucket(0, 0, bucketSize);
+  allBuckets.push_back(bucket);
+  dir->buckets[0].store(bucket);
+  directory.store(dir);
 }
 template<typename K, typename V>
-ExtendibleHash<K, V>::ExtendibleHash() {
-  ExtendibleHash(64);
+ExtendibleHash<K, V>::ExtendibleHash() : ExtendibleHash(64) {}
+
+template <typename K, typename V>
+ExtendibleHash<K, V>::~ExtendibleHash() {
+  delete directory.load();
+  for (Directory *dir : retiredDirectories) {
+    delete dir;
+  }
+  for (Bucket *bucket : allBuckets) {
+    delete bucket;
+  }
 }
 
 /*
@@ -37,8 +95,10 @@ size_t ExtendibleHash<K, V>::HashKey(const K &key) const{
 //获取GlobalDepth
 template <typename K, typename V>
 int ExtendibleHash<K, V>::GetGlobalDepth() const{
-  lock_guard<mutex> lock(latch);
-  return globalDepth;
+  atomic<size_t> *reader;
+  int depth = EnterDirectory(reader)->globalDepth;
+  LeaveDirectory(reader);
+  return depth;
 }
 
 /*
@@ -49,13 +109,17 @@ int ExtendibleHash<K, V>::GetGlobalDepth() const{
 //获取localDepth
 template <typename K, typename V>
 int ExtendibleHash<K, V>::GetLocalDepth(int bucket_id) const {
-  //lock_guard<mutex> lck2(latch);
-  if (buckets[bucket_id]) {
-    lock_guard<mutex> lck(buckets[bucket_id]->latch);
-    if (buckets[bucket_id]->kmap.size() == 0) return -1;
-    return buckets[bucket_id]->localDepth;
+  atomic<size_t> *reader;
+  Directory *dir = EnterDirectory(reader);
+  if (bucket_id < 0 || size_t(bucket_id) >= (size_t(1) << dir->globalDepth)) {
+    LeaveDirectory(reader);
+    return -1;
   }
-  return -1;
+  Bucket *bucket = dir->buckets[bucket_id].load(memory_order_acquire);
+  LeaveDirectory(reader);
+  lock_guard<mutex> lck(bucket->latch);
+  if (bucket->size == 0) return -1;
+  return bucket->localDepth;
 }
 
 /*
@@ -69,6 +133,25 @@ int ExtendibleHash<K, V>::GetNumBuckets() const{
   return bucketNum;
 }
 
+//目录与桶占用的字节数，包括还没有释放的退役目录和已合并桶的外壳
+template <typename K, typename V>
+size_t ExtendibleHash<K, V>::GetBytesUsed() const {
+  lock_guard<mutex> lock(latch);
+  size_t bytes = sizeof(*this) + METRICS_SHARDS * sizeof(DirectoryReaders);
+  vector<const Directory *> dirs(retiredDirectories.begin(),
+                                 retiredDirectories.end());
+  dirs.push_back(directory.load(memory_order_relaxed));
+  for (const Directory *dir : dirs) {
+    bytes += sizeof(Directory) +
+             (size_t(1) << dir->globalDepth) * sizeof(atomic<Bucket *>);
+  }
+  size_t slotBytes = (bucketSize + BUCKET_TAG_GROUP - 1) / BUCKET_TAG_GROUP *
+                         BUCKET_TAG_GROUP +
+                     bucketSize * (sizeof(K) + sizeof(V));
+  bytes += allBuckets.size() * sizeof(Bucket) + bucketNum * slotBytes;
+  return bytes;
+}
+
 /*
  * lookup function to find value associate with input key
  */
@@ -76,11 +159,14 @@ int ExtendibleHash<K, V>::GetNumBuckets() const{
 //根据page_id找里面存放的页表
 template <typename K, typename V>
 bool ExtendibleHash<K, V>::Find(const K &key, V &value) {
-
-  int idx = getIdx(key);
-  lock_guard<mutex> lck(buckets[idx]->latch);
-  if (buckets[idx]->kmap.find(key) != buckets[idx]->kmap.end()) {
-    value = buckets[idx]->kmap[key];
+  stats_.Add(STAT_FINDS);
+  size_t hash = HashKey(key);
+  unique_lock<mutex> lck;
+  Bucket *bucket = LockBucket(hash, lck);
+  size_t slot = FindSlot(bucket, key, Tag(hash));
+  if (slot != bucketSize) {
+    value = bucket->values[slot];
+    stats_.Add(STAT_FIND_HITS);
     return true;
 
   }
@@ -91,25 +177,133 @@ bool ExtendibleHash<K, V>::Find(const K &key, V &value) {
 //获取桶的id
 template <typename K, typename V>
 int ExtendibleHash<K, V>::getIdx(const K &key) const{
-  lock_guard<mutex> lck(latch);
-  return HashKey(key) & ((1 << globalDepth) - 1);
+  atomic<size_t> *reader;
+  int depth = EnterDirectory(reader)->globalDepth;
+  LeaveDirectory(reader);
+  return HashKey(key) & ((size_t(1) << depth) - 1);
+}
+
+/*
+ * Count the caller as a reader of the current epoch before loading the
+ * directory pointer. The count only holds if the epoch has not moved on
+ * meanwhile, else ReclaimDirectories may already have checked it and the
+ * caller counts itself again. A directory retired after the load is not
+ * freed while the count is held, one retired before it can no longer be
+ * loaded
+ */
+template <typename K, typename V>
+typename ExtendibleHash<K, V>::Directory *
+ExtendibleHash<K, V>::EnterDirectory(atomic<size_t> *&reader) const {
+  DirectoryReaders &shard = readers[ReaderShard()];
+  for (;;) {
+    size_t cur = epoch.load(memory_order_seq_cst);
+    reader = &shard.count[cur & 1];
+    reader->fetch_add(1, memory_order_seq_cst);
+    if (epoch.load(memory_order_seq_cst) == cur) {
+      break;
+    }
+    reader->fetch_sub(1, memory_order_release);
+  }
+  return directory.load(memory_order_seq_cst);
+}
+
+template <typename K, typename V>
+void ExtendibleHash<K, V>::LeaveDirectory(atomic<size_t> *reader) const {
+  reader->fetch_sub(1, memory_order_release);
+}
+
+/*
+ * Lock the bucket whose keys share the low bits of hash. The directory read
+ * may be stale (a split or a doubling under way), the bucket found is only
+ * trusted once its latch is held and it still covers hash
+ */
+template <typename K, typename V>
+typename ExtendibleHash<K, V>::Bucket *
+ExtendibleHash<K, V>::LockBucket(size_t hash, unique_lock<mutex> &lck) {
+  for (;;) {
+    //桶从不释放，拿到桶指针后就可以离开目录
+    atomic<size_t> *reader;
+    Directory *dir = EnterDirectory(reader);
+    size_t idx = hash & ((size_t(1) << dir->globalDepth) - 1);
+    Bucket *bucket = dir->buckets[idx].load(memory_order_acquire);
+    LeaveDirectory(reader);
+    lck = unique_lock<mutex>(bucket->latch);
+    //桶的localDepth和前缀只在持有桶锁时修改，持锁后仍覆盖该哈希值即为正确的桶
+    //已被合并掉的桶不再覆盖任何哈希值
+    if (bucket->alive &&
+        (hash & ((size_t(1) << bucket->localDepth) - 1)) == bucket->prefix) {
+      return bucket;
+    }
+    lck.unlock();
+    stats_.Add(STAT_RETRIES);
+  }
+}
+
+//先比较标签，标签相同的槽才比较键
+template <typename K, typename V>
+size_t ExtendibleHash<K, V>::FindSlot(const Bucket *bucket, const K &key,
+                                      uint8_t tag) const {
+  for (size_t base = 0; base < bucket->size; base += BUCKET_TAG_GROUP) {
+    //size之后的标签为0，不会与任何标签相同
+    uint32_t matches = MatchTags(bucket->tags.get() + base, tag);
+    for (; matches != 0; matches &= matches - 1) {
+      size_t slot = base + __builtin_ctz(matches);
+      if (bucket->keys[slot] == key) {
+        return slot;
+      }
+    }
+  }
+  return bucketSize;
+}
+
+template <typename K, typename V>
+void ExtendibleHash<K, V>::PutSlot(Bucket *bucket, const K &key,
+                                   const V &value, uint8_t tag) {
+  size_t slot = bucket->size++;
+  bucket->tags[slot] = tag;
+  bucket->keys[slot] = key;
+  bucket->values[slot] = value;
+}
+
+//用最后一项填补空位，保持已用的槽连续
+template <typename K, typename V>
+void ExtendibleHash<K, V>::EraseSlot(Bucket *bucket, size_t slot) {
+  size_t last = --bucket->size;
+  if (slot != last) {
+    bucket->tags[slot] = bucket->tags[last];
+    bucket->keys[slot] = std::move(bucket->keys[last]);
+    bucket->values[slot] = std::move(bucket->values[last]);
+  }
+  bucket->tags[last] = 0;
+  bucket->keys[last] = K();
+  bucket->values[last] = V();
 }
 
 /*
  * delete <key,value> entry in hash table
- * Shrink & Combination is not required for this project
+ * A bucket left at most 1 / BUCKET_MERGE_DIVISOR full tries to merge with
+ * its split image
  */
 
 //删除该数据页表
 template <typename K, typename V>
 bool ExtendibleHash<K, V>::Remove(const K &key) {
-  int idx = getIdx(key);
-  lock_guard<mutex> lck(buckets[idx]->latch);
-  shared_ptr<Bucket> cur = buckets[idx];
-  if (cur->kmap.find(key) == cur->kmap.end()) {
+  stats_.Add(STAT_REMOVES);
+  size_t hash = HashKey(key);
+  unique_lock<mutex> lck;
+  Bucket *cur = LockBucket(hash, lck);
+  size_t slot = FindSlot(cur, key, Tag(hash));
+  if (slot == bucketSize) {
     return false;
   }
-  cur->kmap.erase(key);
+  EraseSlot(cur, slot);
+  //合并的必要条件：本桶不超过合并阈值
+  bool sparse = cur->localDepth > 0 &&
+                cur->size * BUCKET_MERGE_DIVISOR <= bucketSize;
+  lck.unlock();
+  if (sparse) {
+    Merge(hash);
+  }
   return true;
 }
 
@@ -189,48 +383,256 @@ bool ExtendibleHash<K, V>::Remove(const K &key) {
 
 template <typename K, typename V>
 void ExtendibleHash<K, V>::Insert(const K &key, const V &value) {
-  int index=getIdx(key);
-  shared_ptr<Bucket> current_ptr = buckets[index];
-  for(;;index = getIdx(key),current_ptr = buckets[index];){
-    lock_guard<mutex> lck(cur->latch);
-    if(current_ptr->kmap.find(key)){
-      current_ptr->kmap[key]=value;
+  stats_.Add(STAT_INSERTS);
+  size_t hash = HashKey(key);
+  uint8_t tag = Tag(hash);
+  for (;;) {
+    {
+      unique_lock<mutex> lck;
+      Bucket *cur = LockBucket(hash, lck);
+      //已有该键则覆盖，桶未满则直接插入
+      size_t slot = FindSlot(cur, key, tag);
+      if (slot != bucketSize) {
+        cur->values[slot] = value;
+        return;
+      }
+      if (cur->size < bucketSize) {
+        PutSlot(cur, key, value, tag);
+        return;
+      }
+    }
+    //桶已满，分裂后重试，键全落在同一半时需要再次分裂
+    if (!Split(hash)) {
+      throw Exception("can't insert a key: more than " +
+                      std::to_string(bucketSize) + " keys share its hash");
+    }
+  }
+}
+
+/*
+ * Split the bucket covering hash if it is still full. Its keys with the next
+ * hash bit set move to a new bucket (its split image). When the bucket
+ * already uses every bit of the directory, a directory twice as large is
+ * filled and published first; readers of the old one are sent to the new one
+ * by LockBucket. Returns false, changing nothing, when the keys of the bucket
+ * and hash agree on every bit above localDepth: no split would ever move one
+ * of them, Insert would split forever
+ */
+template <typename K, typename V>
+bool ExtendibleHash<K, V>::Split(size_t hash) {
+  lock_guard<mutex> lck(latch);
+  unique_lock<mutex> bucket_lck;
+  Bucket *cur = LockBucket(hash, bucket_lck);
+  //等待表锁期间可能已被其他线程分裂或删除了键
+  if (cur->size < bucketSize) {
+    return true;
+  }
+  //所有哈希值与hash不同的位，localDepth以上没有不同的位时分裂无用
+  //localDepth已用到最高位时也无法再分裂（掩码会溢出）
+  size_t differ = 0;
+  for (size_t slot = 0; slot < cur->size; slot++) {
+    differ |= HashKey(cur->keys[slot]) ^ hash;
+  }
+  if (cur->localDepth == int(sizeof(size_t) * 8 - 1) ||
+      (differ >> cur->localDepth) == 0) {
+    return false;
+  }
+  stats_.Add(STAT_SPLITS);
+  Directory *dir = directory.load(memory_order_relaxed);
+  if (cur->localDepth == dir->globalDepth) {
+    //目录翻倍：在新目录中复制一份旧的指针后整体发布
+    size_t length = size_t(1) << dir->globalDepth;
+    Directory *grown = new Directory(dir->globalDepth + 1);
+    for (size_t i = 0; i < length; i++) {
+      Bucket *bucket = dir->buckets[i].load(memory_order_relaxed);
+      grown->buckets[i].store(bucket, memory_order_relaxed);
+      grown->buckets[i + length].store(bucket, memory_order_relaxed);
+    }
+    PublishDirectory(grown);
+    dir = grown;
+    stats_.Add(STAT_DIRECTORY_DOUBLINGS);
+  }
+  //新桶接收下一位为1的键，在发布到目录前填好，槽在两个数组间直接搬移
+  size_t bit = size_t(1) << cur->localDepth;
+  unique_lock<mutex> image_lck;
+  Bucket *image = TakeBucket(cur->localDepth + 1, cur->prefix | bit, image_lck);
+  for (size_t slot = 0; slot < cur->size; ) {
+    if (HashKey(cur->keys[slot]) & bit) {
+      PutSlot(image, cur->keys[slot], cur->values[slot], cur->tags[slot]);
+      EraseSlot(cur, slot);
+    } else slot++;
+  }
+  cur->localDepth++;
+  bucketNum++;
+  //目录中低localDepth位等于新桶前缀的槽都指向新桶
+  size_t length = size_t(1) << dir->globalDepth;
+  for (size_t i = image->prefix; i < length; i += bit << 1) {
+    dir->buckets[i].store(image, memory_order_release);
+  }
+  ReclaimDirectories();
+  return true;
+}
+
+
+/*
+ * Merge the bucket covering hash with its split image (the bucket differing
+ * in the last bit of their local depth) while both have that local depth and
+ * their entries fit in 1 / BUCKET_MERGE_DIVISOR of a bucket. The bucket with
+ * the bit clear keeps the entries, the other one is marked dead. Then halve
+ * the directory while every bucket is referenced twice. Skipped if another
+ * split or merge holds the table latch, the next Remove will try again
+ */
+template <typename K, typename V>
+void ExtendibleHash<K, V>::Merge(size_t hash) {
+  unique_lock<mutex> lck(latch, try_to_lock);
+  if (!lck.owns_lock()) {
+    return;
+  }
+  Directory *dir = directory.load(memory_order_relaxed);
+  for (;;) {
+    //目录、前缀和localDepth只在持有表锁时修改，此时可以直接从目录找桶
+    size_t idx = hash & ((size_t(1) << dir->globalDepth) - 1);
+    Bucket *cur = dir->buckets[idx].load(memory_order_relaxed);
+    if (cur->localDepth == 0) {
       break;
-    }else if(current_ptr->kmap.size()<bucketSize){
-      current_ptr->kmap.insert({key,value});
+    }
+    size_t bit = size_t(1) << (cur->localDepth - 1);
+    Bucket *image = dir->buckets[idx ^ bit].load(memory_order_relaxed);
+    if (image->localDepth != cur->localDepth) {
       break;
     }
-    lock_guard<mutex> lck2(latch);
-    current_ptr->localDepth++;
-    bucketNum++;
-    //local大于于global
-    if(current_ptr->localDepth>globalDepth){
-        //全部复制一份，globalDepth+1
-        for (size_t i = 0; i <  buckets.size(); i++) {
-          buckets.push_back(buckets[i]);
-        }
-      globalDepth++;
+    //和Split一样先锁前缀较小的桶
+    Bucket *low = (idx & bit) ? image : cur;
+    Bucket *high = (idx & bit) ? cur : image;
+    unique_lock<mutex> low_lck(low->latch);
+    unique_lock<mutex> high_lck(high->latch);
+    if ((low->size + high->size) * BUCKET_MERGE_DIVISOR > bucketSize) {
+      break;
     }
-    shared_ptr<Bucket> new_bucket = make_shared<Bucket>(current_ptr->localDepth);
-    for(size_t i = 0; i <  buckets.size(); i++){
-      if (buckets[i] == current_ptr && (i & (1 << (current_ptr->localDepth)))
-          buckets[i] = new_bucket;
+    stats_.Add(STAT_MERGES);
+    while (high->size > 0) {
+      size_t last = high->size - 1;
+      PutSlot(low, high->keys[last], high->values[last], high->tags[last]);
+      EraseSlot(high, last);
     }
-    for(auto it = current_ptr->kmap.begin(); it != current_ptr->kmap.end(); ){
-      //local前一位为1则为新桶
-      if(HashKey(it->first)&(1 << (current_ptr->localDepth))){
-        new_bucket->kmap.insert({it->first,it->second});
-        it = cur->kmap.erase(it);
-      }else it++;
+    low->localDepth--;
+    //指向被合并桶的槽改指向保留的桶，还拿着旧指针的读者持锁后看到桶已失效会重试
+    size_t length = size_t(1) << dir->globalDepth;
+    for (size_t i = high->prefix; i < length; i += bit << 1) {
+      dir->buckets[i].store(low, memory_order_release);
     }
+    high->alive = false;
+    high->tags.reset();
+    high->keys.reset();
+    high->values.reset();
+    freeBuckets.push_back(high);
+    bucketNum--;
   }
+  //没有桶用到目录的最高位时（前后两半完全相同）目录减半
+  while (dir->globalDepth > 0) {
+    size_t half = size_t(1) << (dir->globalDepth - 1);
+    size_t i = 0;
+    while (i < half && dir->buckets[i].load(memory_order_relaxed) ==
+                           dir->buckets[i + half].load(memory_order_relaxed)) {
+      i++;
+    }
+    if (i < half) {
+      break;
+    }
+    Directory *shrunk = new Directory(dir->globalDepth - 1);
+    for (i = 0; i < half; i++) {
+      shrunk->buckets[i].store(dir->buckets[i].load(memory_order_relaxed),
+                               memory_order_relaxed);
+    }
+    PublishDirectory(shrunk);
+    dir = shrunk;
+    stats_.Add(STAT_DIRECTORY_HALVINGS);
+  }
+  ReclaimDirectories();
+}
 
+//被替换的目录可能还有读者，先记下当前纪元后退役，等读者离开后再释放。调用时持有表锁
+template <typename K, typename V>
+void ExtendibleHash<K, V>::PublishDirectory(Directory *dir) {
+  Directory *old = directory.load(memory_order_relaxed);
+  old->retiredEpoch = epoch.load(memory_order_relaxed);
+  retiredDirectories.push_back(old);
+  directory.store(dir, memory_order_seq_cst);
+}
 
+/*
+ * Readers are only ever counted in the current epoch or the previous one:
+ * the epoch moves on once every shard is seen empty for the previous one
+ * (the parity the next epoch reuses). A directory retired in epoch e may be
+ * held by readers of e or earlier, readers entering e + 1 or later came
+ * after it was replaced. So once the epoch reaches e + 2 it can go. Lookups
+ * never wait for this, a reader still in an old epoch only delays the
+ * directories retired up to it. Called with the table latch held
+ */
+template <typename K, typename V>
+void ExtendibleHash<K, V>::ReclaimDirectories() {
+  if (retiredDirectories.empty()) {
+    return;
+  }
+  //最多推进两个纪元，第一次推进后刚退役的目录还要等当前纪元的读者离开
+  for (int step = 0; step < 2; step++) {
+    size_t cur = epoch.load(memory_order_relaxed);
+    size_t i = 0;
+    while (i < METRICS_SHARDS &&
+           readers[i].count[(cur + 1) & 1].load(memory_order_seq_cst) == 0) {
+      i++;
+    }
+    if (i < METRICS_SHARDS) {
+      break;
+    }
+    epoch.store(cur + 1, memory_order_seq_cst);
+  }
+  size_t cur = epoch.load(memory_order_relaxed);
+  size_t kept = 0;
+  for (Directory *dir : retiredDirectories) {
+    if (dir->retiredEpoch + 2 <= cur) {
+      delete dir;
+    } else {
+      retiredDirectories[kept++] = dir;
+    }
+  }
+  retiredDirectories.resize(kept);
+}
 
-  
+/*
+ * A merged away bucket may still be locked by a lookup holding an old
+ * pointer, so it is reused rather than freed. It is set up under its latch,
+ * which stays held until the split has filled it. Called with the table
+ * latch held
+ */
+template <typename K, typename V>
+typename ExtendibleHash<K, V>::Bucket *
+ExtendibleHash<K, V>::TakeBucket(int depth, size_t prefix,
+                                 unique_lock<mutex> &lck) {
+  if (freeBuckets.empty()) {
+    Bucket *bucket = new Bucket(depth, prefix, bucketSize);
+    allBuckets.push_back(bucket);
+    lck = unique_lock<mutex>(bucket->latch);
+    return bucket;
+  }
+  Bucket *bucket = freeBuckets.back();
+  freeBuckets.pop_back();
+  lck = unique_lock<mutex>(bucket->latch);
+  bucket->localDepth = depth;
+  bucket->prefix = prefix;
+  bucket->Allocate(bucketSize);
+  bucket->alive = true;
+  return bucket;
 }
 
 
+template <typename K, typename V>
+std::string ExtendibleHash<K, V>::DumpStats(const std::string &prefix) {
+  return prefix + ".global_depth " + std::to_string(GetGlobalDepth()) + "\n" +
+         prefix + ".num_buckets " + std::to_string(GetNumBuckets()) + "\n" +
+         prefix + ".bytes_used " + std::to_string(GetBytesUsed()) + "\n" +
+         stats_.Dump(prefix);
+}
 
 template class ExtendibleHash<page_id_t, Page *>;
 template class ExtendibleHash<Page *, std::list<Page *>::iterator>;
@@ -5,42 +5,110 @@
  * Functionality: The buffer pool manager must maintain a page table to be able
  * to quickly map a PageId to its corresponding memory location; or alternately
  * report that the PageId does not match any currently-buffered page.
+ *
+ * Concurrency: lookups take no table-wide lock. The directory is read through
+ * an atomic pointer and only the latch of the bucket found is taken. A bucket
+ * knows the low bits of the hashes it holds (prefix, localDepth), so a reader
+ * that raced with a split sees under the bucket latch that the key is no
+ * longer covered and retries. Splits are serialized by the table latch, a
+ * doubling builds the larger directory aside and publishes it with one store.
+ * A lookup counts itself in a shard of readers, under the parity of the
+ * epoch it entered in, while it reads a directory. A directory replaced by
+ * a doubling or a halving is retired with the current epoch. A split or
+ * merge moves the epoch on once no reader is left in the previous one and
+ * frees the directories retired two epochs back, so a steady stream of
+ * lookups does not keep them alive.
+ *
+ * Buckets: a bucket is a flat array of bucketSize slots, filled from the
+ * front. Each used slot has a one byte tag taken from the high bits of a
+ * mixed hash, a probe compares BUCKET_TAG_GROUP tags at once (SSE2 when the
+ * target has it) and only looks at the keys whose tag matches.
+ *
+ * Shrinking: after a Remove, a bucket merges with its split image once both
+ * fit in 1 / BUCKET_MERGE_DIVISOR of a bucket (a quarter, so the merged
+ * bucket takes many inserts before it splits again), and the directory is
+ * halved while no bucket uses its last bit. A merged away bucket frees its
+ * slots but its latch stays, a lookup may still lock it: it is marked dead
+ * and reused by the next split. The halved directories are retired like the
+ * doubled ones.
+ *
+ * Collisions: more than bucketSize keys sharing every bit of their hash can
+ * not be spread by any split, Insert throws an Exception for such a key
+ * instead of splitting the directory without end.
  */
 
 #pragma once
 
+#include <atomic>
 #include <cstdlib>
 #include <vector>
 #include <string>
-#include <map>
 #include <memory>
 #include <mutex>
 
+#include "buffer/metrics.h"
 #include "hash/hash_table.h"
 using namespace std;
 
 
 namespace scudb {
+#define BUCKET_TAG_GROUP 16 // tags compared by one probe step
+#define BUCKET_MERGE_DIVISOR 4 // merge a pair fitting in 1/4 of a bucket
 
 
 template <typename K, typename V>
 class ExtendibleHash : public HashTable<K, V> {
   struct Bucket {
-    Bucket(int depth) : localDepth(depth) {};
+    Bucket(int depth, size_t bucketPrefix, size_t capacity)
+        : localDepth(depth), prefix(bucketPrefix), size(0), alive(true) {
+      Allocate(capacity);
+    };
+    void Allocate(size_t capacity) {
+      tags.reset(new uint8_t[(capacity + BUCKET_TAG_GROUP - 1) /
+                             BUCKET_TAG_GROUP * BUCKET_TAG_GROUP]());
+      keys.reset(new K[capacity]);
+      values.reset(new V[capacity]);
+    }
     int localDepth;
-    map<K, V> kmap;
+    size_t prefix; // low localDepth bits shared by the hashes of its keys
+    size_t size;   // slots in use, always the first ones
+    bool alive;    // false once merged away, then it has no slots
+    unique_ptr<uint8_t[]> tags; // whole groups, 0 past size
+    unique_ptr<K[]> keys;
+    unique_ptr<V[]> values;
     mutex latch;
   };
+  // 1 << globalDepth slots, never resized: a doubling or a halving
+  // publishes the directory of the other depth
+  struct Directory {
+    Directory(int depth)
+        : globalDepth(depth), buckets(new atomic<Bucket *>[size_t(1) << depth]),
+          retiredEpoch(0) {};
+    int globalDepth;
+    unique_ptr<atomic<Bucket *>[]> buckets;
+    size_t retiredEpoch; // epoch it was replaced in, set when retired
+  };
+  // threads reading a directory without the table latch, METRICS_SHARDS
+  // shards so lookups of different threads do not share a counter
+  struct alignas(64) DirectoryReaders {
+    atomic<size_t> count[2]; // by parity of the epoch entered in
+  };
 public:
   // constructor
   ExtendibleHash(size_t size);
   ExtendibleHash();
+  ~ExtendibleHash();
+  ExtendibleHash(const ExtendibleHash &) = delete;
+  ExtendibleHash &operator=(const ExtendibleHash &) = delete;
   // helper function to generate hash addressing
   size_t HashKey(const K &key) const;
   // helper function to get global & local depth
   int GetGlobalDepth() const;
   int GetLocalDepth(int bucket_id) const;
   int GetNumBuckets() const;
+  // bytes of the directories and the buckets held by the table, the
+  // allocations owned by the keys and values themselves are not counted
+  size_t GetBytesUsed() const;
   // lookup and modifier
   bool Find(const K &key, V &value) override;
   bool Remove(const K &key) override;
@@ -48,12 +116,57 @@ public:
 
   int getIdx(const K &key) const;
 
+  // text dump of the table counters and depth, see Metrics
+  std::string DumpStats(const std::string &prefix);
+
 private:
+  // lock and return the bucket covering hash
+  Bucket *LockBucket(size_t hash, unique_lock<mutex> &lck);
+  // slot of key in the bucket, bucketSize if absent
+  size_t FindSlot(const Bucket *bucket, const K &key, uint8_t tag) const;
+  // append an entry / remove a slot by moving the last entry into it
+  void PutSlot(Bucket *bucket, const K &key, const V &value, uint8_t tag);
+  void EraseSlot(Bucket *bucket, size_t slot);
+  // split the full bucket covering hash, doubling the directory if needed.
+  // false if no split can separate its keys from hash (they share all bits)
+  bool Split(size_t hash);
+  // merge the bucket covering hash with its split image while they fit in
+  // 1 / BUCKET_MERGE_DIVISOR of a bucket, then halve the directory as far
+  // as it can go
+  void Merge(size_t hash);
+  // the published directory, the caller stays counted in reader until
+  // LeaveDirectory
+  Directory *EnterDirectory(atomic<size_t> *&reader) const;
+  void LeaveDirectory(atomic<size_t> *reader) const;
+  // publish a new directory and retire the current one
+  void PublishDirectory(Directory *dir);
+  // move the epoch on as far as the readers allow and free the retired
+  // directories no reader can still hold
+  void ReclaimDirectories();
+  // bucket for a split, a merged away one if any, returned locked
+  Bucket *TakeBucket(int depth, size_t prefix, unique_lock<mutex> &lck);
+
   // add your own member variables here
-  int globalDepth;
   size_t bucketSize;
   int bucketNum;
-  vector<shared_ptr<Bucket>> buckets;
-  mutable mutex latch;
+  atomic<Directory *> directory; // the published directory
+  vector<Directory *> retiredDirectories; // replaced, not freed yet
+  unique_ptr<DirectoryReaders[]> readers; // METRICS_SHARDS shards
+  atomic<size_t> epoch; // only moved on under the table latch
+  vector<Bucket *> allBuckets;     // owned, freed by the destructor
+  vector<Bucket *> freeBuckets;    // merged away, reused by splits
+  mutable mutex latch; // serializes splits and merges, not taken by lookups
+  enum StatsCounter {
+    STAT_FINDS,
+    STAT_FIND_HITS,
+    STAT_INSERTS,
+    STAT_REMOVES,
+    STAT_SPLITS,
+    STAT_DIRECTORY_DOUBLINGS,
+    STAT_RETRIES, // lookups that raced with a split and read the directory again
+    STAT_MERGES,
+    STAT_DIRECTORY_HALVINGS
+  };
+  Metrics stats_;
 };
 } // namespace cmudb
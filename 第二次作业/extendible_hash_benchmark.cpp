@@ -0,0 +1,92 @@
+/**
+ * extendible_hash_benchmark.cpp
+ *
+ * Contention benchmark of ExtendibleHash from 1 to 32 threads. Each thread
+ * count runs on a fresh table preloaded with keys, twice:
+ *   find  - only Find of preloaded keys, lock-free on the directory
+ *   mixed - 80% Find, 10% Insert of new keys (splits and directory doubling
+ *           happen while the other threads read), 10% Remove of keys the
+ *           thread inserted
+ *
+ * usage: extendible_hash_benchmark [keys] [seconds]
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "hash/extendible_hash.h"
+
+using namespace scudb;
+
+namespace {
+
+const size_t THREAD_COUNTS[] = {1, 2, 4, 8, 16, 32};
+
+//返回每秒完成的操作数，mixed为false时只做Find
+double RunThreads(ExtendibleHash<int, int> *table, int keys,
+                  size_t num_threads, double seconds, bool mixed) {
+  std::atomic<bool> stop(false);
+  std::atomic<size_t> total(0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937_64 rng(t + 1);
+      std::uniform_int_distribution<int> pick(0, keys - 1);
+      std::uniform_int_distribution<int> percent(0, 99);
+      //每个线程插入自己的新键，删除时从最早插入的开始
+      int next_key = keys + static_cast<int>(t);
+      int oldest_key = next_key;
+      size_t ops = 0;
+      int value;
+      while (!stop.load(std::memory_order_relaxed)) {
+        int op = mixed ? percent(rng) : 0;
+        if (op < 80) {
+          table->Find(pick(rng), value);
+        } else if (op < 90) {
+          table->Insert(next_key, next_key);
+          next_key += static_cast<int>(num_threads);
+        } else if (oldest_key < next_key) {
+          table->Remove(oldest_key);
+          oldest_key += static_cast<int>(num_threads);
+        }
+        ops++;
+      }
+      total += ops;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return total.load() / seconds;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int keys = argc > 1 ? atoi(argv[1]) : 100000;
+  double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+  if (keys <= 0) {
+    fprintf(stderr, "keys must be positive\n");
+    return 1;
+  }
+
+  printf("%d preloaded keys, %.1f s per run\n", keys, seconds);
+  printf("%8s %14s %14s %14s\n", "threads", "find ops/s", "mixed ops/s",
+         "global depth");
+  for (size_t num_threads : THREAD_COUNTS) {
+    ExtendibleHash<int, int> table(64);
+    for (int key = 0; key < keys; ++key) {
+      table.Insert(key, key);
+    }
+    double find = RunThreads(&table, keys, num_threads, seconds, false);
+    double mixed = RunThreads(&table, keys, num_threads, seconds, true);
+    printf("%8zu %14.0f %14.0f %14d\n", num_threads, find, mixed,
+           table.GetGlobalDepth());
+  }
+  return 0;
+}
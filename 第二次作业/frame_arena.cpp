@@ -0,0 +1,91 @@
+/**
+ * frame_arena.cpp
+ */
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <new>
+
+#include "buffer/frame_arena.h"
+
+namespace scudb {
+
+static inline size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+/*
+ * Explicit huge pages are taken from the hugetlb pool and fail when it has
+ * not been reserved (vm.nr_hugepages), transparent huge pages only need the
+ * arena aligned to HUGE_PAGE_SIZE so the kernel can back it with huge pages
+ */
+FrameArena::FrameArena(size_t size, HugePageMode huge_pages)
+    : data_(nullptr), size_(0), page_size_(sysconf(_SC_PAGESIZE)),
+      huge_pages_(huge_pages) {
+  //空的缓冲池不映射任何内存
+  if (size == 0) {
+    huge_pages_ = HugePageMode::NONE;
+    return;
+  }
+  if (huge_pages_ == HugePageMode::EXPLICIT) {
+    //不加MAP_NORESERVE，大页池不够时映射直接失败，而不是在访问时SIGBUS
+    if (Map(AlignUp(size, HUGE_PAGE_SIZE), MAP_HUGETLB)) {
+      page_size_ = HUGE_PAGE_SIZE;
+      return;
+    }
+    huge_pages_ = HugePageMode::TRANSPARENT;
+  }
+  if (huge_pages_ == HugePageMode::TRANSPARENT) {
+    //多映射一个大页的长度，裁掉首尾使起始地址按大页对齐
+    size_t aligned_size = AlignUp(size, HUGE_PAGE_SIZE);
+    if (Map(aligned_size + HUGE_PAGE_SIZE, MAP_NORESERVE)) {
+      uintptr_t start = reinterpret_cast<uintptr_t>(data_);
+      uintptr_t aligned = AlignUp(start, HUGE_PAGE_SIZE);
+      if (aligned > start) {
+        munmap(data_, aligned - start);
+      }
+      if (aligned + aligned_size < start + size_) {
+        munmap(reinterpret_cast<void *>(aligned + aligned_size),
+               start + size_ - aligned - aligned_size);
+      }
+      data_ = reinterpret_cast<char *>(aligned);
+      size_ = aligned_size;
+      if (madvise(data_, size_, MADV_HUGEPAGE) == 0) {
+        return;
+      }
+    }
+    huge_pages_ = HugePageMode::NONE;
+  }
+  if (data_ == nullptr && !Map(AlignUp(size, page_size_), MAP_NORESERVE)) {
+    throw std::bad_alloc();
+  }
+}
+
+FrameArena::~FrameArena() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+}
+
+//物理内存在真正访问时才分配
+bool FrameArena::Map(size_t size, int flags) {
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  data_ = static_cast<char *>(data);
+  size_ = size;
+  return true;
+}
+
+void FrameArena::Release(void *begin, void *end) {
+  //与仍在使用的内存共享的页保留
+  uintptr_t first = AlignUp(reinterpret_cast<uintptr_t>(begin), page_size_);
+  uintptr_t last = reinterpret_cast<uintptr_t>(end) / page_size_ * page_size_;
+  if (first < last) {
+    madvise(reinterpret_cast<void *>(first), last - first, MADV_DONTNEED);
+  }
+}
+} // namespace scudb
@@ -0,0 +1,80 @@
+/*
+ * frame_arena.h
+ *
+ * Functionality: one contiguous, page aligned block of memory holding the
+ * frames of a buffer pool. The address space is reserved up front and only
+ * backed by memory when touched, it can be placed on transparent huge pages
+ * (madvise) or on explicit huge pages from the hugetlb pool, falling back to
+ * normal pages when the kernel cannot provide them.
+ *
+ * The frames are Page objects, whose data_ is their first member. They are
+ * laid out FRAME_STRIDE bytes apart, sizeof(Page) rounded up to
+ * FRAME_ALIGNMENT, so the data of every frame is aligned for O_DIRECT and
+ * not only the first one. Page comes from page/page.h with its metadata
+ * right after data_, the two cannot be kept in separate arrays without
+ * changing that class; the padding costs FRAME_STRIDE - sizeof(Page) bytes
+ * per frame instead.
+ */
+
+#pragma once
+#include <cstddef>
+
+#include "page/page.h"
+
+namespace scudb {
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024) // default x86-64 huge page size
+// logical block size of the devices, O_DIRECT buffers must be aligned to it
+#define FRAME_ALIGNMENT 512
+#define FRAME_STRIDE                                                           \
+  ((sizeof(Page) + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT * FRAME_ALIGNMENT)
+
+// index of a frame from the first frame of its pool and back, used by the
+// replacers. The templates cover the other values replacers are tested with
+template <typename T> inline size_t FrameOffset(const T &value, const T &first) {
+  return static_cast<size_t>(value - first);
+}
+template <typename T> inline T FrameAt(const T &first, size_t index) {
+  return first + index;
+}
+inline size_t FrameOffset(Page *const &value, Page *const &first) {
+  return static_cast<size_t>(reinterpret_cast<char *>(value) -
+                             reinterpret_cast<char *>(first)) /
+         FRAME_STRIDE;
+}
+inline Page *FrameAt(Page *const &first, size_t index) {
+  return reinterpret_cast<Page *>(reinterpret_cast<char *>(first) +
+                                  index * FRAME_STRIDE);
+}
+
+enum class HugePageMode { NONE, TRANSPARENT, EXPLICIT };
+
+class FrameArena {
+public:
+  // reserve at least size bytes, throw std::bad_alloc if even normal pages
+  // cannot be mapped. An arena of 0 bytes maps nothing, GetData is nullptr
+  FrameArena(size_t size, HugePageMode huge_pages = HugePageMode::NONE);
+
+  ~FrameArena();
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  inline void *GetData() { return data_; }
+  inline size_t GetSize() { return size_; }
+
+  // the mode actually used, lower than the requested one after a fallback
+  inline HugePageMode GetHugePageMode() { return huge_pages_; }
+
+  // give the memory of [begin, end) back to the OS, only the pages lying
+  // entirely inside the range. The range reads as zeros when touched again
+  void Release(void *begin, void *end);
+
+private:
+  bool Map(size_t size, int flags);
+
+  char *data_;        // start of the arena, aligned to page_size_
+  size_t size_;       // bytes usable from data_
+  size_t page_size_;  // granularity of Release
+  HugePageMode huge_pages_;
+};
+} // namespace scudb
@@ -0,0 +1,260 @@
+/**
+ * frame_arena_benchmark.cpp
+ *
+ * Three measurements for the frame arena and the O_DIRECT files.
+ *   - Random touches of the frames of an arena on normal, transparent and
+ *     explicit huge pages (the mode the kernel granted is printed), the
+ *     steady-state cost of TLB misses over a large pool.
+ *   - Pages spilled to and read back from a VictimCache, which uses O_DIRECT,
+ *     against the same pages written with buffered pwrite/pread. The page
+ *     cache held by each file afterwards (mincore) is the memory the buffered
+ *     copy costs on top of the pool.
+ *   - Random fetches of a buffer pool holding 1/8 of the database file, a
+ *     quarter of them dirtying the page, with the file read and written
+ *     through the DiskManager, a buffered descriptor and an O_DIRECT one
+ *     (BufferPoolManager::OpenDatabaseFile). Again the page cache held by
+ *     the database file afterwards is printed.
+ *
+ * usage: frame_arena_benchmark [frames] [spill directory]
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/frame_arena.h"
+#include "buffer/victim_cache.h"
+
+using namespace scudb;
+
+namespace {
+
+const char *ModeName(HugePageMode mode) {
+  switch (mode) {
+  case HugePageMode::TRANSPARENT:
+    return "transparent";
+  case HugePageMode::EXPLICIT:
+    return "explicit";
+  default:
+    return "none";
+  }
+}
+
+//帧数据在第一个成员，按FRAME_STRIDE步长找到每一帧的数据
+inline char *FrameData(FrameArena &arena, size_t frame) {
+  return static_cast<char *>(arena.GetData()) + frame * FRAME_STRIDE;
+}
+
+//随机读写帧中的一个字，返回每秒访问次数
+double TouchFrames(HugePageMode mode, size_t frames, size_t touches,
+                   HugePageMode &granted) {
+  FrameArena arena(frames * FRAME_STRIDE, mode);
+  granted = arena.GetHugePageMode();
+  for (size_t frame = 0; frame < frames; ++frame) {
+    memset(FrameData(arena, frame), 0, PAGE_SIZE);
+  }
+  std::mt19937_64 rng(7);
+  std::uniform_int_distribution<size_t> pick_frame(0, frames - 1);
+  std::uniform_int_distribution<size_t> pick_word(0, PAGE_SIZE / 8 - 1);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < touches; ++i) {
+    uint64_t *word = reinterpret_cast<uint64_t *>(
+                         FrameData(arena, pick_frame(rng))) +
+                     pick_word(rng);
+    *word += i;
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return touches / elapsed.count();
+}
+
+//文件当前在页缓存中的字节数
+size_t CachedBytes(const std::string &file_name, size_t size) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  size_t cached = 0;
+  void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (map != MAP_FAILED) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    std::vector<unsigned char> resident((size + page_size - 1) / page_size);
+    if (mincore(map, size, resident.data()) == 0) {
+      for (unsigned char page : resident) {
+        cached += (page & 1) * page_size;
+      }
+    }
+    munmap(map, size);
+  }
+  close(fd);
+  return cached;
+}
+
+struct SpillResult {
+  double mb_per_second;
+  size_t cached_bytes;
+};
+
+SpillResult SpillDirect(const std::string &file_name, FrameArena &arena,
+                        size_t frames) {
+  VictimCache cache(file_name, frames);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t frame = 0; frame < frames; ++frame) {
+    cache.Put(static_cast<page_id_t>(frame), FrameData(arena, frame));
+  }
+  //读回前先统计页缓存，Get会释放槽位
+  size_t cached = CachedBytes(file_name, frames * PAGE_SIZE);
+  for (size_t frame = 0; frame < frames; ++frame) {
+    cache.Get(static_cast<page_id_t>(frame), FrameData(arena, frame));
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return SpillResult{2.0 * frames * PAGE_SIZE / elapsed.count() / (1 << 20),
+                     cached};
+}
+
+SpillResult SpillBuffered(const std::string &file_name, FrameArena &arena,
+                          size_t frames) {
+  int fd = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return SpillResult{0, 0};
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (size_t frame = 0; frame < frames; ++frame) {
+    if (pwrite(fd, FrameData(arena, frame), PAGE_SIZE,
+               static_cast<off_t>(frame) * PAGE_SIZE) != PAGE_SIZE) {
+      break;
+    }
+  }
+  size_t cached = CachedBytes(file_name, frames * PAGE_SIZE);
+  for (size_t frame = 0; frame < frames; ++frame) {
+    if (pread(fd, FrameData(arena, frame), PAGE_SIZE,
+              static_cast<off_t>(frame) * PAGE_SIZE) != PAGE_SIZE) {
+      break;
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  close(fd);
+  unlink(file_name.c_str());
+  return SpillResult{2.0 * frames * PAGE_SIZE / elapsed.count() / (1 << 20),
+                     cached};
+}
+
+enum class PageFileMode { DISK_MANAGER, BUFFERED, DIRECT };
+
+struct PoolResult {
+  double fetches_per_second;
+  size_t cached_bytes;
+  bool granted; // the file system accepted O_DIRECT
+};
+
+//缓冲池只装得下数据库文件的1/8，随机读取几乎都缺页，每4次读取写脏一页
+PoolResult RunPool(const std::string &file_name, PageFileMode mode,
+                   size_t num_pages) {
+  PoolResult result{0, 0, true};
+  remove(file_name.c_str());
+  {
+    DiskManager disk_manager(file_name);
+    BufferPoolManager bpm(std::max<size_t>(num_pages / 8, 1), &disk_manager);
+    if (mode != PageFileMode::DISK_MANAGER) {
+      result.granted =
+          bpm.OpenDatabaseFile(file_name, mode == PageFileMode::DIRECT);
+    }
+    std::vector<page_id_t> pages;
+    for (size_t i = 0; i < num_pages; ++i) {
+      page_id_t page_id;
+      Page *page = bpm.NewPage(page_id);
+      if (page == nullptr) {
+        break;
+      }
+      memset(page->GetData(), static_cast<int>(i), PAGE_SIZE);
+      pages.push_back(page_id);
+      bpm.UnpinPage(page_id, true);
+    }
+    bpm.FlushAllPages();
+    //从冷的页缓存开始
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd >= 0) {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      close(fd);
+    }
+    std::mt19937_64 rng(7);
+    std::uniform_int_distribution<size_t> pick(0, pages.size() - 1);
+    size_t fetches = pages.size() * 4;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < fetches; ++i) {
+      page_id_t page_id = pages[pick(rng)];
+      if (bpm.FetchPage(page_id) != nullptr) {
+        bpm.UnpinPage(page_id, i % 4 == 0);
+      }
+    }
+    bpm.FlushAllPages();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    result.fetches_per_second = fetches / elapsed.count();
+    result.cached_bytes = CachedBytes(file_name, pages.size() * PAGE_SIZE);
+  }
+  remove(file_name.c_str());
+  std::string log_name = file_name.substr(0, file_name.rfind('.')) + ".log";
+  remove(log_name.c_str());
+  return result;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 65536;
+  std::string directory = argc > 2 ? argv[2] : ".";
+  if (frames == 0) {
+    fprintf(stderr, "frames must be positive\n");
+    return 1;
+  }
+
+  printf("%zu frames of %zu bytes (sizeof(Page) %zu)\n", frames,
+         static_cast<size_t>(FRAME_STRIDE), sizeof(Page));
+  printf("%-12s %-12s %16s\n", "requested", "granted", "touches/s");
+  for (HugePageMode mode : {HugePageMode::NONE, HugePageMode::TRANSPARENT,
+                            HugePageMode::EXPLICIT}) {
+    HugePageMode granted;
+    double touches = TouchFrames(mode, frames, frames * 64, granted);
+    printf("%-12s %-12s %16.0f\n", ModeName(mode), ModeName(granted),
+           touches);
+  }
+
+  FrameArena arena(frames * FRAME_STRIDE);
+  for (size_t frame = 0; frame < frames; ++frame) {
+    memset(FrameData(arena, frame), static_cast<int>(frame), PAGE_SIZE);
+  }
+  SpillResult direct =
+      SpillDirect(directory + "/frame_arena_direct.spill", arena, frames);
+  SpillResult buffered =
+      SpillBuffered(directory + "/frame_arena_buffered.spill", arena, frames);
+  printf("%-12s %12s %16s\n", "spill file", "MB/s", "page cache MB");
+  printf("%-12s %12.1f %16.1f\n", "O_DIRECT", direct.mb_per_second,
+         direct.cached_bytes / 1048576.0);
+  printf("%-12s %12.1f %16.1f\n", "buffered", buffered.mb_per_second,
+         buffered.cached_bytes / 1048576.0);
+
+  printf("%-12s %12s %16s\n", "database", "fetches/s", "page cache MB");
+  const char *mode_names[] = {"DiskManager", "buffered", "O_DIRECT"};
+  for (PageFileMode mode : {PageFileMode::DISK_MANAGER,
+                            PageFileMode::BUFFERED, PageFileMode::DIRECT}) {
+    PoolResult pool =
+        RunPool(directory + "/frame_arena_benchmark.db", mode, frames);
+    printf("%-12s %12.0f %16.1f%s\n",
+           mode_names[static_cast<int>(mode)], pool.fetches_per_second,
+           pool.cached_bytes / 1048576.0,
+           pool.granted ? "" : " (O_DIRECT refused, buffered)");
+  }
+  return 0;
+}
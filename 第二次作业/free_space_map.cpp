@@ -0,0 +1,217 @@
+#include <algorithm>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/free_space_map.h"
+#include "page/header_page.h"
+
+namespace scudb {
+
+FreeSpaceMap::FreeSpaceMap(BufferPoolManager *bpm, page_id_t first_page_id,
+                           uint32_t stride)
+    : bpm_(bpm), header_bpm_(bpm), first_page_id_(first_page_id),
+      stride_(stride), loaded_(false), formatted_(false), disabled_(false),
+      free_pages_(0) {}
+
+bool FreeSpaceMap::IsMapPage(page_id_t page_id) const {
+  return page_id >= first_page_id_ &&
+         (page_id - first_page_id_) % stride_ == 0 &&
+         ToIndex(page_id) % FREE_SPACE_MAP_BITS == 1;
+}
+
+void FreeSpaceMap::SetHeaderPool(BufferPoolManager *header_bpm) {
+  std::lock_guard<std::mutex> lck(latch_);
+  header_bpm_ = header_bpm;
+}
+
+bool FreeSpaceMap::Load() {
+  std::lock_guard<std::mutex> lck(latch_);
+  return loaded_ || LoadLocked();
+}
+
+/*
+ * Read the format marker, then the number of extents and the free count of
+ * each one. Only the header page is read from a database that was never
+ * formatted. A map page without the magic number was never written, none of
+ * the pages of its extent is free
+ */
+bool FreeSpaceMap::LoadLocked() {
+  //格式标记只在持有latch_时写入，读到的副本不会缺少它
+  HeaderPage header;
+  header_bpm_->ReadPageUncached(HEADER_PAGE_ID, header.GetData());
+  page_id_t version = INVALID_PAGE_ID;
+  int record_count = header.GetRecordCount();
+  bool is_header = record_count >= 0 &&
+                   record_count <= FREE_SPACE_MAP_HEADER_RECORDS;
+  formatted_ = is_header && header.GetRootId(FREE_SPACE_MAP_RECORD, version);
+  //0号页不是头页时无处记录格式标记；不认识的版本，映射页的布局可能不同
+  if (!is_header || (formatted_ && version != FREE_SPACE_MAP_VERSION)) {
+    disabled_ = true;
+  }
+  if (!formatted_ || disabled_) {
+    loaded_ = true;
+    return true;
+  }
+  ReadPageGuard guard = bpm_->FetchPageRead(MapPageId(0));
+  if (!guard.IsValid()) {
+    return false;
+  }
+  auto *map_page = guard.As<FreeSpaceMapPage>();
+  //并行缓冲池中该实例还没有释放过页
+  if (map_page->magic_ != FREE_SPACE_MAP_MAGIC) {
+    loaded_ = true;
+    return true;
+  }
+  free_counts_.assign(map_page->num_extents_, 0);
+  free_counts_[0] = map_page->free_count_;
+  guard.Drop();
+  for (size_t extent = 1; extent < free_counts_.size(); ++extent) {
+    guard = bpm_->FetchPageRead(MapPageId(extent));
+    if (guard.IsValid() &&
+        guard.As<FreeSpaceMapPage>()->magic_ == FREE_SPACE_MAP_MAGIC) {
+      free_counts_[extent] = guard.As<FreeSpaceMapPage>()->free_count_;
+    }
+  }
+  for (auto free_count : free_counts_) {
+    free_pages_ += free_count;
+  }
+  //空闲页数算好之后才算加载完成，Allocate不加锁时会看这两个值
+  loaded_ = true;
+  return true;
+}
+
+/*
+ * Initialize the map pages of the extents below num_extents, then write the
+ * format marker. A map page that is neither all zeros nor already a map page
+ * is a live page of a database written before the map existed: it is left
+ * alone and the map is disabled
+ */
+bool FreeSpaceMap::Format(size_t num_extents) {
+  for (size_t extent = free_counts_.size(); extent < num_extents; ++extent) {
+    WritePageGuard guard = bpm_->FetchPageWrite(MapPageId(extent));
+    if (!guard.IsValid()) {
+      return false;
+    }
+    if (guard.As<FreeSpaceMapPage>()->magic_ != FREE_SPACE_MAP_MAGIC) {
+      const char *data = guard.GetData();
+      if (std::any_of(data, data + PAGE_SIZE, [](char c) { return c != 0; })) {
+        disabled_ = true;
+        return false;
+      }
+      guard.AsMut<FreeSpaceMapPage>()->magic_ = FREE_SPACE_MAP_MAGIC;
+    }
+    free_counts_.push_back(guard.As<FreeSpaceMapPage>()->free_count_);
+    free_pages_ += free_counts_.back();
+  }
+  WritePageGuard guard = bpm_->FetchPageWrite(MapPageId(0));
+  if (!guard.IsValid()) {
+    return false;
+  }
+  guard.AsMut<FreeSpaceMapPage>()->num_extents_ = free_counts_.size();
+  guard.Drop();
+  //映射页就位之后再写格式标记，并行缓冲池的实例共用一个标记
+  if (!formatted_) {
+    Page *header_page = header_bpm_->FetchPage(HEADER_PAGE_ID);
+    if (header_page == nullptr) {
+      return false;
+    }
+    header_page->WLatch();
+    static_cast<HeaderPage *>(header_page)
+        ->InsertRecord(FREE_SPACE_MAP_RECORD, FREE_SPACE_MAP_VERSION);
+    header_page->WUnlatch();
+    header_bpm_->UnpinPage(HEADER_PAGE_ID, true);
+    formatted_ = true;
+  }
+  return true;
+}
+
+//在一个区中从from开始找第一个空闲页，清除它的位
+bool FreeSpaceMap::TakeFree(size_t extent, size_t from, page_id_t &page_id) {
+  WritePageGuard guard = bpm_->FetchPageWrite(MapPageId(extent));
+  if (!guard.IsValid()) {
+    return false;
+  }
+  auto *map_page = guard.AsMut<FreeSpaceMapPage>();
+  for (size_t word = from / 64; word < FREE_SPACE_MAP_BITS / 64; ++word) {
+    uint64_t bits = map_page->bits_[word];
+    if (word == from / 64) {
+      bits &= ~0ULL << (from % 64);
+    }
+    if (bits == 0) {
+      continue;
+    }
+    size_t bit = __builtin_ctzll(bits);
+    map_page->bits_[word] &= ~(1ULL << bit);
+    map_page->free_count_--;
+    free_counts_[extent]--;
+    free_pages_--;
+    page_id = ToPageId(extent * FREE_SPACE_MAP_BITS + word * 64 + bit);
+    return true;
+  }
+  return false;
+}
+
+//第一次调用时读入映射；之后没有空闲页时不加锁直接返回
+bool FreeSpaceMap::Allocate(page_id_t hint_page_id, page_id_t &page_id) {
+  if (disabled_.load() || (loaded_.load() && free_pages_.load() == 0)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lck(latch_);
+  if (!loaded_ && !LoadLocked()) {
+    return false;
+  }
+  if (disabled_ || free_pages_ == 0) {
+    return false;
+  }
+  //先在提示页所在的区中找离它最近的空闲页，同一个区的页在文件中相邻
+  size_t hint_extent = 0;
+  if (hint_page_id != INVALID_PAGE_ID && hint_page_id >= first_page_id_) {
+    size_t hint_index = ToIndex(hint_page_id);
+    hint_extent = hint_index / FREE_SPACE_MAP_BITS;
+    if (hint_extent < free_counts_.size() && free_counts_[hint_extent] > 0 &&
+        TakeFree(hint_extent, hint_index % FREE_SPACE_MAP_BITS, page_id)) {
+      return true;
+    }
+  }
+  for (size_t extent = 0; extent < free_counts_.size(); ++extent) {
+    if (free_counts_[extent] > 0 && TakeFree(extent, 0, page_id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FreeSpaceMap::Free(page_id_t page_id) {
+  std::lock_guard<std::mutex> lck(latch_);
+  if (!loaded_ && !LoadLocked()) {
+    return false;
+  }
+  if (disabled_) {
+    return false;
+  }
+  size_t index = ToIndex(page_id);
+  size_t extent = index / FREE_SPACE_MAP_BITS;
+  size_t bit = index % FREE_SPACE_MAP_BITS;
+  //第一次有页被释放的区需要初始化它的映射页，并记录在0号区的映射页中
+  if (extent >= free_counts_.size() && !Format(extent + 1)) {
+    return false;
+  }
+  WritePageGuard guard = bpm_->FetchPageWrite(MapPageId(extent));
+  if (!guard.IsValid()) {
+    return false;
+  }
+  auto *map_page = guard.AsMut<FreeSpaceMapPage>();
+  uint64_t mask = 1ULL << (bit % 64);
+  if ((map_page->bits_[bit / 64] & mask) == 0) {
+    map_page->bits_[bit / 64] |= mask;
+    map_page->free_count_++;
+    free_counts_[extent]++;
+    free_pages_++;
+  }
+  return true;
+}
+
+size_t FreeSpaceMap::GetFreePages() {
+  std::lock_guard<std::mutex> lck(latch_);
+  return free_pages_;
+}
+} // namespace scudb
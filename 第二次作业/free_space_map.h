@@ -0,0 +1,116 @@
+/*
+ * free_space_map.h
+ *
+ * Functionality: persistent map of the deallocated pages of a buffer pool, so
+ * DeletePage frees a page id that a later NewPage can hand out again instead
+ * of growing the file. The page ids of the pool are cut into extents of
+ * FREE_SPACE_MAP_BITS pages, the second page of each extent is a map page
+ * holding one bit per page of the extent (set while the page is free). Map
+ * pages are ordinary pages cached by the buffer pool they describe, the map
+ * page of extent 0 also records how many extents have a map page.
+ *
+ * The map page ids are only kept free by this code, a database written
+ * before may hold live pages there. A database is formatted for the map
+ * when its first page is deleted: every map page about to be initialized
+ * must still be all zeros, then a FREE_SPACE_MAP_RECORD record is added to
+ * the header page. Without that record no map page is read, and a map page
+ * that is not zero disables the map (deleted pages are simply not reused).
+ * The map is read by the first Allocate or Free, or up front by Load. The
+ * header page is read without caching it, so loading the map of a new
+ * database from its first NewPage does not bring in the header page that
+ * NewPage is about to allocate. Allocate only takes the latch once a page
+ * is free, NewPage on a database without deleted pages never waits for it.
+ *
+ * A pool that is one instance of a ParallelBufferPoolManager only owns every
+ * stride-th page id, the extents are made of its own page ids only.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "common/config.h"
+
+namespace scudb {
+#define FREE_SPACE_MAP_MAGIC 0x4d505346u // "FSPM"
+#define FREE_SPACE_MAP_HEADER_SIZE 16
+#define FREE_SPACE_MAP_BITS ((PAGE_SIZE - FREE_SPACE_MAP_HEADER_SIZE) * 8)
+// format marker in the header page, its value is the layout version
+#define FREE_SPACE_MAP_RECORD "free_space_map"
+#define FREE_SPACE_MAP_VERSION 1
+// a header page holds a record count then 36 byte records, a larger count
+// means page 0 is not a header page and no marker can be kept there
+#define FREE_SPACE_MAP_HEADER_RECORDS ((PAGE_SIZE - 4) / 36)
+
+class BufferPoolManager;
+
+// layout of a map page
+struct FreeSpaceMapPage {
+  uint32_t magic_;       // FREE_SPACE_MAP_MAGIC once initialized
+  uint32_t num_extents_; // only kept in the map page of extent 0
+  uint32_t free_count_;  // bits set in bits_
+  uint32_t reserved_;
+  uint64_t bits_[FREE_SPACE_MAP_BITS / 64];
+};
+
+class FreeSpaceMap {
+public:
+  // the pool owns the page ids first_page_id + k * stride
+  FreeSpaceMap(BufferPoolManager *bpm, page_id_t first_page_id = 0,
+               uint32_t stride = 1);
+
+  // pool caching the header page, the instance owning HEADER_PAGE_ID in a
+  // parallel pool, this pool by default
+  void SetHeaderPool(BufferPoolManager *header_bpm);
+
+  // map pages are never handed out by the pool nor deleted
+  bool IsMapPage(page_id_t page_id) const;
+
+  // read the map of an existing database, false if the header page or a map
+  // page cannot be fetched
+  bool Load();
+
+  // take the lowest free page at or after hint_page_id in its extent, else
+  // the lowest free page of that extent, else of the other extents. An
+  // INVALID_PAGE_ID hint takes the lowest free page. Return false if no page
+  // is free
+  bool Allocate(page_id_t hint_page_id, page_id_t &page_id);
+
+  // mark a deallocated page as free, false if its map page cannot be fetched
+  // or the map is disabled
+  bool Free(page_id_t page_id);
+
+  // number of free pages, 0 until the map is loaded
+  size_t GetFreePages();
+
+private:
+  inline size_t ToIndex(page_id_t page_id) const {
+    return static_cast<size_t>(page_id - first_page_id_) / stride_;
+  }
+  inline page_id_t ToPageId(size_t index) const {
+    return first_page_id_ + static_cast<page_id_t>(index * stride_);
+  }
+  inline page_id_t MapPageId(size_t extent) const {
+    return ToPageId(extent * FREE_SPACE_MAP_BITS + 1);
+  }
+
+  bool LoadLocked();
+  bool Format(size_t num_extents);
+  bool TakeFree(size_t extent, size_t from, page_id_t &page_id);
+
+  BufferPoolManager *bpm_;
+  BufferPoolManager *header_bpm_;
+  page_id_t first_page_id_;
+  uint32_t stride_;
+  // protects the fields below and the map pages, the atomic ones are only
+  // written under it and read without it by Allocate
+  std::mutex latch_;
+  std::atomic<bool> loaded_;   // free_counts_ has been read
+  bool formatted_;             // the header page has the format marker
+  std::atomic<bool> disabled_; // a map page holds something else, never touch it
+  std::vector<uint32_t> free_counts_; // free pages of each extent
+  std::atomic<size_t> free_pages_;
+};
+} // namespace scudb
@@ -0,0 +1,242 @@
+/**
+ * LRU-K implementation
+ */
+#include "buffer/lru_k_replacer.h"
+#include "common/exception.h"
+#include "page/page.h"
+
+namespace scudb {
+
+//帧当前存放的页，页变化时之前记录的访问历史作废
+//缓冲池只在帧被pin住或已被取走时调用replacer，这时页号不会被改写
+static int64_t ResidentKey(Page *page) { return page->GetPageId(); }
+static int64_t ResidentKey(int value) { return value; }
+
+// names of the counters of stats_, in the order of StatsCounter
+static const std::vector<std::string> LRUK_STATS_COUNTERS = {
+    "inserts", "cold_inserts", "accesses", "erases", "victims",
+    "empty_victims", "infinite_victims"};
+
+//预先分配好所有帧的访问历史，K为0时没有可比较的访问
+template <typename T>
+LRUKReplacer<T>::LRUKReplacer(T first_frame, size_t num_frames, size_t k)
+    : first_frame_(first_frame), num_frames_(num_frames), k_(k),
+      history_(num_frames * k, 0), head_(num_frames, 0),
+      count_(num_frames, 0), key_(num_frames, 0), evictable_(num_frames, 0),
+      accessed_(num_frames, 0), heap_(num_frames, 0),
+      heap_pos_(num_frames, 0), size_(0), current_timestamp_(0),
+      stats_(LRUK_STATS_COUNTERS, {}) {
+  if (k_ == 0) {
+    throw Exception("can't build an LRU-K replacer with K = 0");
+  }
+}
+
+template <typename T> LRUKReplacer<T>::~LRUKReplacer() {}
+
+//把帧放到堆的pos位置并记下位置
+template <typename T>
+void LRUKReplacer<T>::HeapSet(size_t pos, size_t frame) {
+  heap_[pos] = frame;
+  heap_pos_[frame] = pos;
+}
+
+template <typename T> void LRUKReplacer<T>::SiftUp(size_t pos) {
+  size_t frame = heap_[pos];
+  uint64_t key = EvictionKey(frame);
+  while (pos > 0) {
+    size_t parent = (pos - 1) / 2;
+    if (EvictionKey(heap_[parent]) <= key) {
+      break;
+    }
+    HeapSet(pos, heap_[parent]);
+    pos = parent;
+  }
+  HeapSet(pos, frame);
+}
+
+template <typename T> void LRUKReplacer<T>::SiftDown(size_t pos) {
+  size_t frame = heap_[pos];
+  uint64_t key = EvictionKey(frame);
+  for (;;) {
+    size_t child = pos * 2 + 1;
+    if (child >= size_) {
+      break;
+    }
+    if (child + 1 < size_ &&
+        EvictionKey(heap_[child + 1]) < EvictionKey(heap_[child])) {
+      child++;
+    }
+    if (key <= EvictionKey(heap_[child])) {
+      break;
+    }
+    HeapSet(pos, heap_[child]);
+    pos = child;
+  }
+  HeapSet(pos, frame);
+}
+
+template <typename T> void LRUKReplacer<T>::HeapPush(size_t frame) {
+  HeapSet(size_, frame);
+  size_++;
+  SiftUp(size_ - 1);
+}
+
+//用堆尾的帧填补空位，再向上或向下调整
+template <typename T> void LRUKReplacer<T>::HeapRemove(size_t frame) {
+  size_t pos = heap_pos_[frame];
+  size_--;
+  if (pos == size_) {
+    return;
+  }
+  size_t last = heap_[size_];
+  HeapSet(pos, last);
+  SiftUp(pos);
+  SiftDown(heap_pos_[last]);
+}
+
+//帧的访问记录变了，按新的键调整位置
+template <typename T> void LRUKReplacer<T>::HeapUpdate(size_t frame) {
+  SiftUp(heap_pos_[frame]);
+  SiftDown(heap_pos_[frame]);
+}
+
+//记下该帧的一次访问，调用者持有latch
+template <typename T>
+void LRUKReplacer<T>::Access(size_t frame, const T &value) {
+  stats_.Add(STAT_ACCESSES);
+  //帧里换了一张页，清空之前的访问历史
+  int64_t key = ResidentKey(value);
+  if (key_[frame] != key) {
+    key_[frame] = key;
+    count_[frame] = 0;
+    head_[frame] = 0;
+  }
+  history_[frame * k_ + head_[frame]] = current_timestamp_++;
+  head_[frame] = (head_[frame] + 1) % k_;
+  if (count_[frame] < k_) {
+    count_[frame]++;
+  }
+}
+
+/*
+ * Record an access of the frame and mark it as evictable. The access is not
+ * recorded again if RecordAccess already did since the frame was last made
+ * evictable
+ */
+template <typename T> void LRUKReplacer<T>::Insert(const T &value) {
+  lock_guard<mutex> lck(latch);
+  size_t frame = FrameIndex(value);
+  stats_.Add(STAT_INSERTS);
+  if (!accessed_[frame] || key_[frame] != ResidentKey(value)) {
+    Access(frame, value);
+  }
+  accessed_[frame] = 0;
+  if (!evictable_[frame]) {
+    evictable_[frame] = 1;
+    HeapPush(frame);
+  } else {
+    HeapUpdate(frame);
+  }
+}
+
+/*
+ * The timestamp taken for a page new in the frame only orders it among the
+ * frames with an infinite distance, it is not counted as an access: the
+ * first real access overwrites it
+ */
+template <typename T> void LRUKReplacer<T>::InsertCold(const T &value) {
+  lock_guard<mutex> lck(latch);
+  size_t frame = FrameIndex(value);
+  stats_.Add(STAT_COLD_INSERTS);
+  int64_t key = ResidentKey(value);
+  accessed_[frame] = 0;
+  if (key_[frame] != key) {
+    key_[frame] = key;
+    count_[frame] = 0;
+    head_[frame] = 0;
+    history_[frame * k_] = current_timestamp_++;
+    if (evictable_[frame]) {
+      HeapUpdate(frame);
+    }
+  }
+  if (!evictable_[frame]) {
+    evictable_[frame] = 1;
+    HeapPush(frame);
+  }
+}
+
+/*
+ * Record an access of a pinned frame, every fetch of the page counts and not
+ * only the unpin that makes it evictable again
+ */
+template <typename T> void LRUKReplacer<T>::RecordAccess(const T &value) {
+  lock_guard<mutex> lck(latch);
+  size_t frame = FrameIndex(value);
+  if (frame >= num_frames_) {
+    return;
+  }
+  Access(frame, value);
+  accessed_[frame] = 1;
+  if (evictable_[frame]) {
+    HeapUpdate(frame);
+  }
+}
+
+/* Evict the frame with the largest backward K-distance, the root of the
+ * heap. Frames accessed fewer than K times have an infinite distance and are
+ * chosen first, ties are broken by the earliest access. Return false if no
+ * frame can be evicted
+ */
+template <typename T> bool LRUKReplacer<T>::Victim(T &value) {
+  lock_guard<mutex> lck(latch);
+  if (size_ == 0) {
+    stats_.Add(STAT_EMPTY_VICTIMS);
+    return false;
+  }
+  size_t victim = heap_[0];
+  stats_.Add(STAT_VICTIMS);
+  //不足K次访问的帧，距离为无穷大
+  if (count_[victim] < k_) {
+    stats_.Add(STAT_INFINITE_VICTIMS);
+  }
+  HeapRemove(victim);
+  evictable_[victim] = 0;
+  accessed_[victim] = 0;
+  count_[victim] = 0;
+  head_[victim] = 0;
+  value = FrameAt(first_frame_, victim);
+  return true;
+}
+
+/*
+ * Mark the frame as not evictable, its access history is kept. If removal is
+ * successful, return true, otherwise return false
+ */
+template <typename T> bool LRUKReplacer<T>::Erase(const T &value) {
+  lock_guard<mutex> lck(latch);
+  size_t frame = FrameIndex(value);
+  if (frame >= num_frames_ || !evictable_[frame]) {
+    return false;
+  }
+  HeapRemove(frame);
+  evictable_[frame] = 0;
+  stats_.Add(STAT_ERASES);
+  return true;
+}
+
+//返回可替换帧的数量
+template <typename T> size_t LRUKReplacer<T>::Size() {
+  lock_guard<mutex> lck(latch);
+  return size_;
+}
+
+template <typename T>
+std::string LRUKReplacer<T>::DumpStats(const std::string &prefix) {
+  return prefix + ".size " + std::to_string(Size()) + "\n" + stats_.Dump(prefix);
+}
+
+template class LRUKReplacer<Page *>;
+// test only
+template class LRUKReplacer<int>;
+
+} // namespace scudb
@@ -0,0 +1,112 @@
+/**
+ * lru_k_replacer.h
+ *
+ * Functionality: LRU-K replacement policy. The replacer remembers the last K
+ * access timestamps of every frame and evicts the frame whose K-th most recent
+ * access is the oldest. Frames with fewer than K accesses have an infinite
+ * backward K-distance and are evicted first (the one accessed earliest goes
+ * first), so a long scan touching each page once cannot push out the hot
+ * pages that are accessed over and over again.
+ *
+ * The evictable frames are kept in a binary min-heap indexed by frame, keyed
+ * by whether the frame has K accesses and then by its oldest kept timestamp,
+ * so Victim pops the root and Insert/Erase sift one frame: O(log n), with no
+ * allocation once the arrays are sized.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "buffer/frame_arena.h"
+#include "buffer/metrics.h"
+#include "buffer/replacer.h"
+
+using namespace std;
+namespace scudb {
+
+#define LRUK_REPLACER_K 2 // default K of the LRU-K replacer
+// set in the heap key of frames with K accesses, they go after the others
+#define LRUK_FINITE_DISTANCE (1ULL << 63)
+
+template <typename T> class LRUKReplacer : public Replacer<T> {
+public:
+  // frames are the num_frames values starting at first_frame, throw an
+  // Exception if k is 0
+  LRUKReplacer(T first_frame, size_t num_frames, size_t k = LRUK_REPLACER_K);
+
+  ~LRUKReplacer();
+
+  void Insert(const T &value);
+
+  // mark the frame as evictable without recording an access: a page loaded
+  // ahead of use (prefetch) or only looked at by the pool (flush) keeps its
+  // history, a page new in the frame starts with none
+  void InsertCold(const T &value);
+
+  // record an access of a pinned frame, the next Insert does not count it
+  // again
+  void RecordAccess(const T &value);
+
+  bool Victim(T &value);
+
+  bool Erase(const T &value);
+
+  size_t Size();
+
+  // text dump of the replacer counters, see Metrics
+  std::string DumpStats(const std::string &prefix);
+
+private:
+  inline size_t FrameIndex(const T &value) const {
+    return FrameOffset(value, first_frame_);
+  }
+  // oldest timestamp kept for the frame, the K-th most recent access when the
+  // frame has been accessed K times
+  inline uint64_t OldestAccess(size_t frame) const {
+    return history_[frame * k_ + (count_[frame] < k_ ? 0 : head_[frame])];
+  }
+  // the frame with the smallest key is the victim
+  inline uint64_t EvictionKey(size_t frame) const {
+    return (count_[frame] < k_ ? 0 : LRUK_FINITE_DISTANCE) |
+           OldestAccess(frame);
+  }
+  void Access(size_t frame, const T &value);
+  void HeapPush(size_t frame);
+  void HeapRemove(size_t frame);
+  void HeapUpdate(size_t frame);
+  void SiftUp(size_t pos);
+  void SiftDown(size_t pos);
+  void HeapSet(size_t pos, size_t frame);
+
+  T first_frame_;
+  size_t num_frames_;
+  size_t k_;
+  vector<uint64_t> history_;   // last k access timestamps of each frame
+  vector<size_t> head_;        // where the next timestamp of a frame goes
+  vector<size_t> count_;       // number of accesses recorded, at most k
+  vector<int64_t> key_;        // page held by the frame when it was recorded
+  vector<char> evictable_;     // whether the frame can be evicted
+  // accesses of the frame since it was last made evictable were recorded
+  // by RecordAccess
+  vector<char> accessed_;
+  vector<size_t> heap_;        // evictable frames, the first size_ are used
+  vector<size_t> heap_pos_;    // position of each evictable frame in heap_
+  size_t size_;
+  uint64_t current_timestamp_;
+  mutable mutex latch;
+  enum StatsCounter {
+    STAT_INSERTS,
+    STAT_COLD_INSERTS,
+    STAT_ACCESSES,
+    STAT_ERASES,
+    STAT_VICTIMS,
+    STAT_EMPTY_VICTIMS,
+    STAT_INFINITE_VICTIMS
+  };
+  Metrics stats_;
+};
+
+} // namespace scudb
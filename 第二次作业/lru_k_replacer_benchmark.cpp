@@ -0,0 +1,108 @@
+/**
+ * lru_k_replacer_benchmark.cpp
+ *
+ * Scan resistance of LRUKReplacer against LRUReplacer. Point lookups pick
+ * pages of a hot set half the size of the pool, while a range scan reads a
+ * run of cold pages twice the size of the pool; the two are interleaved one
+ * to one, as a long IndexIterator scan running next to lookups. The hit ratio
+ * printed is the one of the point lookups, the ops/s column also counts the
+ * scan accesses and includes the cost of choosing victims.
+ *
+ * usage: lru_k_replacer_benchmark [frames] [accesses] [k]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "buffer/lru_k_replacer.h"
+#include "buffer/lru_replacer.h"
+
+using namespace scudb;
+
+namespace {
+
+struct Result {
+  double lookup_hit_ratio;
+  double ops_per_second;
+};
+
+//页号小于hot_pages的是点查询的热点页，其余是扫描读到的页
+std::vector<int> MixedTrace(size_t hot_pages, size_t scan_pages,
+                            size_t accesses) {
+  std::mt19937_64 rng(5);
+  std::uniform_int_distribution<int> pick(0, static_cast<int>(hot_pages) - 1);
+  std::vector<int> trace(accesses);
+  for (size_t i = 0; i < accesses; ++i) {
+    trace[i] = i % 2 == 0 ? pick(rng)
+                          : static_cast<int>(hot_pages + i / 2 % scan_pages);
+  }
+  return trace;
+}
+
+//用替换器模拟一个frames帧的缓冲池重放访问序列
+Result Replay(Replacer<int> *replacer, size_t frames, size_t pages,
+              size_t hot_pages, const std::vector<int> &trace) {
+  std::vector<int> page_frame(pages, -1);
+  std::vector<int> frame_page(frames, -1);
+  size_t used = 0;
+  size_t lookups = 0;
+  size_t lookup_hits = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int page : trace) {
+    bool lookup = static_cast<size_t>(page) < hot_pages;
+    lookups += lookup;
+    int frame = page_frame[page];
+    if (frame >= 0) {
+      lookup_hits += lookup;
+      replacer->Erase(frame);
+    } else {
+      if (used < frames) {
+        frame = static_cast<int>(used++);
+      } else if (replacer->Victim(frame)) {
+        page_frame[frame_page[frame]] = -1;
+      } else {
+        continue;
+      }
+      page_frame[page] = frame;
+      frame_page[frame] = page;
+    }
+    replacer->Insert(frame);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return Result{static_cast<double>(lookup_hits) / lookups,
+                trace.size() / elapsed.count()};
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4096;
+  size_t accesses = argc > 2 ? strtoul(argv[2], nullptr, 10) : 2000000;
+  size_t k = argc > 3 ? strtoul(argv[3], nullptr, 10) : LRUK_REPLACER_K;
+  if (frames < 2 || accesses == 0 || k == 0) {
+    fprintf(stderr, "need at least 2 frames, accesses and k positive\n");
+    return 1;
+  }
+
+  size_t hot_pages = frames / 2;
+  size_t scan_pages = frames * 2;
+  std::vector<int> trace = MixedTrace(hot_pages, scan_pages, accesses);
+
+  LRUReplacer<int> lru(0, frames);
+  LRUKReplacer<int> lru_k(0, frames, k);
+  Result lru_result =
+      Replay(&lru, frames, hot_pages + scan_pages, hot_pages, trace);
+  Result lru_k_result =
+      Replay(&lru_k, frames, hot_pages + scan_pages, hot_pages, trace);
+
+  printf("%zu frames, %zu hot pages, scan of %zu pages, %zu accesses\n",
+         frames, hot_pages, scan_pages, accesses);
+  printf("%-8s %16s %14s\n", "policy", "lookup hit ratio", "ops/s");
+  printf("%-8s %15.2f%% %14.0f\n", "LRU", lru_result.lookup_hit_ratio * 100,
+         lru_result.ops_per_second);
+  printf("LRU-%-4zu %15.2f%% %14.0f\n", k, lru_k_result.lookup_hit_ratio * 100,
+         lru_k_result.ops_per_second);
+  return 0;
+}
@@ -6,16 +6,100 @@
 
 namespace scudb {
 
-//初始化lru替换链表
-template <typename T> LRUReplacer<T>::LRUReplacer() {
-  head = make_shared<Node>();
-  tail = make_shared<Node>();
-  head->next = tail;
-  tail->prev = head;
+// names of the counters of stats_, in the order of StatsCounter
+static const std::vector<std::string> LRU_STATS_COUNTERS = {
+    "inserts", "erases", "victims", "empty_victims", "cold_inserts"};
+
+//初始化lru替换链表，未指定帧数时按插入的值依次编号，链表按需扩容
+template <typename T>
+LRUReplacer<T>::LRUReplacer()
+    : by_frame_(false), first_frame_(), num_frames_(0), cold_head_(0),
+      size_(0), stats_(LRU_STATS_COUNTERS, {}) {
+  Reserve(1);
+}
+
+//按帧数一次性分配好链表，之后的操作不再分配内存
+template <typename T>
+LRUReplacer<T>::LRUReplacer(T first_frame, size_t num_frames)
+    : by_frame_(true), first_frame_(first_frame), num_frames_(num_frames),
+      cold_head_(0), size_(0), stats_(LRU_STATS_COUNTERS, {}) {
+  Reserve(num_frames + 1);
 }
 
 template <typename T> LRUReplacer<T>::~LRUReplacer() {}
 
+/*
+ * Node of the value, 0 (the sentinel) when the value is not one of the frames.
+ * Without frames a value seen for the first time gets the next node if add is
+ * set
+ */
+template <typename T> size_t LRUReplacer<T>::FindNode(const T &value, bool add) {
+  if (by_frame_) {
+    //第一帧之前的值不能相减，否则回绕成一个很大的帧号
+    if (value < first_frame_) {
+      return 0;
+    }
+    size_t frame = FrameOffset(value, first_frame_);
+    return frame < num_frames_ ? frame + 1 : 0;
+  }
+  auto it = nodes_.find(value);
+  if (it != nodes_.end()) {
+    return it->second;
+  }
+  if (!add) {
+    return 0;
+  }
+  values_.push_back(value);
+  nodes_.emplace(value, values_.size());
+  Reserve(values_.size() + 1);
+  return values_.size();
+}
+
+//扩容到num_nodes个结点，结点0为哨兵，prev_[0]为链表尾、next_[0]为链表头
+template <typename T> void LRUReplacer<T>::Reserve(size_t num_nodes) {
+  size_t old_size = prev_.size();
+  if (num_nodes <= old_size) {
+    return;
+  }
+  prev_.resize(num_nodes);
+  next_.resize(num_nodes);
+  in_list_.resize(num_nodes, 0);
+  if (old_size == 0) {
+    prev_[0] = next_[0] = 0;
+    in_list_[0] = 1;
+  }
+}
+
+//将结点从链表中摘下
+template <typename T> void LRUReplacer<T>::Unlink(size_t node) {
+  if (node == cold_head_) {
+    cold_head_ = next_[node];
+  }
+  next_[prev_[node]] = next_[node];
+  prev_[next_[node]] = prev_[node];
+  in_list_[node] = 0;
+}
+
+//将结点放到链表头
+template <typename T> void LRUReplacer<T>::PushFront(size_t node) {
+  prev_[node] = 0;
+  next_[node] = next_[0];
+  prev_[next_[0]] = node;
+  next_[0] = node;
+  in_list_[node] = 1;
+}
+
+//将结点放到冷段的开头，排在之前插入的冷结点之后被换出
+template <typename T> void LRUReplacer<T>::PushCold(size_t node) {
+  size_t next = cold_head_;
+  prev_[node] = prev_[next];
+  next_[node] = next;
+  next_[prev_[next]] = node;
+  prev_[next] = node;
+  in_list_[node] = 1;
+  cold_head_ = node;
+}
+
 /*
  * Insert value into LRU
  */
@@ -48,28 +132,31 @@ template <typename T> LRUReplacer<T>::~LRUReplacer() {}
 template <typename T> void LRUReplacer<T>::Insert(const T &value) {
   //锁住该lru
   lock_guard<mutex> lck(latch);
-  //获得一个当前页指针
-  shared_ptr<Node> current_ptr;
-
-  //如果找到该页表在lru队列当中，那么将其从队列当中删除并移动到队列头，若没有找到该页表则直接新建一个页表放入队列头
-  if (map.find(value) != map.end()) {
-    current_ptr = map[value];
-    current_ptr->prev->next = current_ptr->next;
-    current_ptr->next->prev = current_ptr->prev;
-    current_ptr->next = head->next;
-    head->next->prev = current_ptr;
-    current_ptr->prev = head;
-    head->next = current_ptr;
-    map[value] = current_ptr;
+  size_t node = FindNode(value, true);
+  if (node == 0) {
+    return;
+  }
+  stats_.Add(STAT_INSERTS);
+
+  //如果该页表在lru队列当中，那么将其从队列当中删除并移动到队列头，否则直接放入队列头
+  if (in_list_[node]) {
+    Unlink(node);
   } else {
-    current_ptr = make_shared<Node>(value);
-    current_ptr->next = head->next;
-    head->next->prev = current_ptr;
-    current_ptr->prev = head;
-    head->next = current_ptr;
-    map.insert({value,current_ptr})
+    size_++;
   }
-  return;
+  PushFront(node);
+}
+
+//不算一次访问：已在链表中的页位置不变，其余的页放进链表尾部的冷段
+template <typename T> void LRUReplacer<T>::InsertCold(const T &value) {
+  lock_guard<mutex> lck(latch);
+  size_t node = FindNode(value, true);
+  if (node == 0 || in_list_[node]) {
+    return;
+  }
+  stats_.Add(STAT_COLD_INSERTS);
+  size_++;
+  PushCold(node);
 }
 /* If LRU is non-empty, pop the head member from LRU to argument "value", and
  * return true. If LRU is empty, return false
@@ -79,15 +166,16 @@ template <typename T> void LRUReplacer<T>::Insert(const T &value) {
 template <typename T> bool LRUReplacer<T>::Victim(T &value) {
   //锁住该页表
   lock_guard<mutex> lck(latch);
-  if (map.empty()) {
+  if (size_ == 0) {
+    stats_.Add(STAT_EMPTY_VICTIMS);
     return false;
   }
-  //查看该页表是否在队列尾部，如果在尾部那么从链表以及map当中删除该页表并且将该页表的value赋值给value引用。
-  shared_ptr<Node> last = tail->prev;
-  tail->prev = last->prev;
-  last->prev->next = tail;
-  value = last->val;
-  map.erase(last->val);
+  stats_.Add(STAT_VICTIMS);
+  //删除队列尾部的页表，并且将该页表的value赋值给value引用。
+  size_t last = prev_[0];
+  Unlink(last);
+  size_--;
+  value = by_frame_ ? FrameAt(first_frame_, last - 1) : values_[last - 1];
   return true;
 }
 
@@ -101,20 +189,27 @@ template <typename T> bool LRUReplacer<T>::Erase(const T &value) {
   //锁住该页表
   lock_guard<mutex> lck(latch);
 
-  //查看是否能找到该页表，如果找到了那么从链表以及map当中删除
-  if (map.find(value) != map.end()) {
-    shared_ptr<Node> current_ptr = map[value];
-    current_ptr->prev->next = current_ptr->next;
-    current_ptr->next->prev = current_ptr->prev;
+  //查看该页表是否在链表当中，如果在那么从链表当中删除
+  size_t node = FindNode(value, false);
+  if (node == 0 || !in_list_[node]) {
+    return false;
   }
-  return map.erase(value);
+  Unlink(node);
+  size_--;
+  stats_.Add(STAT_ERASES);
+  return true;
 }
 
 
 //返回lru链表的大小
 template <typename T> size_t LRUReplacer<T>::Size() {
   lock_guard<mutex> lck(latch);
-  return map.size();
+  return size_;
+}
+
+template <typename T>
+std::string LRUReplacer<T>::DumpStats(const std::string &prefix) {
+  return prefix + ".size " + std::to_string(Size()) + "\n" + stats_.Dump(prefix);
 }
 
 
@@ -10,41 +10,83 @@
 #pragma once
 
 
-#include <memory>
-#include <unordered_map>
 #include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "buffer/metrics.h"
+#include "buffer/frame_arena.h"
 #include "buffer/replacer.h"
 
 using namespace std;
 namespace scudb {
 
+/*
+ * The LRU list is kept intrusively in arrays indexed by frame, the frame of a
+ * value is its offset from first_frame (see FrameOffset, the frames of a pool
+ * are FRAME_STRIDE bytes apart). Node 0 is the sentinel and frame i uses node
+ * i + 1, so Insert/Erase/Victim are O(1) and do not allocate once the arrays
+ * are sized. A value outside the frames is ignored by Insert.
+ *
+ * Built without frames (default constructor) the replacer numbers the values
+ * in the order they are first inserted instead, through a map. The arrays
+ * then grow with the number of distinct values, and Insert allocates.
+ */
 template <typename T> class LRUReplacer : public Replacer<T> {
-  struct Node {
-    Node() {};
-    Node(T val) : val(val) {};
-    T val;
-    shared_ptr<Node> prev;
-    shared_ptr<Node> next;
-  };
 public:
   // do not change public interface
   LRUReplacer();
 
+  // preallocate the list for num_frames frames starting at first_frame, no
+  // allocation happens afterwards
+  LRUReplacer(T first_frame, size_t num_frames);
+
   ~LRUReplacer();
 
   void Insert(const T &value);
 
+  // make the value evictable without an access: a value already in the list
+  // keeps its place, any other one joins the cold values at the LRU end. They
+  // are evicted before every value inserted by Insert, oldest first
+  void InsertCold(const T &value);
+
   bool Victim(T &value);
 
   bool Erase(const T &value);
 
   size_t Size();
 
+  // text dump of the replacer counters, see Metrics
+  std::string DumpStats(const std::string &prefix);
+
 private:
-  shared_ptr<Node> head;
-  shared_ptr<Node> tail;
-  unordered_map<T,shared_ptr<Node>> map;
+  size_t FindNode(const T &value, bool add);
+  void Reserve(size_t num_nodes);
+  void Unlink(size_t node);
+  void PushFront(size_t node);
+  void PushCold(size_t node);
+
+  bool by_frame_;          // built with frames, nodes are frame indexes
+  T first_frame_;
+  size_t num_frames_;
+  unordered_map<T, size_t> nodes_; // value -> node, only without frames
+  vector<T> values_;       // value of node i + 1, only without frames
+  vector<size_t> prev_;    // previous node of each node
+  vector<size_t> next_;    // next node of each node
+  vector<char> in_list_;   // whether the frame is in the LRU list
+  // most recent node of the cold segment at the end of the list, the nodes
+  // from it to the tail came from InsertCold. 0 when the segment is empty
+  size_t cold_head_;
+  size_t size_;
   mutable mutex latch;
+  enum StatsCounter {
+    STAT_INSERTS,
+    STAT_ERASES,
+    STAT_VICTIMS,
+    STAT_EMPTY_VICTIMS,
+    STAT_COLD_INSERTS
+  };
+  Metrics stats_;
   // add your member variables here
 };
 
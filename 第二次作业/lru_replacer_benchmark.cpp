@@ -0,0 +1,150 @@
+/**
+ * lru_replacer_benchmark.cpp
+ *
+ * Microbenchmark of LRUReplacer against the previous implementation, a list
+ * of shared_ptr nodes found through an unordered_map (copied below as
+ * SharedPtrLRUReplacer). The trace is what the buffer pool does to its
+ * replacer: a hit erases the frame when it is pinned and inserts it again on
+ * unpin, a miss takes a victim and inserts it once the new page is unpinned.
+ *
+ * usage: lru_replacer_benchmark [frames] [operations]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "buffer/lru_replacer.h"
+
+using namespace scudb;
+
+namespace {
+
+// the LRUReplacer before it was made frame-indexed, one allocation per Insert
+template <typename T> class SharedPtrLRUReplacer {
+  struct Node {
+    Node() {}
+    Node(T val) : val(val) {}
+    T val;
+    std::shared_ptr<Node> prev;
+    std::shared_ptr<Node> next;
+  };
+
+public:
+  SharedPtrLRUReplacer() {
+    head = std::make_shared<Node>();
+    tail = std::make_shared<Node>();
+    head->next = tail;
+    tail->prev = head;
+  }
+
+  ~SharedPtrLRUReplacer() {
+    //断开环形引用，节点只剩map持有
+    for (auto &entry : map) {
+      entry.second->prev.reset();
+      entry.second->next.reset();
+    }
+    head->next.reset();
+    tail->prev.reset();
+  }
+
+  void Insert(const T &value) {
+    std::lock_guard<std::mutex> lck(latch);
+    std::shared_ptr<Node> current_ptr;
+    if (map.find(value) != map.end()) {
+      current_ptr = map[value];
+      current_ptr->prev->next = current_ptr->next;
+      current_ptr->next->prev = current_ptr->prev;
+    } else {
+      current_ptr = std::make_shared<Node>(value);
+      map.insert({value, current_ptr});
+    }
+    current_ptr->next = head->next;
+    head->next->prev = current_ptr;
+    current_ptr->prev = head;
+    head->next = current_ptr;
+  }
+
+  bool Victim(T &value) {
+    std::lock_guard<std::mutex> lck(latch);
+    if (map.empty()) {
+      return false;
+    }
+    std::shared_ptr<Node> last = tail->prev;
+    tail->prev = last->prev;
+    last->prev->next = tail;
+    value = last->val;
+    map.erase(last->val);
+    return true;
+  }
+
+  bool Erase(const T &value) {
+    std::lock_guard<std::mutex> lck(latch);
+    if (map.find(value) != map.end()) {
+      std::shared_ptr<Node> current_ptr = map[value];
+      current_ptr->prev->next = current_ptr->next;
+      current_ptr->next->prev = current_ptr->prev;
+    }
+    return map.erase(value);
+  }
+
+private:
+  std::shared_ptr<Node> head;
+  std::shared_ptr<Node> tail;
+  std::unordered_map<T, std::shared_ptr<Node>> map;
+  std::mutex latch;
+};
+
+//同一串操作分别交给两个替换器，返回每次操作的纳秒数
+template <typename R>
+double RunTrace(R &replacer, size_t frames, size_t operations) {
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<int> pick(0, static_cast<int>(frames) - 1);
+  std::uniform_int_distribution<int> percent(0, 99);
+  for (size_t i = 0; i < frames; ++i) {
+    replacer.Insert(static_cast<int>(i));
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < operations; ++i) {
+    int frame = pick(rng);
+    if (percent(rng) < 90) {
+      replacer.Erase(frame);
+    } else if (!replacer.Victim(frame)) {
+      continue;
+    }
+    replacer.Insert(frame);
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / operations;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 16384;
+  size_t operations = argc > 2 ? strtoul(argv[2], nullptr, 10) : 10000000;
+  if (frames == 0 || operations == 0) {
+    fprintf(stderr, "frames and operations must be positive\n");
+    return 1;
+  }
+
+  double old_ns;
+  {
+    SharedPtrLRUReplacer<int> replacer;
+    old_ns = RunTrace(replacer, frames, operations);
+  }
+  double new_ns;
+  {
+    LRUReplacer<int> replacer(0, frames);
+    new_ns = RunTrace(replacer, frames, operations);
+  }
+  printf("%zu frames, %zu operations (90%% hits)\n", frames, operations);
+  printf("%-24s %8.1f ns/op\n", "shared_ptr + map", old_ns);
+  printf("%-24s %8.1f ns/op\n", "frame-indexed", new_ns);
+  printf("%-24s %8.2fx\n", "speedup", old_ns / new_ns);
+  return 0;
+}
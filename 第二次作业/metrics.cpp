@@ -0,0 +1,97 @@
+#include <sstream>
+
+#include "buffer/metrics.h"
+
+namespace scudb {
+
+std::atomic<bool> Metrics::enabled_(false);
+std::atomic<size_t> Metrics::next_shard_(0);
+
+/*
+ * A shard holds the counters, then for each histogram its buckets followed by
+ * the sum of the recorded latencies
+ */
+Metrics::Metrics(const std::vector<std::string> &counter_names,
+                 const std::vector<std::string> &histogram_names)
+    : counter_names_(counter_names),
+      histogram_names_(histogram_names) {
+  const size_t line = 64 / sizeof(std::atomic<uint64_t>);
+  stride_ = counter_names_.size() +
+            histogram_names_.size() * (METRICS_HISTOGRAM_BUCKETS + 1);
+  stride_ = (stride_ + line - 1) / line * line;
+  size_t size = stride_ * METRICS_SHARDS + line;
+  raw_.reset(new std::atomic<uint64_t>[size]);
+  for (size_t i = 0; i < size; ++i) {
+    raw_[i].store(0);
+  }
+  //对齐到缓存行，避免不同线程的分片共享同一缓存行
+  uintptr_t addr = reinterpret_cast<uintptr_t>(raw_.get());
+  values_ = raw_.get() + ((64 - addr % 64) % 64) / sizeof(std::atomic<uint64_t>);
+}
+
+void Metrics::SetEnabled(bool enabled) { enabled_.store(enabled); }
+
+//每个线程第一次使用时分到一个分片，之后一直使用它
+std::atomic<uint64_t> *Metrics::Shard() {
+  static thread_local size_t shard =
+      next_shard_.fetch_add(1, std::memory_order_relaxed) % METRICS_SHARDS;
+  return values_ + shard * stride_;
+}
+
+void Metrics::Record(size_t histogram, uint64_t nanos) {
+  size_t bucket = 0;
+  while (bucket + 1 < METRICS_HISTOGRAM_BUCKETS && (nanos >> bucket) != 0) {
+    bucket++;
+  }
+  std::atomic<uint64_t> *values = Shard() + counter_names_.size() +
+                                  histogram * (METRICS_HISTOGRAM_BUCKETS + 1);
+  values[bucket].fetch_add(1, std::memory_order_relaxed);
+  values[METRICS_HISTOGRAM_BUCKETS].fetch_add(nanos, std::memory_order_relaxed);
+}
+
+uint64_t Metrics::GetCounter(size_t counter) const {
+  uint64_t sum = 0;
+  for (size_t shard = 0; shard < METRICS_SHARDS; ++shard) {
+    sum += values_[shard * stride_ + counter].load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+std::string Metrics::Dump(const std::string &prefix) const {
+  std::ostringstream out;
+  for (size_t i = 0; i < counter_names_.size(); ++i) {
+    out << prefix << "." << counter_names_[i] << " " << GetCounter(i) << "\n";
+  }
+  for (size_t h = 0; h < histogram_names_.size(); ++h) {
+    uint64_t buckets[METRICS_HISTOGRAM_BUCKETS + 1] = {0};
+    size_t offset = counter_names_.size() + h * (METRICS_HISTOGRAM_BUCKETS + 1);
+    for (size_t shard = 0; shard < METRICS_SHARDS; ++shard) {
+      for (size_t b = 0; b <= METRICS_HISTOGRAM_BUCKETS; ++b) {
+        buckets[b] += values_[shard * stride_ + offset + b].load(
+            std::memory_order_relaxed);
+      }
+    }
+    uint64_t count = 0;
+    for (size_t b = 0; b < METRICS_HISTOGRAM_BUCKETS; ++b) {
+      count += buckets[b];
+    }
+    out << prefix << "." << histogram_names_[h] << " count=" << count
+        << " sum=" << buckets[METRICS_HISTOGRAM_BUCKETS];
+    const int percentiles[] = {50, 90, 99};
+    for (int p : percentiles) {
+      //第一个累计数量达到该百分位的桶，输出它的上界
+      uint64_t seen = 0;
+      size_t b = 0;
+      while (b + 1 < METRICS_HISTOGRAM_BUCKETS &&
+             (count == 0 || (seen + buckets[b]) * 100 < count * p)) {
+        seen += buckets[b];
+        b++;
+      }
+      out << " p" << p << "=" << (count == 0 ? 0 : (uint64_t(1) << b));
+    }
+    out << "\n";
+  }
+  return out.str();
+}
+
+} // namespace scudb
@@ -0,0 +1,81 @@
+/*
+ * metrics.h
+ *
+ * Functionality: counters and latency histograms of the buffer pool, the
+ * replacer and the page table. Every thread updates its own shard of the
+ * values, the shards are only added up when the metrics are read or dumped.
+ * Recording is off by default, a disabled Metrics costs one relaxed atomic
+ * load per call site.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace scudb {
+#define METRICS_SHARDS 32            // a thread always updates the same shard
+#define METRICS_HISTOGRAM_BUCKETS 32 // bucket i counts latencies < 2^i ns
+
+class Metrics {
+public:
+  Metrics(const std::vector<std::string> &counter_names,
+          const std::vector<std::string> &histogram_names);
+
+  // turn recording on or off for every Metrics of the process
+  static void SetEnabled(bool enabled);
+  static inline bool Enabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  // start of a timed section, 0 when recording is off
+  static inline uint64_t Now() {
+    if (!Enabled()) {
+      return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  inline void Add(size_t counter, uint64_t n = 1) {
+    if (Enabled()) {
+      Shard()[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+  }
+
+  // record the time since start (returned by Now) into the histogram
+  inline void RecordSince(size_t histogram, uint64_t start) {
+    if (start != 0 && Enabled()) {
+      Record(histogram, Now() - start);
+    }
+  }
+
+  void Record(size_t histogram, uint64_t nanos);
+
+  // sum of the counter over all the shards
+  uint64_t GetCounter(size_t counter) const;
+
+  // one line per counter: "prefix.name value", and per histogram:
+  // "prefix.name count=N sum=S p50=X p90=X p99=X", the percentiles are the
+  // upper bounds of their buckets in ns
+  std::string Dump(const std::string &prefix) const;
+
+private:
+  std::atomic<uint64_t> *Shard();
+
+  static std::atomic<bool> enabled_;
+  static std::atomic<size_t> next_shard_;
+
+  std::vector<std::string> counter_names_;
+  std::vector<std::string> histogram_names_;
+  size_t stride_; // values of a shard, rounded up to whole cache lines
+  std::unique_ptr<std::atomic<uint64_t>[]> raw_;
+  std::atomic<uint64_t> *values_; // raw_ aligned on a cache line
+};
+
+} // namespace scudb
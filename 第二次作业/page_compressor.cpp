@@ -0,0 +1,159 @@
+#include <cstring>
+
+#include "buffer/page_compressor.h"
+
+namespace scudb {
+// positions and offsets are kept in 16 bits
+static_assert(PAGE_SIZE < 65536, "pages too large for PageCompressor");
+
+namespace {
+inline uint32_t Load32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline size_t Hash(uint32_t v) {
+  return (v * 2654435761u) >> (32 - COMPRESSOR_HASH_BITS);
+}
+
+//长度超过15时，剩余部分按每字节最多255写出
+inline bool PutLength(size_t length, uint8_t *dst, size_t &out,
+                      size_t capacity) {
+  for (; length >= 255; length -= 255) {
+    if (out >= capacity) {
+      return false;
+    }
+    dst[out++] = 255;
+  }
+  if (out >= capacity) {
+    return false;
+  }
+  dst[out++] = static_cast<uint8_t>(length);
+  return true;
+}
+
+inline bool GetLength(const uint8_t *src, size_t size, size_t &in,
+                      size_t &length) {
+  uint8_t byte;
+  do {
+    if (in >= size) {
+      return false;
+    }
+    byte = src[in++];
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+//写出一个序列：token、字面量、匹配偏移和长度，match_length为0时是最后一个序列
+bool PutSequence(const uint8_t *literals, size_t literal_length,
+                 size_t offset, size_t match_length, uint8_t *dst,
+                 size_t &out, size_t capacity) {
+  if (out >= capacity) {
+    return false;
+  }
+  size_t token = out++;
+  dst[token] = static_cast<uint8_t>((literal_length < 15 ? literal_length : 15)
+                                    << 4);
+  if (literal_length >= 15 &&
+      !PutLength(literal_length - 15, dst, out, capacity)) {
+    return false;
+  }
+  if (out + literal_length > capacity) {
+    return false;
+  }
+  memcpy(dst + out, literals, literal_length);
+  out += literal_length;
+  if (match_length == 0) {
+    return true;
+  }
+  if (out + 2 > capacity) {
+    return false;
+  }
+  dst[out++] = static_cast<uint8_t>(offset);
+  dst[out++] = static_cast<uint8_t>(offset >> 8);
+  size_t length = match_length - COMPRESSOR_MIN_MATCH;
+  dst[token] |= static_cast<uint8_t>(length < 15 ? length : 15);
+  return length < 15 || PutLength(length - 15, dst, out, capacity);
+}
+} // namespace
+
+size_t PageCompressor::Compress(const char *src, char *dst, size_t capacity) {
+  const uint8_t *in = reinterpret_cast<const uint8_t *>(src);
+  uint8_t *out_data = reinterpret_cast<uint8_t *>(dst);
+  //存放位置加一，0表示空
+  uint16_t table[1 << COMPRESSOR_HASH_BITS] = {0};
+  size_t anchor = 0;
+  size_t pos = 0;
+  size_t out = 0;
+  const size_t limit = PAGE_SIZE - COMPRESSOR_LAST_LITERALS;
+  while (pos + COMPRESSOR_MIN_MATCH <= limit) {
+    uint32_t sequence = Load32(in + pos);
+    size_t h = Hash(sequence);
+    size_t candidate = table[h];
+    table[h] = static_cast<uint16_t>(pos + 1);
+    if (candidate == 0 || Load32(in + candidate - 1) != sequence) {
+      pos++;
+      continue;
+    }
+    size_t match = candidate - 1;
+    size_t length = COMPRESSOR_MIN_MATCH;
+    while (pos + length < limit && in[match + length] == in[pos + length]) {
+      length++;
+    }
+    if (!PutSequence(in + anchor, pos - anchor, pos - match, length, out_data,
+                     out, capacity)) {
+      return 0;
+    }
+    pos += length;
+    anchor = pos;
+  }
+  if (!PutSequence(in + anchor, PAGE_SIZE - anchor, 0, 0, out_data, out,
+                   capacity)) {
+    return 0;
+  }
+  return out;
+}
+
+bool PageCompressor::Decompress(const char *src, size_t size, char *dst) {
+  const uint8_t *in = reinterpret_cast<const uint8_t *>(src);
+  uint8_t *out_data = reinterpret_cast<uint8_t *>(dst);
+  size_t ip = 0;
+  size_t op = 0;
+  while (ip < size) {
+    uint8_t token = in[ip++];
+    size_t literal_length = token >> 4;
+    if (literal_length == 15 && !GetLength(in, size, ip, literal_length)) {
+      return false;
+    }
+    if (ip + literal_length > size || op + literal_length > PAGE_SIZE) {
+      return false;
+    }
+    memcpy(out_data + op, in + ip, literal_length);
+    ip += literal_length;
+    op += literal_length;
+    if (ip == size) {
+      break;
+    }
+    if (ip + 2 > size) {
+      return false;
+    }
+    size_t offset = in[ip] | (static_cast<size_t>(in[ip + 1]) << 8);
+    ip += 2;
+    size_t match_length = token & 15;
+    if (match_length == 15 && !GetLength(in, size, ip, match_length)) {
+      return false;
+    }
+    match_length += COMPRESSOR_MIN_MATCH;
+    if (offset == 0 || offset > op || op + match_length > PAGE_SIZE) {
+      return false;
+    }
+    //匹配可能与输出重叠，逐字节复制
+    for (size_t i = 0; i < match_length; ++i, ++op) {
+      out_data[op] = out_data[op - offset];
+    }
+  }
+  return op == PAGE_SIZE;
+}
+} // namespace scudb
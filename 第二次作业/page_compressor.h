@@ -0,0 +1,35 @@
+/*
+ * page_compressor.h
+ *
+ * Functionality: fast LZ77 block compression of one page, in the spirit of
+ * LZ4. The compressed block is a list of sequences, each one a token byte
+ * (high nibble: literal length, low nibble: match length - 4, 15 means more
+ * length bytes follow, each adding up to 255), the literal length bytes, the
+ * literals, a 2 byte little endian match offset and the match length bytes.
+ * The last sequence only has literals. Matches are found through a small hash
+ * table of the 4 byte sequences seen so far, no entropy coding is done, so
+ * both directions cost a few microseconds per page.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "common/config.h"
+
+namespace scudb {
+#define COMPRESSOR_HASH_BITS 12 // entries of the match finder: 1 << 12
+#define COMPRESSOR_MIN_MATCH 4
+#define COMPRESSOR_LAST_LITERALS 5 // the tail of a page is never matched
+
+class PageCompressor {
+public:
+  // compress the PAGE_SIZE bytes of src into dst, return the compressed size
+  // or 0 if it would not fit in capacity bytes
+  static size_t Compress(const char *src, char *dst, size_t capacity);
+
+  // decompress a block of size bytes into the PAGE_SIZE bytes of dst, false
+  // if the block is corrupted
+  static bool Decompress(const char *src, size_t size, char *dst);
+};
+} // namespace scudb
@@ -0,0 +1,107 @@
+#include <utility>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/page_guard.h"
+
+namespace scudb {
+
+BasicPageGuard::BasicPageGuard(BufferPoolManager *bpm, Page *page)
+    : pool_(bpm), page_(page), page_id_(page->GetPageId()),
+      data_(page->GetData()) {}
+
+BasicPageGuard::BasicPageGuard(PageUnpinner *pool, page_id_t page_id,
+                               char *data)
+    : pool_(pool), page_id_(page_id), data_(data) {}
+
+BasicPageGuard::BasicPageGuard(BasicPageGuard &&that) noexcept
+    : pool_(that.pool_), page_(that.page_), page_id_(that.page_id_),
+      data_(that.data_), is_dirty_(that.is_dirty_) {
+  that.pool_ = nullptr;
+  that.page_ = nullptr;
+  that.page_id_ = INVALID_PAGE_ID;
+  that.data_ = nullptr;
+  that.is_dirty_ = false;
+}
+
+//先释放自己持有的页，再接管另一个guard的页
+BasicPageGuard &BasicPageGuard::operator=(BasicPageGuard &&that) noexcept {
+  if (this != &that) {
+    Drop();
+    pool_ = that.pool_;
+    page_ = that.page_;
+    page_id_ = that.page_id_;
+    data_ = that.data_;
+    is_dirty_ = that.is_dirty_;
+    that.pool_ = nullptr;
+    that.page_ = nullptr;
+    that.page_id_ = INVALID_PAGE_ID;
+    that.data_ = nullptr;
+    that.is_dirty_ = false;
+  }
+  return *this;
+}
+
+BasicPageGuard::~BasicPageGuard() { Drop(); }
+
+//只unpin一次
+void BasicPageGuard::Drop() {
+  if (data_ != nullptr) {
+    pool_->UnpinPage(page_id_, is_dirty_);
+  }
+  pool_ = nullptr;
+  page_ = nullptr;
+  page_id_ = INVALID_PAGE_ID;
+  data_ = nullptr;
+  is_dirty_ = false;
+}
+
+ReadPageGuard::ReadPageGuard(BufferPoolManager *bpm, Page *page)
+    : guard_(bpm, page) {}
+
+//视图中的数据只读，去掉const只是为了和普通页共用guard
+ReadPageGuard::ReadPageGuard(PageUnpinner *pool, page_id_t page_id,
+                             const char *data)
+    : guard_(pool, page_id, const_cast<char *>(data)) {}
+
+ReadPageGuard &ReadPageGuard::operator=(ReadPageGuard &&that) noexcept {
+  if (this != &that) {
+    Drop();
+    guard_ = std::move(that.guard_);
+  }
+  return *this;
+}
+
+ReadPageGuard::~ReadPageGuard() { Drop(); }
+
+//先释放读锁再unpin
+void ReadPageGuard::Drop() {
+  if (guard_.page_ != nullptr) {
+    guard_.page_->RUnlatch();
+  }
+  guard_.Drop();
+}
+
+WritePageGuard::WritePageGuard(BufferPoolManager *bpm, Page *page)
+    : guard_(bpm, page) {
+  guard_.is_dirty_ = true;
+}
+
+WritePageGuard &WritePageGuard::operator=(WritePageGuard &&that) noexcept {
+  if (this != &that) {
+    Drop();
+    guard_ = std::move(that.guard_);
+  }
+  return *this;
+}
+
+WritePageGuard::~WritePageGuard() { Drop(); }
+
+//先释放写锁再unpin
+void WritePageGuard::Drop() {
+  if (guard_.page_ != nullptr) {
+    guard_.page_->WUnlatch();
+  }
+  guard_.Drop();
+}
+
+} // namespace scudb
@@ -0,0 +1,156 @@
+/*
+ * page_guard.h
+ *
+ * Functionality: RAII guards over a page fetched from the buffer pool. A guard
+ * holds the Page * it was created with and, in its destructor, releases the
+ * page latch (if any) and unpins the page exactly once, so callers never need
+ * to fetch the page again only to get the Page * back. Guards are movable but
+ * not copyable, moving a guard into another one releases the page the target
+ * was holding. A read guard can also be a view of a page that does not live in
+ * a frame (see ReadOnlyBufferPoolManager), it then has no Page and no latch.
+ * A guard gives its page back through PageUnpinner. PageReader is the read
+ * side both kinds of pool have in common, code that only reads pages through
+ * guards (BPlusTree lookups and scans, IndexIterator) is written against it.
+ */
+
+#pragma once
+
+#include "page/page.h"
+
+namespace scudb {
+
+class AccessStrategy;
+class BufferPoolManager;
+
+// what a guard unpins its page from: a BufferPoolManager, or a
+// ReadOnlyBufferPoolManager for a view
+class PageUnpinner {
+public:
+  virtual ~PageUnpinner() = default;
+
+  virtual bool UnpinPage(page_id_t page_id, bool is_dirty) = 0;
+};
+
+// pinned page, no latch held
+class BasicPageGuard {
+public:
+  BasicPageGuard() = default;
+
+  BasicPageGuard(BufferPoolManager *bpm, Page *page);
+
+  BasicPageGuard(const BasicPageGuard &) = delete;
+  BasicPageGuard &operator=(const BasicPageGuard &) = delete;
+
+  BasicPageGuard(BasicPageGuard &&that) noexcept;
+
+  BasicPageGuard &operator=(BasicPageGuard &&that) noexcept;
+
+  ~BasicPageGuard();
+
+  // unpin the page now, the guard becomes invalid
+  void Drop();
+
+  inline bool IsValid() const { return data_ != nullptr; }
+  inline page_id_t PageId() { return page_id_; }
+  inline char *GetData() { return data_; }
+  // nullptr for a view
+  inline Page *GetPage() { return page_; }
+
+  template <class T> T *As() { return reinterpret_cast<T *>(GetData()); }
+
+  // the page is unpinned as dirty
+  template <class T> T *AsMut() {
+    is_dirty_ = true;
+    return reinterpret_cast<T *>(GetData());
+  }
+
+private:
+  friend class ReadPageGuard;
+  friend class WritePageGuard;
+
+  // view of the page data, only read guards are built this way
+  BasicPageGuard(PageUnpinner *pool, page_id_t page_id, char *data);
+
+  PageUnpinner *pool_ = nullptr;
+  Page *page_ = nullptr;
+  page_id_t page_id_ = INVALID_PAGE_ID;
+  char *data_ = nullptr;
+  bool is_dirty_ = false;
+};
+
+// pinned page with its read latch held
+class ReadPageGuard {
+public:
+  ReadPageGuard() = default;
+
+  // the page must already be read latched
+  ReadPageGuard(BufferPoolManager *bpm, Page *page);
+
+  // view of the data of a pinned page which is not in a frame, the data is
+  // never written so there is no latch to hold
+  ReadPageGuard(PageUnpinner *pool, page_id_t page_id, const char *data);
+
+  ReadPageGuard(ReadPageGuard &&that) noexcept = default;
+
+  ReadPageGuard &operator=(ReadPageGuard &&that) noexcept;
+
+  ~ReadPageGuard();
+
+  // release the read latch and unpin the page now
+  void Drop();
+
+  inline bool IsValid() const { return guard_.IsValid(); }
+  inline page_id_t PageId() { return guard_.PageId(); }
+  inline char *GetData() { return guard_.GetData(); }
+
+  template <class T> T *As() { return guard_.As<T>(); }
+
+private:
+  BasicPageGuard guard_;
+};
+
+// pinned page with its write latch held, unpinned as dirty
+class WritePageGuard {
+public:
+  WritePageGuard() = default;
+
+  // the page must already be write latched
+  WritePageGuard(BufferPoolManager *bpm, Page *page);
+
+  WritePageGuard(WritePageGuard &&that) noexcept = default;
+
+  WritePageGuard &operator=(WritePageGuard &&that) noexcept;
+
+  ~WritePageGuard();
+
+  // release the write latch and unpin the page now
+  void Drop();
+
+  inline bool IsValid() const { return guard_.IsValid(); }
+  inline page_id_t PageId() { return guard_.PageId(); }
+  inline char *GetData() { return guard_.GetData(); }
+
+  template <class T> T *As() { return guard_.As<T>(); }
+  template <class T> T *AsMut() { return guard_.AsMut<T>(); }
+
+private:
+  BasicPageGuard guard_;
+};
+
+// read only access to pages: a BufferPoolManager, or a
+// ReadOnlyBufferPoolManager whose pages are views of a mapped file
+class PageReader : public PageUnpinner {
+public:
+  // the guard is invalid when the page cannot be read
+  virtual ReadPageGuard FetchPageRead(page_id_t page_id,
+                                      AccessStrategy *strategy = nullptr) = 0;
+
+  // start reading the page ahead of time, without pinning it
+  virtual bool PrefetchPage(page_id_t page_id,
+                            AccessStrategy *strategy = nullptr) = 0;
+
+  // copy the page into data without pinning it or counting an access
+  virtual bool PeekPage(page_id_t page_id, char *data) = 0;
+};
+
+} // namespace scudb
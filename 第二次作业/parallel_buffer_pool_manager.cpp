@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cstdint>
+
+#include "buffer/parallel_buffer_pool_manager.h"
+
+namespace scudb {
+
+/*
+ * ParallelBufferPoolManager Constructor
+ * Create num_instances instances with pool_size frames each, instance i only
+ * owns the page ids where page_id % num_instances == i
+ */
+ParallelBufferPoolManager::ParallelBufferPoolManager(size_t num_instances,
+                                                     size_t pool_size,
+                                                     DiskManager *disk_manager,
+                                                     LogManager *log_manager,
+                                                     ReplacerType replacer_type,
+                                                     size_t lru_k,
+                                                     HugePageMode huge_pages)
+    : BufferPoolManager(disk_manager, log_manager), next_instance_(0) {
+  for (size_t i = 0; i < num_instances; ++i) {
+    instances_.push_back(new BufferPoolManager(
+        pool_size, static_cast<uint32_t>(num_instances),
+        static_cast<uint32_t>(i), disk_manager, log_manager, replacer_type,
+        lru_k, huge_pages));
+  }
+  //所有实例共用并行缓冲池的I/O线程，而不是每个实例各开一组
+  for (auto *instance : instances_) {
+    delete instance->disk_scheduler_;
+    instance->disk_scheduler_ = disk_scheduler_;
+    instance->owns_disk_scheduler_ = false;
+  }
+  //各实例从磁盘管理器的下一个页号开始各自分配，分配时再推进磁盘管理器，
+  //重新打开数据库后页号不会从0开始
+  page_id_t first_page_id = disk_manager->AllocatePage();
+  for (size_t i = 0; i < num_instances; ++i) {
+    size_t offset = (i + num_instances -
+                     static_cast<size_t>(first_page_id) % num_instances) %
+                    num_instances;
+    instances_[i]->next_page_id_ =
+        first_page_id + static_cast<page_id_t>(offset);
+  }
+  //头页只缓存在拥有它的实例中
+  BufferPoolManager *header_bpm = GetBufferPoolManager(HEADER_PAGE_ID);
+  for (auto *instance : instances_) {
+    instance->free_space_map_->SetHeaderPool(header_bpm);
+  }
+}
+
+ParallelBufferPoolManager::~ParallelBufferPoolManager() {
+  //各实例的页按热度交替合并成一个清单
+  if (!manifest_file_.empty()) {
+    StopPageCleaner();
+    std::vector<std::vector<page_id_t>> instance_ids(instances_.size());
+    size_t longest = 0;
+    for (size_t i = 0; i < instances_.size(); ++i) {
+      instances_[i]->GetResidentPages(instance_ids[i]);
+      longest = std::max(longest, instance_ids[i].size());
+    }
+    std::vector<page_id_t> page_ids;
+    for (size_t j = 0; j < longest; ++j) {
+      for (auto &ids : instance_ids) {
+        if (j < ids.size()) {
+          page_ids.push_back(ids[j]);
+        }
+      }
+    }
+    WriteManifest(manifest_file_, page_ids);
+    manifest_file_.clear();
+  }
+  for (auto *instance : instances_) {
+    delete instance;
+  }
+}
+
+//根据页号找到负责该页的实例
+BufferPoolManager *
+ParallelBufferPoolManager::GetBufferPoolManager(page_id_t page_id) {
+  return instances_[static_cast<size_t>(page_id) % instances_.size()];
+}
+
+Page *ParallelBufferPoolManager::FetchPage(page_id_t page_id,
+                                           AccessStrategy *strategy) {
+  return GetBufferPoolManager(page_id)->FetchPage(page_id, strategy);
+}
+
+bool ParallelBufferPoolManager::PrefetchPage(page_id_t page_id,
+                                             AccessStrategy *strategy) {
+  if (page_id == INVALID_PAGE_ID) {
+    return false;
+  }
+  return GetBufferPoolManager(page_id)->PrefetchPage(page_id, strategy);
+}
+
+Page *ParallelBufferPoolManager::TryFetchPage(page_id_t page_id) {
+  return GetBufferPoolManager(page_id)->TryFetchPage(page_id);
+}
+
+bool ParallelBufferPoolManager::PeekPage(page_id_t page_id, char *data) {
+  return GetBufferPoolManager(page_id)->PeekPage(page_id, data);
+}
+
+bool ParallelBufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty) {
+  return GetBufferPoolManager(page_id)->UnpinPage(page_id, is_dirty);
+}
+
+/*
+ * Split page_ids by instance and start the fetches of every instance before
+ * waiting for any read, then put the pages back in the order of page_ids
+ */
+std::vector<Page *>
+ParallelBufferPoolManager::FetchPages(const std::vector<page_id_t> &page_ids) {
+  size_t num_instances = instances_.size();
+  std::vector<std::vector<page_id_t>> instance_ids(num_instances);
+  std::vector<std::vector<size_t>> positions(num_instances);
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    size_t instance = static_cast<size_t>(page_ids[i]) % num_instances;
+    instance_ids[instance].push_back(page_ids[i]);
+    positions[instance].push_back(i);
+  }
+  std::vector<std::vector<Page *>> instance_pages(num_instances);
+  std::vector<std::vector<std::future<void>>> reads(num_instances);
+  for (size_t i = 0; i < num_instances; ++i) {
+    if (!instance_ids[i].empty()) {
+      instances_[i]->FetchPagesAsync(instance_ids[i], instance_pages[i],
+                                     reads[i]);
+    }
+  }
+  std::vector<Page *> pages(page_ids.size(), nullptr);
+  for (size_t i = 0; i < num_instances; ++i) {
+    for (size_t j = 0; j < instance_pages[i].size(); ++j) {
+      if (reads[i][j].valid()) {
+        reads[i][j].wait();
+      }
+      pages[positions[i][j]] = instance_pages[i][j];
+    }
+  }
+  return pages;
+}
+
+bool ParallelBufferPoolManager::UnpinPages(
+    const std::vector<page_id_t> &page_ids, bool is_dirty) {
+  std::vector<std::vector<page_id_t>> instance_ids(instances_.size());
+  for (page_id_t page_id : page_ids) {
+    instance_ids[static_cast<size_t>(page_id) % instances_.size()].push_back(
+        page_id);
+  }
+  bool unpinned = true;
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    if (!instance_ids[i].empty()) {
+      unpinned = instances_[i]->UnpinPages(instance_ids[i], is_dirty) &&
+                 unpinned;
+    }
+  }
+  return unpinned;
+}
+
+bool ParallelBufferPoolManager::FlushPage(page_id_t page_id) {
+  return GetBufferPoolManager(page_id)->FlushPage(page_id);
+}
+
+/*
+ * The instances own interleaved page ids, so snapshot the dirty pages of all
+ * of them first and write them back in a single page id ordered pass
+ */
+void ParallelBufferPoolManager::FlushPages(page_id_t first_page_id,
+                                           page_id_t last_page_id) {
+  std::vector<std::vector<Page *>> instance_pages(instances_.size());
+  std::vector<Page *> dirty_pages;
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    instances_[i]->PinDirtyPages(first_page_id, last_page_id,
+                                 instance_pages[i]);
+    dirty_pages.insert(dirty_pages.end(), instance_pages[i].begin(),
+                       instance_pages[i].end());
+  }
+  WriteSortedPages(dirty_pages);
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    instances_[i]->UnpinFlushedPages(instance_pages[i]);
+  }
+}
+
+/*
+ * Allocate the new page round-robin across the instances, starting from the
+ * instance after the one used by the previous call, or from the instance
+ * owning hint_page_id. If the starting instance has every frame pinned, try
+ * the next ones, return nullptr only when no instance can hold the new page
+ */
+Page *ParallelBufferPoolManager::NewPage(page_id_t &page_id,
+                                         page_id_t hint_page_id,
+                                         AccessStrategy *strategy) {
+  size_t start = hint_page_id != INVALID_PAGE_ID
+                     ? static_cast<size_t>(hint_page_id) % instances_.size()
+                     : next_instance_.fetch_add(1) % instances_.size();
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    Page *new_page = instances_[(start + i) % instances_.size()]->NewPage(
+        page_id, hint_page_id, strategy);
+    if (new_page != nullptr) {
+      return new_page;
+    }
+  }
+  return nullptr;
+}
+
+bool ParallelBufferPoolManager::DeletePage(page_id_t page_id) {
+  return GetBufferPoolManager(page_id)->DeletePage(page_id);
+}
+
+//返回所有实例的总帧数
+size_t ParallelBufferPoolManager::GetPoolSize() {
+  size_t pool_size = 0;
+  for (auto *instance : instances_) {
+    pool_size += instance->GetPoolSize();
+  }
+  return pool_size;
+}
+
+size_t ParallelBufferPoolManager::Grow(size_t n) {
+  size_t grown = 0;
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    grown += instances_[i]->Grow(n / instances_.size() +
+                                 (i < n % instances_.size() ? 1 : 0));
+  }
+  return grown;
+}
+
+size_t ParallelBufferPoolManager::Shrink(size_t n) {
+  size_t released = 0;
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    released += instances_[i]->Shrink(n / instances_.size() +
+                                      (i < n % instances_.size() ? 1 : 0));
+  }
+  return released;
+}
+
+//依次输出所有实例的统计信息
+std::string ParallelBufferPoolManager::DumpStats() {
+  std::string stats;
+  for (auto *instance : instances_) {
+    stats += instance->DumpStats();
+  }
+  CompressionStats compression_stats;
+  if (GetCompressionStats(compression_stats)) {
+    stats += "buffer_pool.compression.bytes_written " +
+             std::to_string(compression_stats.bytes_written) + "\n";
+    stats += "buffer_pool.compression.bytes_read " +
+             std::to_string(compression_stats.bytes_read) + "\n";
+    stats += "buffer_pool.compression.file_bytes " +
+             std::to_string(compression_stats.file_bytes) + "\n";
+  }
+  return stats;
+}
+
+//汇总所有实例的ARC状态，各实例的p分别自适应，相加没有意义，只给出平均值和范围
+bool ParallelBufferPoolManager::GetARCStats(ARCStats &stats) {
+  stats = ARCStats{0, 0, 0, 0, 0, SIZE_MAX, 0};
+  for (auto *instance : instances_) {
+    ARCStats instance_stats;
+    if (!instance->GetARCStats(instance_stats)) {
+      return false;
+    }
+    stats.target_t1_size += instance_stats.target_t1_size;
+    stats.t1_size += instance_stats.t1_size;
+    stats.t2_size += instance_stats.t2_size;
+    stats.b1_size += instance_stats.b1_size;
+    stats.b2_size += instance_stats.b2_size;
+    stats.min_target_t1_size =
+        std::min(stats.min_target_t1_size, instance_stats.target_t1_size);
+    stats.max_target_t1_size =
+        std::max(stats.max_target_t1_size, instance_stats.target_t1_size);
+  }
+  stats.target_t1_size /= instances_.size();
+  return true;
+}
+
+void ParallelBufferPoolManager::StartPageCleaner(
+    size_t max_pages_per_round, std::chrono::milliseconds interval) {
+  for (auto *instance : instances_) {
+    instance->StartPageCleaner(max_pages_per_round, interval);
+  }
+}
+
+void ParallelBufferPoolManager::StopPageCleaner() {
+  for (auto *instance : instances_) {
+    instance->StopPageCleaner();
+  }
+}
+
+void ParallelBufferPoolManager::EnableVictimCache(const std::string &file_name,
+                                                  size_t capacity) {
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    instances_[i]->EnableVictimCache(file_name + "." + std::to_string(i),
+                                     capacity / instances_.size());
+  }
+}
+
+void ParallelBufferPoolManager::EnableCompression(const std::string &file_name) {
+  if (page_store_ != nullptr) {
+    return;
+  }
+  //各实例共用同一个调度器，设置一次即可
+  BufferPoolManager::EnableCompression(file_name);
+}
+
+bool ParallelBufferPoolManager::GetVictimCacheStats(VictimCacheStats &stats) {
+  stats = VictimCacheStats{0, 0, 0, 0, 0};
+  for (auto *instance : instances_) {
+    VictimCacheStats instance_stats;
+    if (!instance->GetVictimCacheStats(instance_stats)) {
+      return false;
+    }
+    stats.capacity += instance_stats.capacity;
+    stats.size += instance_stats.size;
+    stats.hits += instance_stats.hits;
+    stats.misses += instance_stats.misses;
+    stats.spills += instance_stats.spills;
+  }
+  return true;
+}
+
+bool ParallelBufferPoolManager::LoadFreeSpaceMap() {
+  bool loaded = true;
+  for (auto *instance : instances_) {
+    loaded = instance->LoadFreeSpaceMap() && loaded;
+  }
+  return loaded;
+}
+
+/*
+ * Split the manifest by instance and start the reads of every instance before
+ * waiting for any of them
+ */
+size_t ParallelBufferPoolManager::LoadManifest(const std::string &file_name,
+                                               bool wait) {
+  std::vector<page_id_t> page_ids;
+  if (!ReadManifest(file_name, page_ids, GetPoolSize())) {
+    return 0;
+  }
+  std::vector<std::vector<page_id_t>> instance_ids(instances_.size());
+  for (page_id_t page_id : page_ids) {
+    if (page_id != INVALID_PAGE_ID) {
+      instance_ids[static_cast<size_t>(page_id) % instances_.size()].push_back(
+          page_id);
+    }
+  }
+  std::vector<std::future<void>> reads;
+  std::vector<std::vector<page_id_t>> loaded(instances_.size());
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    instances_[i]->LoadPages(instance_ids[i], reads, loaded[i]);
+  }
+  if (wait) {
+    for (auto &read : reads) {
+      read.wait();
+    }
+    for (size_t i = 0; i < instances_.size(); ++i) {
+      instances_[i]->OrderLoadedPages(loaded[i]);
+    }
+  }
+  return reads.size();
+}
+
+size_t ParallelBufferPoolManager::GetPagesCleaned() {
+  size_t pages_cleaned = 0;
+  for (auto *instance : instances_) {
+    pages_cleaned += instance->GetPagesCleaned();
+  }
+  return pages_cleaned;
+}
+
+size_t ParallelBufferPoolManager::GetDirtyVictims() {
+  size_t dirty_victims = 0;
+  for (auto *instance : instances_) {
+    dirty_victims += instance->GetDirtyVictims();
+  }
+  return dirty_victims;
+}
+
+} // namespace scudb
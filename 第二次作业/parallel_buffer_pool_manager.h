@@ -0,0 +1,107 @@
+/*
+ * parallel_buffer_pool_manager.h
+ *
+ * Functionality: A buffer pool made of several independent BufferPoolManager
+ * instances, each one with its own frames, page table, replacer, free list and
+ * latch. Page ids are routed to the instance owning them by page id, and new
+ * pages are allocated round-robin across the instances, so threads working on
+ * different pages do not serialize on a single latch.
+ */
+
+#pragma once
+#include <atomic>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+
+namespace scudb {
+class ParallelBufferPoolManager : public BufferPoolManager {
+public:
+  // pool_size is the number of frames of each instance
+  ParallelBufferPoolManager(size_t num_instances, size_t pool_size,
+                            DiskManager *disk_manager,
+                            LogManager *log_manager = nullptr,
+                            ReplacerType replacer_type = ReplacerType::LRU,
+                            size_t lru_k = LRUK_REPLACER_K,
+                            HugePageMode huge_pages = HugePageMode::NONE);
+
+  ~ParallelBufferPoolManager();
+
+  Page *FetchPage(page_id_t page_id,
+                  AccessStrategy *strategy = nullptr) override;
+
+  bool PrefetchPage(page_id_t page_id,
+                    AccessStrategy *strategy = nullptr) override;
+
+  Page *TryFetchPage(page_id_t page_id) override;
+
+  bool PeekPage(page_id_t page_id, char *data) override;
+
+  bool UnpinPage(page_id_t page_id, bool is_dirty) override;
+
+  // the pages are split by instance, the misses of all the instances are
+  // read concurrently
+  std::vector<Page *> FetchPages(const std::vector<page_id_t> &page_ids) override;
+
+  bool UnpinPages(const std::vector<page_id_t> &page_ids,
+                  bool is_dirty) override;
+
+  bool FlushPage(page_id_t page_id) override;
+
+  // dirty pages of all instances are written in one page id ordered pass
+  void FlushPages(page_id_t first_page_id, page_id_t last_page_id) override;
+
+  // the instance owning hint_page_id is tried first
+  Page *NewPage(page_id_t &page_id, page_id_t hint_page_id = INVALID_PAGE_ID,
+                AccessStrategy *strategy = nullptr) override;
+
+  bool DeletePage(page_id_t page_id) override;
+
+  size_t GetPoolSize() override;
+
+  // n is split evenly over the instances, each one resizes on its own
+  size_t Grow(size_t n) override;
+
+  size_t Shrink(size_t n) override;
+
+  // dump of every instance, the lines of instance i start with buffer_pool.i
+  std::string DumpStats() override;
+
+  // list sizes summed over all instances, p is the mean of the instances and
+  // min/max_target_t1_size its range
+  bool GetARCStats(ARCStats &stats) override;
+
+  // start one page cleaner per instance, max_pages_per_round is per instance
+  void StartPageCleaner(size_t max_pages_per_round = 16,
+                        std::chrono::milliseconds interval =
+                            std::chrono::milliseconds(10)) override;
+
+  void StopPageCleaner() override;
+
+  // instance i spills to file_name.i, capacity is split evenly
+  void EnableVictimCache(const std::string &file_name,
+                         size_t capacity) override;
+
+  // sum of the counters of all instances
+  bool GetVictimCacheStats(VictimCacheStats &stats) override;
+
+  // one compressed file shared by all the instances
+  void EnableCompression(const std::string &file_name) override;
+
+  // each instance has its own map, the marker is in the header page
+  bool LoadFreeSpaceMap() override;
+
+  // one manifest for the whole pool, each instance loads its own pages
+  size_t LoadManifest(const std::string &file_name, bool wait = true) override;
+
+  size_t GetPagesCleaned() override;
+
+  size_t GetDirtyVictims() override;
+
+private:
+  BufferPoolManager *GetBufferPoolManager(page_id_t page_id);
+
+  std::vector<BufferPoolManager *> instances_; // independent instances
+  std::atomic<size_t> next_instance_; // where the next NewPage starts from
+};
+} // namespace scudb
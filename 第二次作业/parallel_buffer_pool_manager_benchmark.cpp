@@ -0,0 +1,116 @@
+/**
+ * parallel_buffer_pool_manager_benchmark.cpp
+ *
+ * Thread scaling of FetchPage/UnpinPage on one BufferPoolManager against a
+ * ParallelBufferPoolManager with the same number of frames. The working set
+ * is twice the number of frames, so about half of the fetches miss and go
+ * through the latch of the pool (or of one instance).
+ *
+ * usage: parallel_buffer_pool_manager_benchmark [instances] [frames] [seconds]
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer/parallel_buffer_pool_manager.h"
+
+using namespace scudb;
+
+namespace {
+
+const size_t THREAD_COUNTS[] = {1, 2, 4, 8, 16, 32};
+
+std::vector<page_id_t> CreatePages(BufferPoolManager *bpm, size_t num_pages) {
+  std::vector<page_id_t> page_ids;
+  for (size_t i = 0; i < num_pages; ++i) {
+    page_id_t page_id;
+    if (bpm->NewPage(page_id) == nullptr) {
+      break;
+    }
+    page_ids.push_back(page_id);
+    bpm->UnpinPage(page_id, true);
+  }
+  return page_ids;
+}
+
+//每个线程随机读取工作集中的页，返回每秒完成的FetchPage/UnpinPage次数
+double RunThreads(BufferPoolManager *bpm, const std::vector<page_id_t> &pages,
+                  size_t num_threads, double seconds) {
+  std::atomic<bool> stop(false);
+  std::atomic<size_t> total(0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937_64 rng(t + 1);
+      std::uniform_int_distribution<size_t> pick(0, pages.size() - 1);
+      size_t ops = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        page_id_t page_id = pages[pick(rng)];
+        if (bpm->FetchPage(page_id) != nullptr) {
+          bpm->UnpinPage(page_id, false);
+          ops++;
+        }
+      }
+      total += ops;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return total.load() / seconds;
+}
+
+void RunPool(const char *name, BufferPoolManager *bpm, size_t frames,
+             double seconds, std::vector<double> &results) {
+  std::vector<page_id_t> pages = CreatePages(bpm, frames * 2);
+  for (size_t num_threads : THREAD_COUNTS) {
+    results.push_back(RunThreads(bpm, pages, num_threads, seconds));
+  }
+  printf("%s done, %zu pages\n", name, pages.size());
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t instances = argc > 1 ? strtoul(argv[1], nullptr, 10) : 16;
+  size_t frames = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1024;
+  double seconds = argc > 3 ? atof(argv[3]) : 1.0;
+  if (instances == 0 || frames < instances) {
+    fprintf(stderr, "need at least one frame per instance\n");
+    return 1;
+  }
+
+  //两个缓冲池使用各自的数据库文件，帧数相同
+  std::vector<double> single_results;
+  std::vector<double> parallel_results;
+  {
+    DiskManager disk_manager("single_bpm_benchmark.db");
+    BufferPoolManager bpm(frames, &disk_manager);
+    RunPool("single", &bpm, frames, seconds, single_results);
+  }
+  {
+    DiskManager disk_manager("parallel_bpm_benchmark.db");
+    ParallelBufferPoolManager bpm(instances, frames / instances,
+                                  &disk_manager);
+    RunPool("parallel", &bpm, frames / instances * instances, seconds,
+            parallel_results);
+  }
+  for (const char *file : {"single_bpm_benchmark", "parallel_bpm_benchmark"}) {
+    remove((std::string(file) + ".db").c_str());
+    remove((std::string(file) + ".log").c_str());
+  }
+
+  printf("%8s %16s %16s %8s\n", "threads", "single ops/s",
+         "parallel ops/s", "speedup");
+  for (size_t i = 0; i < single_results.size(); ++i) {
+    printf("%8zu %16.0f %16.0f %8.2f\n", THREAD_COUNTS[i], single_results[i],
+           parallel_results[i], parallel_results[i] / single_results[i]);
+  }
+  return 0;
+}
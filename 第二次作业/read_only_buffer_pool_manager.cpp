@@ -0,0 +1,146 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <sstream>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/read_only_buffer_pool_manager.h"
+#include "common/exception.h"
+
+namespace scudb {
+
+/*
+ * ReadOnlyBufferPoolManager Constructor
+ * The mapping and the pin counts are only reserved here, the pages are read
+ * by the OS when they are first touched
+ */
+ReadOnlyBufferPoolManager::ReadOnlyBufferPoolManager(const std::string &db_file)
+    : file_name_(db_file), data_(nullptr), file_size_(0), num_pages_(0),
+      pin_counts_(nullptr), views_(0) {
+  int fd = open(db_file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw Exception("can't open db file " + db_file);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    throw Exception("can't stat db file " + db_file);
+  }
+  file_size_ = file_stat.st_size;
+  num_pages_ = file_size_ / PAGE_SIZE;
+  if (num_pages_ > 0) {
+    void *data = mmap(nullptr, file_size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      throw Exception("can't map db file " + db_file);
+    }
+    data_ = static_cast<const char *>(data);
+    void *pin_counts =
+        mmap(nullptr, num_pages_ * sizeof(int), PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (pin_counts == MAP_FAILED) {
+      munmap(data, file_size_);
+      close(fd);
+      throw std::bad_alloc();
+    }
+    pin_counts_ = static_cast<int *>(pin_counts);
+  }
+  //映射建立后不再需要文件描述符
+  close(fd);
+}
+
+ReadOnlyBufferPoolManager::~ReadOnlyBufferPoolManager() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char *>(data_), file_size_);
+    munmap(pin_counts_, num_pages_ * sizeof(int));
+  }
+}
+
+//pin住该页并返回指向映射内存的视图，不复制页的内容
+ReadPageGuard ReadOnlyBufferPoolManager::FetchPageRead(page_id_t page_id,
+                                                       AccessStrategy *) {
+  if (!IsMapped(page_id)) {
+    return ReadPageGuard();
+  }
+  __atomic_add_fetch(&pin_counts_[page_id], 1, __ATOMIC_ACQ_REL);
+  views_.fetch_add(1, std::memory_order_relaxed);
+  return ReadPageGuard(this, page_id,
+                       data_ + static_cast<size_t>(page_id) * PAGE_SIZE);
+}
+
+bool ReadOnlyBufferPoolManager::PeekPage(page_id_t page_id, char *data) {
+  if (!IsMapped(page_id)) {
+    return false;
+  }
+  memcpy(data, data_ + static_cast<size_t>(page_id) * PAGE_SIZE, PAGE_SIZE);
+  return true;
+}
+
+bool ReadOnlyBufferPoolManager::PrefetchPage(page_id_t page_id,
+                                             AccessStrategy *) {
+  if (!IsMapped(page_id)) {
+    return false;
+  }
+  //madvise要求起始地址按系统页对齐
+  size_t os_page_size = sysconf(_SC_PAGESIZE);
+  size_t offset = static_cast<size_t>(page_id) * PAGE_SIZE;
+  size_t start = offset / os_page_size * os_page_size;
+  madvise(const_cast<char *>(data_) + start, offset + PAGE_SIZE - start,
+          MADV_WILLNEED);
+  return true;
+}
+
+bool ReadOnlyBufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty) {
+  if (!IsMapped(page_id)) {
+    return false;
+  }
+  int pins = __atomic_load_n(&pin_counts_[page_id], __ATOMIC_ACQUIRE);
+  do {
+    if (pins <= 0) {
+      return false;
+    }
+  } while (!__atomic_compare_exchange_n(&pin_counts_[page_id], &pins,
+                                        pins - 1, true, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE));
+  return !is_dirty;
+}
+
+//每页的pin值各自原子减一，不需要加锁
+bool ReadOnlyBufferPoolManager::UnpinPages(
+    const std::vector<page_id_t> &page_ids, bool is_dirty) {
+  bool unpinned = true;
+  for (page_id_t page_id : page_ids) {
+    unpinned = UnpinPage(page_id, is_dirty) && unpinned;
+  }
+  return unpinned;
+}
+
+size_t ReadOnlyBufferPoolManager::GetPoolSize() { return num_pages_; }
+
+std::string ReadOnlyBufferPoolManager::DumpStats() {
+  std::ostringstream out;
+  out << "buffer_pool.mapped_file " << file_name_ << "\n";
+  out << "buffer_pool.mapped_bytes " << file_size_ << "\n";
+  out << "buffer_pool.mapped_pages " << num_pages_ << "\n";
+  out << "buffer_pool.views " << views_.load() << "\n";
+  return out.str();
+}
+
+size_t ReadOnlyBufferPoolManager::LoadManifest(const std::string &file_name) {
+  std::vector<page_id_t> page_ids;
+  if (!BufferPoolManager::ReadManifest(file_name, page_ids, num_pages_)) {
+    return 0;
+  }
+  size_t prefetched = 0;
+  for (page_id_t page_id : page_ids) {
+    if (PrefetchPage(page_id)) {
+      prefetched++;
+    }
+  }
+  return prefetched;
+}
+
+} // namespace scudb
@@ -0,0 +1,77 @@
+/*
+ * read_only_buffer_pool_manager.h
+ *
+ * Functionality: A buffer pool for read only replicas. The database file is
+ * mapped into memory and FetchPageRead hands back views pointing straight
+ * into the mapping, a page is never copied into a frame. The OS page cache
+ * decides which pages stay in memory, so opening a file of any size only
+ * costs the mmap call. Pages are still pinned and unpinned as usual, nothing
+ * can be written, so the read latch of a view is always granted.
+ *
+ * It is not a BufferPoolManager: Page embeds its data, so a page that is not
+ * copied into a frame has no Page object. It is a PageReader, so a BPlusTree
+ * built on it (see the read only BPlusTree constructor) answers GetValue and
+ * range scans straight from the mapping, anything that needs a Page * or
+ * writes a page cannot be given this pool.
+ */
+
+#pragma once
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "buffer/page_guard.h"
+#include "common/config.h"
+
+namespace scudb {
+class ReadOnlyBufferPoolManager : public PageReader {
+public:
+  // map db_file, throw an Exception if it cannot be opened or mapped
+  explicit ReadOnlyBufferPoolManager(const std::string &db_file);
+
+  ~ReadOnlyBufferPoolManager();
+
+  ReadOnlyBufferPoolManager(const ReadOnlyBufferPoolManager &) = delete;
+  ReadOnlyBufferPoolManager &
+  operator=(const ReadOnlyBufferPoolManager &) = delete;
+
+  // view of the page inside the mapping, invalid past the end of the file.
+  // There are no frames, so strategy is ignored
+  ReadPageGuard FetchPageRead(page_id_t page_id,
+                              AccessStrategy *strategy = nullptr) override;
+
+  // ask the OS to read the page ahead of time
+  bool PrefetchPage(page_id_t page_id,
+                    AccessStrategy *strategy = nullptr) override;
+
+  // copies straight out of the mapping
+  bool PeekPage(page_id_t page_id, char *data) override;
+
+  // the pin is released either way, but false is returned when is_dirty is
+  // set since the change cannot be kept
+  bool UnpinPage(page_id_t page_id, bool is_dirty) override;
+
+  bool UnpinPages(const std::vector<page_id_t> &page_ids, bool is_dirty);
+
+  // number of pages of the file
+  size_t GetPoolSize();
+
+  std::string DumpStats();
+
+  // ask the OS to read the pages of the manifest ahead
+  size_t LoadManifest(const std::string &file_name);
+
+private:
+  inline bool IsMapped(page_id_t page_id) const {
+    return page_id >= 0 && static_cast<size_t>(page_id) < num_pages_;
+  }
+
+  std::string file_name_;
+  const char *data_;    // mapping of the database file
+  size_t file_size_;
+  size_t num_pages_;    // whole pages in the file
+  // pin count of every page, backed by zero pages until first used
+  int *pin_counts_;
+  std::atomic<size_t> views_; // views handed out so far
+};
+} // namespace scudb
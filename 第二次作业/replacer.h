@@ -0,0 +1,42 @@
+/**
+ * replacer.h
+ *
+ * Abstract class for replacer, your LRU should implement those methods
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <string>
+
+namespace scudb {
+
+template <typename T> class Replacer {
+public:
+  Replacer() {}
+  virtual ~Replacer() {}
+  virtual void Insert(const T &value) = 0;
+  virtual bool Victim(T &value) = 0;
+  virtual bool Erase(const T &value) = 0;
+  virtual size_t Size() = 0;
+
+  // make value evictable without counting an access, for a page the pool
+  // loaded ahead of use or only pinned for itself (flush, peek). A replacer
+  // without access history treats it as an Insert
+  virtual void InsertCold(const T &value) { Insert(value); }
+
+  // an access of a value that stays pinned. Only replacers counting every
+  // access look at it, the others take the access from the Insert made when
+  // the value is unpinned
+  virtual void RecordAccess(const T &value) {}
+
+  // the value returned by Victim is evicted for good, replacers remembering
+  // evicted pages record it here
+  virtual void Evict(const T &value) {}
+
+  // text dump of the replacer counters, one "prefix.name value" line each,
+  // see Metrics
+  virtual std::string DumpStats(const std::string &prefix) { return ""; }
+};
+
+} // namespace scudb
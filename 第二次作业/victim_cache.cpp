@@ -0,0 +1,161 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include "buffer/frame_arena.h"
+#include "buffer/victim_cache.h"
+#include "common/exception.h"
+
+namespace scudb {
+
+VictimCache::VictimCache(const std::string &file_name, size_t capacity)
+    : file_name_(file_name), capacity_(capacity),
+      slot_states_(capacity, SlotState::FREE),
+      slot_pages_(capacity, INVALID_PAGE_ID), hand_(0), hits_(0), misses_(0),
+      spills_(0) {
+  direct_ = true;
+  fd_ = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+  //文件系统不支持O_DIRECT时退回普通读写
+  if (fd_ < 0 && errno == EINVAL) {
+    direct_ = false;
+    fd_ = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  }
+  if (fd_ < 0) {
+    throw Exception("can't open victim cache file " + file_name);
+  }
+  //先用编号小的槽
+  for (size_t slot = capacity_; slot > 0; --slot) {
+    free_slots_.push_back(slot - 1);
+  }
+}
+
+//溢出文件的内容只对本进程有效，不保留
+VictimCache::~VictimCache() {
+  close(fd_);
+  unlink(file_name_.c_str());
+}
+
+/*
+ * Take a free slot, else overwrite the next used slot under the clock hand.
+ * Called with the latch held
+ * @return: capacity_ if every slot is busy
+ */
+size_t VictimCache::TakeSlot() {
+  if (!free_slots_.empty()) {
+    size_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    return slot;
+  }
+  for (size_t i = 0; i < capacity_; ++i) {
+    size_t slot = hand_;
+    hand_ = (hand_ + 1) % capacity_;
+    if (slot_states_[slot] == SlotState::USED) {
+      index_.erase(slot_pages_[slot]);
+      return slot;
+    }
+  }
+  return capacity_;
+}
+
+/*
+ * O_DIRECT needs the buffer aligned, an unaligned one is copied through an
+ * aligned buffer on the stack
+ */
+bool VictimCache::ReadSlot(size_t slot, char *data) {
+  off_t offset = static_cast<off_t>(slot) * PAGE_SIZE;
+  if (!direct_ || reinterpret_cast<uintptr_t>(data) % FRAME_ALIGNMENT == 0) {
+    return pread(fd_, data, PAGE_SIZE, offset) == PAGE_SIZE;
+  }
+  alignas(FRAME_ALIGNMENT) char buffer[PAGE_SIZE];
+  if (pread(fd_, buffer, PAGE_SIZE, offset) != PAGE_SIZE) {
+    return false;
+  }
+  memcpy(data, buffer, PAGE_SIZE);
+  return true;
+}
+
+bool VictimCache::WriteSlot(size_t slot, const char *data) {
+  off_t offset = static_cast<off_t>(slot) * PAGE_SIZE;
+  if (!direct_ || reinterpret_cast<uintptr_t>(data) % FRAME_ALIGNMENT == 0) {
+    return pwrite(fd_, data, PAGE_SIZE, offset) == PAGE_SIZE;
+  }
+  alignas(FRAME_ALIGNMENT) char buffer[PAGE_SIZE];
+  memcpy(buffer, data, PAGE_SIZE);
+  return pwrite(fd_, buffer, PAGE_SIZE, offset) == PAGE_SIZE;
+}
+
+void VictimCache::Put(page_id_t page_id, const char *data) {
+  size_t slot;
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    if (index_.find(page_id) != index_.end()) {
+      return;
+    }
+    slot = TakeSlot();
+    if (slot == capacity_) {
+      return;
+    }
+    slot_states_[slot] = SlotState::BUSY;
+    slot_pages_[slot] = page_id;
+  }
+  //写入期间不持有锁，写完后才能被Get找到
+  bool written = WriteSlot(slot, data);
+  std::lock_guard<std::mutex> lck(latch_);
+  if (written) {
+    slot_states_[slot] = SlotState::USED;
+    index_[page_id] = slot;
+    spills_++;
+  } else {
+    slot_states_[slot] = SlotState::FREE;
+    free_slots_.push_back(slot);
+  }
+}
+
+bool VictimCache::Get(page_id_t page_id, char *data) {
+  size_t slot;
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    auto it = index_.find(page_id);
+    if (it == index_.end()) {
+      misses_++;
+      return false;
+    }
+    slot = it->second;
+    index_.erase(it);
+    slot_states_[slot] = SlotState::BUSY;
+  }
+  //读出后该页回到缓冲池，槽位释放
+  bool read = ReadSlot(slot, data);
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    slot_states_[slot] = SlotState::FREE;
+    free_slots_.push_back(slot);
+  }
+  if (read) {
+    hits_++;
+  } else {
+    misses_++;
+  }
+  return read;
+}
+
+void VictimCache::Erase(page_id_t page_id) {
+  std::lock_guard<std::mutex> lck(latch_);
+  auto it = index_.find(page_id);
+  if (it == index_.end()) {
+    return;
+  }
+  slot_states_[it->second] = SlotState::FREE;
+  free_slots_.push_back(it->second);
+  index_.erase(it);
+}
+
+VictimCacheStats VictimCache::GetStats() {
+  std::lock_guard<std::mutex> lck(latch_);
+  return VictimCacheStats{capacity_, index_.size(), hits_.load(),
+                          misses_.load(), spills_.load()};
+}
+} // namespace scudb
@@ -0,0 +1,81 @@
+/*
+ * victim_cache.h
+ *
+ * Functionality: second tier behind a buffer pool, for a database file on
+ * slow storage. Clean pages evicted from the pool are written to a spill file
+ * on local SSD, a later miss on such a page reads it from the spill file
+ * instead of the database file. The cache is exclusive: a page read back is
+ * removed from it, so a page is either in the pool or in the cache and the
+ * copy in the cache always matches the database file. The spill file has a
+ * fixed number of slots, when they are all taken the slot under a clock hand
+ * is overwritten (first in, first out).
+ *
+ * The spill file is opened with O_DIRECT so the slots do not also take room
+ * in the OS page cache. The frames of a pool are FRAME_ALIGNMENT aligned, a
+ * page from anywhere else goes through an aligned buffer on the stack. A file
+ * system without O_DIRECT (tmpfs) falls back to buffered I/O.
+ */
+
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+
+namespace scudb {
+
+struct VictimCacheStats {
+  size_t capacity; // slots of the spill file
+  size_t size;     // pages in the cache
+  size_t hits;     // misses of the pool read from the cache
+  size_t misses;   // misses of the pool read from the database file
+  size_t spills;   // evicted pages written to the cache
+};
+
+class VictimCache {
+public:
+  // create (or truncate) the spill file with capacity slots, throw an
+  // Exception if it cannot be opened. The file is removed by the destructor
+  VictimCache(const std::string &file_name, size_t capacity);
+
+  ~VictimCache();
+
+  // copy of a clean page evicted from the pool, dropped if no slot is free
+  // of readers
+  void Put(page_id_t page_id, const char *data);
+
+  // read the page into data and remove it from the cache, false on a miss
+  bool Get(page_id_t page_id, char *data);
+
+  // forget the page, its copy would be stale (page deleted or reused)
+  void Erase(page_id_t page_id);
+
+  VictimCacheStats GetStats();
+
+private:
+  // a slot being read or written is skipped by the clock hand
+  enum class SlotState { FREE, USED, BUSY };
+
+  size_t TakeSlot();
+
+  bool ReadSlot(size_t slot, char *data);
+  bool WriteSlot(size_t slot, const char *data);
+
+  std::string file_name_;
+  int fd_;
+  bool direct_; // spill file opened with O_DIRECT
+  size_t capacity_;
+  std::mutex latch_; // protects the index, not held during the I/O
+  std::unordered_map<page_id_t, size_t> index_; // page id -> slot
+  std::vector<SlotState> slot_states_;
+  std::vector<page_id_t> slot_pages_;
+  std::vector<size_t> free_slots_;
+  size_t hand_; // next slot to overwrite once the file is full
+  std::atomic<size_t> hits_;
+  std::atomic<size_t> misses_;
+  std::atomic<size_t> spills_;
+};
+} // namespace scudb